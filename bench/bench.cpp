@@ -0,0 +1,531 @@
+// Microbenchmarks for the ECS, transform and physics hot paths. Results are
+// written as JSON so runs can be diffed between releases. The snapshot
+// benchmarks write a scratch file to the working directory.
+//
+//   ember_bench [--sizes 1000,10000,...] [--min-time SECONDS]
+//               [--sim-steps N] [--rays N] [--out FILE]
+//               [--sweep builtin|PROFILES_FILE] [--sweep-steps N]
+//               [--sweep-layout stack|pyramid|grid|drop]
+//
+// --sweep replaces the microbenchmarks with a physics profile sweep: every
+// profile simulates the layout at every size, reporting step times and
+// whether the scene stayed stable. Stable means no body fell through the
+// ground and, for resting layouts, none drifted more than a quarter meter
+// sideways.
+
+#include "BoundingVolumeHierarchy.h"
+#include "PhysicsProfile.h"
+#include "SceneGenerators.h"
+#include "Transform.h"
+#include "TransformBatch.h"
+#include "World.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct BenchOptions {
+  std::vector<size_t> sizes = {1000, 10000, 100000, 1000000};
+  double minTime = 0.25;
+  int simSteps = 10;
+  // Raycasts per iteration of the scene query benchmarks
+  size_t rays = 100000;
+  std::string out;
+  // "builtin" or a profiles file, empty runs the microbenchmarks
+  std::string sweep;
+  int sweepSteps = 300;
+  std::string sweepLayout = "stack";
+};
+
+struct BenchResult {
+  std::string name;
+  size_t entities;
+  size_t iterations;
+  double totalNs;
+  // Queries per iteration, for benchmarks that run a batch of them
+  size_t queries = 0;
+};
+
+struct SweepResult {
+  std::string profile;
+  size_t entities = 0;
+  int steps = 0;
+  double stepMeanMs = 0.0;
+  double stepP99Ms = 0.0;
+  // PhysX's own simulate time, see SimulationOverlapStats
+  double simulateMeanMs = 0.0;
+  float maxDrift = 0.0f;
+  size_t fallen = 0;
+  double asleepFraction = 0.0;
+  bool stable = false;
+};
+
+// Keeps the compiler from discarding results that are never read
+template <typename T> void doNotOptimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+using Clock = std::chrono::steady_clock;
+
+// Repeats func until minTime has elapsed, func handles all entities once
+template <typename Func>
+BenchResult measure(const std::string &name, size_t entities, double minTime,
+                    Func &&func) {
+  BenchResult result{name, entities, 0, 0.0};
+  auto start = Clock::now();
+  do {
+    func();
+    result.iterations++;
+    result.totalNs =
+        std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+  } while (result.totalNs < minTime * 1e9);
+  return result;
+}
+
+bool parseOptions(int argc, char **argv, BenchOptions &options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      return false;
+    }
+    std::string value = argv[++i];
+    if (arg == "--sizes") {
+      options.sizes.clear();
+      std::stringstream ss(value);
+      std::string item;
+      while (std::getline(ss, item, ',')) {
+        options.sizes.push_back(std::strtoull(item.c_str(), nullptr, 10));
+      }
+    } else if (arg == "--min-time") {
+      options.minTime = std::atof(value.c_str());
+    } else if (arg == "--sim-steps") {
+      options.simSteps = std::atoi(value.c_str());
+    } else if (arg == "--rays") {
+      options.rays = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (arg == "--out") {
+      options.out = value;
+    } else if (arg == "--sweep") {
+      options.sweep = value;
+    } else if (arg == "--sweep-steps") {
+      options.sweepSteps = std::atoi(value.c_str());
+    } else if (arg == "--sweep-layout") {
+      options.sweepLayout = value;
+    } else {
+      return false;
+    }
+  }
+  return !options.sizes.empty() && options.simSteps > 0 && options.rays > 0 &&
+         options.sweepSteps > 0;
+}
+
+// Stacks of ten unit cubes laid out on a grid, settles into resting contact
+glm::vec3 stackPosition(size_t i) {
+  const size_t height = 10;
+  const size_t columnsPerRow = 256;
+  size_t column = i / height;
+  return glm::vec3((column % columnsPerRow) * 2.0f,
+                   (column / columnsPerRow) * 2.0f,
+                   0.5f + (i % height) * 1.0f);
+}
+
+void runSize(size_t count, const BenchOptions &options,
+             std::vector<BenchResult> &results) {
+  std::cerr << "Benchmarking " << count << " entities" << std::endl;
+
+  // World::SpawnBatch with the same stacks, in a world of its own
+  {
+    std::vector<SpawnDesc> spawns(count);
+    for (size_t i = 0; i < count; i++) {
+      spawns[i].position = stackPosition(i);
+    }
+    World batchWorld;
+    auto start = Clock::now();
+    batchWorld.SpawnBatch(spawns);
+    double ns =
+        std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    results.push_back({"world_spawn_batch", count, 1, ns});
+
+    // The same scene through a snapshot, loaded into an empty world
+    const std::string snapshotPath = "ember_bench.snapshot";
+    start = Clock::now();
+    batchWorld.SaveSnapshot(snapshotPath);
+    ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    results.push_back({"world_snapshot_save", count, 1, ns});
+
+    World snapshotWorld;
+    start = Clock::now();
+    snapshotWorld.LoadSnapshot(snapshotPath);
+    ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    results.push_back({"world_snapshot_load", count, 1, ns});
+    std::remove(snapshotPath.c_str());
+  }
+
+  World world;
+  Registry &registry = world.GetRegistry();
+  std::vector<Entity> entities;
+  entities.reserve(count);
+
+  // World::AddEntity, creates the actor, shape and registry slots
+  {
+    auto start = Clock::now();
+    for (size_t i = 0; i < count; i++) {
+      entities.push_back(world.AddEntity(stackPosition(i),
+                                         glm::quat(1.0f, 0.0f, 0.0f, 0.0f)));
+    }
+    double ns =
+        std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    results.push_back({"world_add_entity", count, 1, ns});
+  }
+
+  // Component lookups through the registry in random order
+  {
+    std::vector<Entity> shuffled = entities;
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(42));
+    results.push_back(measure("registry_get_component", count,
+                              options.minTime, [&]() {
+                                float sum = 0.0f;
+                                for (Entity entity : shuffled) {
+                                  sum += registry.get<TransformComponent>(entity)
+                                             ->position.z;
+                                }
+                                doNotOptimize(sum);
+                              }));
+  }
+
+  // Per entity glm model matrices, as Mesh::SetTransform builds them
+  {
+    std::vector<glm::mat4> models(count);
+    auto &transforms = registry.pool<TransformComponent>().components();
+    results.push_back(
+        measure("model_matrix", count, options.minTime, [&]() {
+          for (size_t i = 0; i < transforms.size(); i++) {
+            models[i] =
+                ModelMatrix(transforms[i].position, transforms[i].rotation);
+          }
+          doNotOptimize(models.data());
+        }));
+  }
+
+  // The same matrices from the SoA batch kernels RenderSystem uses
+  {
+    TransformBatch batch;
+    batch.reserve(count);
+    for (const TransformComponent &transform :
+         registry.pool<TransformComponent>().components()) {
+      batch.push(transform.position, transform.rotation);
+    }
+    std::vector<glm::mat4> models(count);
+    results.push_back(
+        measure("model_matrix_batch", count, options.minTime, [&]() {
+          BuildModelMatrices(batch, models.data());
+          doNotOptimize(models.data());
+        }));
+  }
+
+  // RenderSystem's culling query: the cubes in a hierarchy, seen by a
+  // camera looking over the corner of the grid
+  {
+    BoundingVolumeHierarchy bvh;
+    AABB cube;
+    cube.min = glm::vec3(-0.5f);
+    cube.max = glm::vec3(0.5f);
+    auto &transforms = registry.pool<TransformComponent>().components();
+    for (size_t i = 0; i < transforms.size(); i++) {
+      bvh.insert(TransformAABB(cube, ModelMatrix(transforms[i].position,
+                                                 transforms[i].rotation)),
+                 static_cast<uint32_t>(i));
+    }
+    Frustum frustum = Frustum::FromMatrix(
+        glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f) *
+        glm::lookAt(glm::vec3(-10.0f, 20.0f, -10.0f),
+                    glm::vec3(30.0f, 0.0f, 30.0f),
+                    glm::vec3(0.0f, 1.0f, 0.0f)));
+    results.push_back(
+        measure("bvh_frustum_query", count, options.minTime, [&]() {
+          size_t visible = 0;
+          bvh.queryFrustum(frustum, [&](uint32_t) { visible++; });
+          doNotOptimize(visible);
+        }));
+  }
+
+  // PxScene::simulate + fetchResults on the stacked cubes
+  {
+    PxScene *scene = world.GetPhysicsSystem()->GetScene();
+    auto start = Clock::now();
+    for (int i = 0; i < options.simSteps; i++) {
+      scene->simulate(1.0f / 60.0f);
+      scene->fetchResults(true);
+    }
+    double ns =
+        std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    results.push_back({"px_scene_simulate", count, (size_t)options.simSteps, ns});
+  }
+
+  // The pose copy loop that ends PhysicsSystem::update. It visits the
+  // actors PhysX reported as active in the last simulated step, so it has
+  // to run after the simulate benchmark.
+  world.GetPhysicsSystem()->captureActivePoses();
+  results.push_back(
+      measure("physics_sync_transforms", count, options.minTime, [&]() {
+        world.GetPhysicsSystem()->syncTransforms(registry);
+        doNotOptimize(registry.pool<TransformComponent>().components().data());
+      }));
+
+  // Scene queries: half the rays drop onto the stacks from above, half
+  // cross the grid sideways at stack height
+  {
+    size_t columns = (count + 9) / 10;
+    glm::vec3 extent(std::min<size_t>(columns, 256) * 2.0f,
+                     ((columns + 255) / 256) * 2.0f, 10.0f);
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<RaycastQuery> rays(options.rays);
+    for (size_t i = 0; i < rays.size(); i++) {
+      RaycastQuery &ray = rays[i];
+      if (i % 2 == 0) {
+        ray.origin = glm::vec3(unit(rng) * extent.x, unit(rng) * extent.y,
+                               extent.z + 5.0f);
+        ray.direction = glm::vec3(unit(rng) - 0.5f, unit(rng) - 0.5f, -4.0f);
+      } else {
+        ray.origin = glm::vec3(-5.0f, unit(rng) * extent.y,
+                               unit(rng) * extent.z);
+        ray.direction = glm::vec3(1.0f, unit(rng) - 0.5f, 0.0f);
+      }
+      ray.maxDistance = 1000.0f;
+    }
+
+    std::vector<QueryHit> hits;
+    BenchResult batch =
+        measure("world_raycast_batch", count, options.minTime, [&]() {
+          world.RaycastBatch(rays, hits);
+          doNotOptimize(hits.data());
+        });
+    batch.queries = rays.size();
+    results.push_back(batch);
+
+    // The same rays one at a time on the calling thread, for comparison
+    PxScene *scene = world.GetPhysicsSystem()->GetScene();
+    BenchResult serial =
+        measure("px_raycast_serial", count, options.minTime, [&]() {
+          size_t hitCount = 0;
+          for (const RaycastQuery &ray : rays) {
+            glm::vec3 direction = glm::normalize(ray.direction);
+            PxRaycastBuffer buffer;
+            hitCount += scene->raycast(
+                PxVec3(ray.origin.x, ray.origin.y, ray.origin.z),
+                PxVec3(direction.x, direction.y, direction.z),
+                ray.maxDistance, buffer);
+          }
+          doNotOptimize(hitCount);
+        });
+    serial.queries = rays.size();
+    results.push_back(serial);
+
+    size_t hitCount = 0;
+    for (const QueryHit &hit : hits) {
+      hitCount += hit.hit;
+    }
+    std::cerr << "  " << hitCount << " of " << rays.size() << " rays hit"
+              << std::endl;
+  }
+}
+
+// Simulates the layout once per profile and measures what every step cost
+// and where the bodies ended up
+void runSweep(size_t count, const BenchOptions &options,
+              const std::vector<PhysicsProfile> &profiles,
+              std::vector<SweepResult> &results) {
+  std::vector<SpawnDesc> spawns;
+  GenerateLayout(options.sweepLayout, static_cast<int>(count), spawns);
+  // Centered on the origin, where MBP places its regions
+  glm::vec3 center(0.0f);
+  for (const SpawnDesc &spawn : spawns) {
+    center += spawn.position;
+  }
+  center = center / std::max<float>(spawns.size(), 1.0f);
+  for (SpawnDesc &spawn : spawns) {
+    spawn.position.x -= center.x;
+    spawn.position.y -= center.y;
+  }
+  // Grids and drops fall into piles, only stacks and pyramids hold still
+  bool resting =
+      options.sweepLayout == "stack" || options.sweepLayout == "pyramid";
+
+  for (const PhysicsProfile &profile : profiles) {
+    std::cerr << "Sweeping " << profile.name << " with " << spawns.size()
+              << " entities" << std::endl;
+    World world(ThreadPoolDesc(), profile);
+    std::vector<Entity> entities;
+    world.SpawnBatch(spawns, nullptr, &entities);
+
+    std::vector<double> stepMs;
+    stepMs.reserve(options.sweepSteps);
+    double simulateMs = 0.0;
+    for (int i = 0; i < options.sweepSteps; i++) {
+      auto start = Clock::now();
+      world.Step(1.0f / 60.0f);
+      stepMs.push_back(std::chrono::duration<double, std::milli>(
+                           Clock::now() - start)
+                           .count());
+      simulateMs += world.GetPhysicsSystem()->getOverlapStats().simulateMs;
+    }
+
+    SweepResult result;
+    result.profile = profile.name;
+    result.entities = spawns.size();
+    result.steps = options.sweepSteps;
+    double totalMs = 0.0;
+    for (double ms : stepMs) {
+      totalMs += ms;
+    }
+    std::sort(stepMs.begin(), stepMs.end());
+    result.stepMeanMs = totalMs / stepMs.size();
+    result.stepP99Ms = stepMs[std::min<size_t>(stepMs.size() - 1,
+                                               stepMs.size() * 99 / 100)];
+    result.simulateMeanMs = simulateMs / options.sweepSteps;
+
+    size_t asleep = 0;
+    Registry &registry = world.GetRegistry();
+    for (size_t i = 0; i < entities.size(); i++) {
+      const glm::vec3 &position =
+          registry.get<TransformComponent>(entities[i])->position;
+      if (!std::isfinite(position.z) || position.z < -1.0f) {
+        result.fallen++;
+        continue;
+      }
+      float dx = position.x - spawns[i].position.x;
+      float dy = position.y - spawns[i].position.y;
+      result.maxDrift = std::max(result.maxDrift, std::sqrt(dx * dx + dy * dy));
+      PxRigidDynamic *actor = registry.get<PhysicsComponent>(entities[i])->actor;
+      asleep += actor->isSleeping();
+    }
+    result.asleepFraction =
+        entities.empty() ? 1.0 : double(asleep) / entities.size();
+    result.stable =
+        result.fallen == 0 && (!resting || result.maxDrift < 0.25f);
+    results.push_back(result);
+  }
+}
+
+void writeJson(std::ostream &out, const std::vector<BenchResult> &results,
+               const std::vector<SweepResult> &sweep) {
+  out << "{\n";
+#ifdef NDEBUG
+  out << "  \"build\": \"release\",\n";
+#else
+  out << "  \"build\": \"debug\",\n";
+#endif
+  out << "  \"simd\": \"" << SimdLevelName(BestSimdLevel()) << "\",\n";
+  out << "  \"benchmarks\": [\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchResult &r = results[i];
+    double perIteration = r.totalNs / r.iterations;
+    out << "    {\"name\": \"" << r.name << "\", \"entities\": " << r.entities
+        << ", \"iterations\": " << r.iterations
+        << ", \"ns_per_iteration\": " << perIteration
+        << ", \"ns_per_entity\": " << perIteration / r.entities;
+    if (r.queries > 0) {
+      out << ", \"queries\": " << r.queries
+          << ", \"ns_per_query\": " << perIteration / r.queries;
+    }
+    out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  out << "  ]";
+  if (!sweep.empty()) {
+    out << ",\n  \"profile_sweep\": [\n";
+    for (size_t i = 0; i < sweep.size(); i++) {
+      const SweepResult &r = sweep[i];
+      out << "    {\"profile\": \"" << r.profile
+          << "\", \"entities\": " << r.entities << ", \"steps\": " << r.steps
+          << ", \"step_mean_ms\": " << r.stepMeanMs
+          << ", \"step_p99_ms\": " << r.stepP99Ms
+          << ", \"simulate_mean_ms\": " << r.simulateMeanMs
+          << ", \"max_drift\": " << r.maxDrift << ", \"fallen\": " << r.fallen
+          << ", \"asleep\": " << r.asleepFraction
+          << ", \"stable\": " << (r.stable ? "true" : "false") << "}"
+          << (i + 1 < sweep.size() ? "," : "") << "\n";
+    }
+    out << "  ]";
+  }
+  out << "\n}\n";
+}
+
+// Fastest stable profile per size, for reading the sweep at a glance
+void printSweepSummary(const std::vector<SweepResult> &sweep) {
+  for (size_t i = 0; i < sweep.size();) {
+    size_t entities = sweep[i].entities;
+    const SweepResult *best = nullptr;
+    for (; i < sweep.size() && sweep[i].entities == entities; i++) {
+      if (sweep[i].stable &&
+          (!best || sweep[i].stepMeanMs < best->stepMeanMs)) {
+        best = &sweep[i];
+      }
+    }
+    std::cerr << entities << " entities: ";
+    if (best) {
+      std::cerr << best->profile << " at " << best->stepMeanMs << " ms/step"
+                << std::endl;
+    } else {
+      std::cerr << "no stable profile" << std::endl;
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  BenchOptions options;
+  if (!parseOptions(argc, argv, options)) {
+    std::cerr << "Usage: ember_bench [--sizes 1000,10000,...] "
+                 "[--min-time SECONDS] [--sim-steps N] [--rays N] "
+                 "[--out FILE] [--sweep builtin|PROFILES_FILE] "
+                 "[--sweep-steps N] [--sweep-layout stack|pyramid|grid|drop]"
+              << std::endl;
+    return 1;
+  }
+
+  std::vector<BenchResult> results;
+  std::vector<SweepResult> sweep;
+  if (!options.sweep.empty()) {
+    std::vector<PhysicsProfile> profiles;
+    std::vector<SpawnDesc> check;
+    try {
+      profiles = options.sweep == "builtin"
+                     ? BuiltinPhysicsProfiles()
+                     : LoadPhysicsProfiles(options.sweep);
+    } catch (const std::exception &error) {
+      std::cerr << error.what() << std::endl;
+      return 1;
+    }
+    if (!GenerateLayout(options.sweepLayout, 1, check)) {
+      std::cerr << "Unknown layout " << options.sweepLayout << std::endl;
+      return 1;
+    }
+    for (size_t size : options.sizes) {
+      runSweep(size, options, profiles, sweep);
+    }
+    printSweepSummary(sweep);
+  } else {
+    for (size_t size : options.sizes) {
+      runSize(size, options, results);
+    }
+  }
+
+  if (options.out.empty()) {
+    writeJson(std::cout, results, sweep);
+  } else {
+    std::ofstream file(options.out);
+    writeJson(file, results, sweep);
+  }
+  return 0;
+}
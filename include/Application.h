@@ -2,15 +2,24 @@
 
 #include "Shader.h"
 #include "Camera.h"
+#include "DebugRenderer.h"
+#include "GpuTimer.h"
 #include "Mesh.h"
+#include "Profiler.h"
+#include "RenderSystem.h"
+#include "SceneGenerators.h"
 #include "World.h"
 
 #include <memory>
+#include <string>
 #include <vector>
 
 class Application {
 public:
-  Application(unsigned int width, unsigned int height, bool fullscreen);
+  // With a replay path the recording is played back instead of simulating,
+  // no physics world is created
+  Application(unsigned int width, unsigned int height, bool fullscreen,
+              const std::string &replayPath = "");
   void Run();
   void Close();
 
@@ -20,6 +29,8 @@ private:
 
   void initImGui();
   void renderImGui();
+  void renderPlayback();
+  void renderProfiler();
 
   static void framebuffer_size_callback(GLFWwindow *window, int width,
                                         int height);
@@ -27,10 +38,48 @@ private:
 private:
   glm::vec2 mResolution;
   std::unique_ptr<GLFWwindow, decltype(&glfwDestroyWindow)> mWindow;
+  std::unique_ptr<ProgramCache> mProgramCache;
   std::unique_ptr<Shader> mShader;
   std::unique_ptr<Camera> mCamera;
 
+  // Declared before everything holding meshes, which release their
+  // geometry into it
+  std::unique_ptr<GeometryPool> mGeometryPool;
   std::unique_ptr<World> mWorld;
+  // Set instead of the world when replaying
+  std::unique_ptr<SimulationPlayback> mPlayback;
+  bool mPlaybackPaused = false;
+  float mPlaybackSpeed = 1.0f;
+  RenderSystem mRenderSystem;
+  std::unique_ptr<Shader> mDebugShader;
+  std::unique_ptr<DebugRenderer> mDebugRenderer;
+  // Applied between frames, the scene must not be simulating
+  bool mDebugVisualization = false;
 
   std::shared_ptr<Mesh> mCubeMesh;
+
+  // Stress scene requested from ImGui, spawned at the start of the next
+  // frame when no physics step is in flight
+  int mSpawnLayout = 0;
+  int mSpawnCount = 1000;
+  bool mSpawnRequested = false;
+  float mLastSpawnMs = 0.0f;
+
+  // Snapshot of the world, saved or restored at the start of the next
+  // frame like spawns
+  bool mSaveRequested = false;
+  bool mLoadRequested = false;
+  std::string mSnapshotStatus;
+
+  // Recording toggled from ImGui, started or stopped between frames
+  bool mRecordToggleRequested = false;
+  std::string mRecordingStatus;
+
+  std::unique_ptr<GpuTimer> mGpuTimer;
+  // Frame shown in the profiler timeline, kept while frozen
+  std::vector<ProfileTrack> mProfiledTracks;
+  int64_t mProfiledFrameStart = 0;
+  int64_t mProfiledFrameEnd = 0;
+  bool mProfilerFrozen = false;
+  std::string mTraceStatus;
 };
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Bounds.h"
+
+#include <cstdint>
+#include <vector>
+
+// Dynamic AABB tree. Leaves hold boxes inflated by a margin so objects can
+// move a little without touching the tree; a leaf is only reinserted when
+// its object leaves the inflated box. Insertion picks the sibling with the
+// lowest surface area cost and rotations keep the tree balanced.
+class BoundingVolumeHierarchy {
+public:
+  static constexpr int32_t Null = -1;
+
+  explicit BoundingVolumeHierarchy(float margin = 0.5f) : mMargin(margin) {}
+
+  // Returns the leaf that now stores box, userData is handed to queries
+  int32_t insert(const AABB &box, uint32_t userData);
+  void remove(int32_t leaf);
+  // Refits the leaf to box. Returns true if the leaf had to be reinserted.
+  bool update(int32_t leaf, const AABB &box);
+
+  // Fat box stored for the leaf
+  const AABB &getBounds(int32_t leaf) const { return mNodes[leaf].box; }
+  size_t size() const { return mLeafCount; }
+  int height() const { return mRoot == Null ? 0 : mNodes[mRoot].height; }
+
+  // Calls func(userData) for every leaf whose fat box touches the frustum.
+  // Subtrees fully inside the frustum are reported without further tests.
+  template <typename Func> void queryFrustum(const Frustum &frustum,
+                                             Func &&func) {
+    if (mRoot == Null) {
+      return;
+    }
+    mStack.clear();
+    mStack.push_back({mRoot, false});
+    while (!mStack.empty()) {
+      StackEntry entry = mStack.back();
+      mStack.pop_back();
+      const Node &node = mNodes[entry.node];
+
+      bool inside = entry.inside;
+      if (!inside) {
+        FrustumTest result = frustum.test(node.box);
+        if (result == FrustumTest::Outside) {
+          continue;
+        }
+        inside = result == FrustumTest::Inside;
+      }
+
+      if (node.isLeaf()) {
+        func(node.userData);
+      } else {
+        mStack.push_back({node.child1, inside});
+        mStack.push_back({node.child2, inside});
+      }
+    }
+  }
+
+private:
+  struct Node {
+    AABB box;
+    int32_t parent = Null;
+    int32_t child1 = Null;
+    int32_t child2 = Null;
+    // Next free node while the node sits in the free list
+    int32_t next = Null;
+    // 0 for leaves, -1 for free nodes
+    int32_t height = 0;
+    uint32_t userData = 0;
+
+    bool isLeaf() const { return child1 == Null; }
+  };
+
+  struct StackEntry {
+    int32_t node;
+    bool inside;
+  };
+
+  int32_t allocateNode();
+  void freeNode(int32_t index);
+  void insertLeaf(int32_t leaf);
+  void removeLeaf(int32_t leaf);
+  int32_t balance(int32_t index);
+  void replaceChild(int32_t parent, int32_t oldChild, int32_t newChild);
+
+  std::vector<Node> mNodes;
+  std::vector<StackEntry> mStack;
+  int32_t mRoot = Null;
+  int32_t mFreeList = Null;
+  size_t mLeafCount = 0;
+  float mMargin;
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define EMBER_FRUSTUM_SSE 1
+#endif
+
+// Axis aligned box. A default constructed box is empty, merging anything
+// into it yields that thing.
+struct AABB {
+  glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+  glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+  bool isEmpty() const {
+    return min.x > max.x || min.y > max.y || min.z > max.z;
+  }
+  glm::vec3 center() const { return (min + max) * 0.5f; }
+  glm::vec3 extents() const { return (max - min) * 0.5f; }
+
+  void expand(const glm::vec3 &point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+
+  bool contains(const AABB &other) const {
+    return min.x <= other.min.x && min.y <= other.min.y &&
+           min.z <= other.min.z && max.x >= other.max.x &&
+           max.y >= other.max.y && max.z >= other.max.z;
+  }
+
+  // Half the surface area, enough to compare boxes
+  float halfArea() const {
+    glm::vec3 d = max - min;
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+  }
+};
+
+inline AABB Merge(const AABB &a, const AABB &b) {
+  AABB box;
+  box.min = glm::min(a.min, b.min);
+  box.max = glm::max(a.max, b.max);
+  return box;
+}
+
+inline AABB Inflate(const AABB &box, float margin) {
+  AABB inflated;
+  inflated.min = box.min - glm::vec3(margin);
+  inflated.max = box.max + glm::vec3(margin);
+  return inflated;
+}
+
+// Smallest box around the transformed box, without visiting the corners
+inline AABB TransformAABB(const AABB &box, const glm::mat4 &matrix) {
+  glm::vec3 center = glm::vec3(matrix * glm::vec4(box.center(), 1.0f));
+  glm::vec3 extents = box.extents();
+  glm::vec3 rotated;
+  for (int row = 0; row < 3; row++) {
+    rotated[row] = std::abs(matrix[0][row]) * extents.x +
+                   std::abs(matrix[1][row]) * extents.y +
+                   std::abs(matrix[2][row]) * extents.z;
+  }
+  AABB result;
+  result.min = center - rotated;
+  result.max = center + rotated;
+  return result;
+}
+
+enum class FrustumTest { Outside, Intersecting, Inside };
+
+// The six clip planes of a view-projection matrix, stored as structure of
+// arrays so four planes are tested per SSE instruction. The last two slots
+// repeat the far plane to pad to eight.
+struct Frustum {
+  alignas(16) float nx[8];
+  alignas(16) float ny[8];
+  alignas(16) float nz[8];
+  alignas(16) float d[8];
+
+  static Frustum FromMatrix(const glm::mat4 &viewProjection) {
+    // glm is column major, row i of the matrix is (m[0][i] .. m[3][i])
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+      rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i],
+                          viewProjection[2][i], viewProjection[3][i]);
+    }
+    glm::vec4 planes[6] = {rows[3] + rows[0], rows[3] - rows[0],
+                           rows[3] + rows[1], rows[3] - rows[1],
+                           rows[3] + rows[2], rows[3] - rows[2]};
+
+    Frustum frustum;
+    for (int i = 0; i < 8; i++) {
+      glm::vec4 plane = planes[std::min(i, 5)];
+      plane /= glm::length(glm::vec3(plane));
+      frustum.nx[i] = plane.x;
+      frustum.ny[i] = plane.y;
+      frustum.nz[i] = plane.z;
+      frustum.d[i] = plane.w;
+    }
+    return frustum;
+  }
+
+  FrustumTest test(const AABB &box) const {
+    glm::vec3 c = box.center();
+    glm::vec3 e = box.extents();
+#ifdef EMBER_FRUSTUM_SSE
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y),
+           cz = _mm_set1_ps(c.z);
+    __m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y),
+           ez = _mm_set1_ps(e.z);
+    int outside = 0;
+    int straddling = 0;
+    for (int i = 0; i < 8; i += 4) {
+      __m128 px = _mm_load_ps(nx + i), py = _mm_load_ps(ny + i),
+             pz = _mm_load_ps(nz + i);
+      // Signed distance of the center and projected radius of the box
+      __m128 dist = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)),
+          _mm_add_ps(_mm_mul_ps(pz, cz), _mm_load_ps(d + i)));
+      __m128 radius = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, px), ex),
+                     _mm_mul_ps(_mm_andnot_ps(signMask, py), ey)),
+          _mm_mul_ps(_mm_andnot_ps(signMask, pz), ez));
+      outside |= _mm_movemask_ps(
+          _mm_cmplt_ps(_mm_add_ps(dist, radius), _mm_setzero_ps()));
+      straddling |= _mm_movemask_ps(_mm_cmplt_ps(dist, radius));
+    }
+#else
+    bool outside = false;
+    bool straddling = false;
+    for (int i = 0; i < 6; i++) {
+      float dist = nx[i] * c.x + ny[i] * c.y + nz[i] * c.z + d[i];
+      float radius = std::abs(nx[i]) * e.x + std::abs(ny[i]) * e.y +
+                     std::abs(nz[i]) * e.z;
+      outside |= dist + radius < 0.0f;
+      straddling |= dist < radius;
+    }
+#endif
+    if (outside) {
+      return FrustumTest::Outside;
+    }
+    return straddling ? FrustumTest::Intersecting : FrustumTest::Inside;
+  }
+};
@@ -11,16 +11,22 @@
 
 #include "Shader.h"
 
+// Binding point of the CameraBlock uniform block in the shaders
+constexpr GLuint CameraBlockBinding = 0;
+
 class Camera {
 public:
   Camera(int width, int height, glm::vec3 position);
 
   void updateMatrix();
-  void Matrix(Shader &shader, const char *uniform);
+  // Uploads matrix and position into the camera uniform buffer, once a frame
+  void UploadUniforms();
   void Inputs(GLFWwindow *window, float ts);
   void OnResize(const glm::vec2 &newResolution);
 
   glm::vec3 &GetPosition() { return mPosition; }
+  // Projection * view as of the last updateMatrix
+  const glm::mat4 &GetMatrix() const { return mMatrix; }
 
 private:
   glm::ivec2 mResolution;
@@ -30,6 +36,7 @@ private:
   glm::vec3 mUp;
   float mAspectRatio;
   glm::mat4 mMatrix;
+  GLuint mUBO;
 
   float mMoveSpeed = 5;
   float mRotateSpeed = 1;
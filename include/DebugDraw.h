@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Bounds.h"
+#include "PxPhysicsAPI.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <vector>
+
+using namespace physx;
+
+// Layout of a debug line end point as DebugRenderer streams it. Colors are
+// 0xAARRGGBB like PxDebugColor.
+struct DebugVertex {
+  float x, y, z;
+  uint32_t color;
+};
+
+// Collects line segments in engine coordinates for one frame. Does not
+// touch GL, see DebugRenderer for drawing.
+class DebugDraw {
+public:
+  static constexpr uint32_t Red = 0xffff0000;
+  static constexpr uint32_t Green = 0xff00ff00;
+  static constexpr uint32_t Blue = 0xff0000ff;
+  static constexpr uint32_t Yellow = 0xffffff00;
+  static constexpr uint32_t White = 0xffffffff;
+  static constexpr uint32_t Grey = 0xff808080;
+
+  void addLine(const glm::vec3 &a, const glm::vec3 &b, uint32_t color) {
+    mVertices.push_back({a.x, a.y, a.z, color});
+    mVertices.push_back({b.x, b.y, b.z, color});
+  }
+
+  // Oriented box given by its center, half extents and rotation
+  void addBox(const glm::vec3 &center, const glm::vec3 &halfExtents,
+              const glm::quat &rotation, uint32_t color) {
+    glm::vec3 corners[8];
+    for (int i = 0; i < 8; i++) {
+      glm::vec3 offset((i & 1) ? halfExtents.x : -halfExtents.x,
+                       (i & 2) ? halfExtents.y : -halfExtents.y,
+                       (i & 4) ? halfExtents.z : -halfExtents.z);
+      corners[i] = center + rotation * offset;
+    }
+    addCorners(corners, color);
+  }
+
+  void addAABB(const AABB &box, uint32_t color) {
+    glm::vec3 corners[8];
+    for (int i = 0; i < 8; i++) {
+      corners[i] = glm::vec3((i & 1) ? box.max.x : box.min.x,
+                             (i & 2) ? box.max.y : box.min.y,
+                             (i & 4) ? box.max.z : box.min.z);
+    }
+    addCorners(corners, color);
+  }
+
+  // Appends what PhysX visualized in the last step. Points become small
+  // crosses and triangles their outlines.
+  void addRenderBuffer(const PxRenderBuffer &buffer) {
+    const PxDebugLine *lines = buffer.getLines();
+    for (PxU32 i = 0; i < buffer.getNbLines(); i++) {
+      push(lines[i].pos0, lines[i].color0);
+      push(lines[i].pos1, lines[i].color1);
+    }
+
+    const PxDebugTriangle *triangles = buffer.getTriangles();
+    for (PxU32 i = 0; i < buffer.getNbTriangles(); i++) {
+      const PxDebugTriangle &t = triangles[i];
+      push(t.pos0, t.color0);
+      push(t.pos1, t.color1);
+      push(t.pos1, t.color1);
+      push(t.pos2, t.color2);
+      push(t.pos2, t.color2);
+      push(t.pos0, t.color0);
+    }
+
+    const float size = 0.05f;
+    const PxDebugPoint *points = buffer.getPoints();
+    for (PxU32 i = 0; i < buffer.getNbPoints(); i++) {
+      const PxVec3 &p = points[i].pos;
+      for (int axis = 0; axis < 3; axis++) {
+        PxVec3 offset(0.0f);
+        offset[axis] = size;
+        push(p - offset, points[i].color);
+        push(p + offset, points[i].color);
+      }
+    }
+  }
+
+  void clear() { mVertices.clear(); }
+  bool empty() const { return mVertices.empty(); }
+  const std::vector<DebugVertex> &vertices() const { return mVertices; }
+
+private:
+  void push(const PxVec3 &p, uint32_t color) {
+    mVertices.push_back({p.x, p.y, p.z, color});
+  }
+
+  // Corner i has the maximum on axis k when bit k of i is set
+  void addCorners(const glm::vec3 (&corners)[8], uint32_t color) {
+    static const int edges[12][2] = {{0, 1}, {2, 3}, {4, 5}, {6, 7},
+                                     {0, 2}, {1, 3}, {4, 6}, {5, 7},
+                                     {0, 4}, {1, 5}, {2, 6}, {3, 7}};
+    for (const auto &edge : edges) {
+      addLine(corners[edge[0]], corners[edge[1]], color);
+    }
+  }
+
+  std::vector<DebugVertex> mVertices;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "DebugDraw.h"
+#include "Shader.h"
+
+#include <initializer_list>
+
+// Draws DebugDraw lines in a single call. Vertices are streamed through one
+// buffer split into three regions that are written in turn: a fence after
+// each draw tells when the GPU is done with a region, so the CPU fills the
+// next one while the previous frames are still being drawn. With GL 4.4 or
+// ARB_buffer_storage the buffer stays mapped for its whole life, otherwise
+// every frame orphans and re-uploads it.
+class DebugRenderer {
+public:
+  // maxVertices is the per frame limit, anything beyond is dropped
+  explicit DebugRenderer(size_t maxVertices = 1 << 18);
+  ~DebugRenderer();
+
+  DebugRenderer(const DebugRenderer &) = delete;
+  DebugRenderer &operator=(const DebugRenderer &) = delete;
+
+  // The shader must take the debug_vert.glsl inputs
+  void draw(Shader &shader, std::initializer_list<const DebugDraw *> lists);
+
+  bool isPersistentlyMapped() const { return mMapped != nullptr; }
+  size_t getVertexCount() const { return mVertexCount; }
+  size_t getDroppedVertexCount() const { return mDroppedVertexCount; }
+
+private:
+  static constexpr int RegionCount = 3;
+
+  void waitForRegion(int region);
+
+  GLuint mVAO = 0;
+  GLuint mBuffer = 0;
+  size_t mMaxVertices;
+  DebugVertex *mMapped = nullptr;
+  GLsync mFences[RegionCount] = {};
+  int mRegion = 0;
+
+  size_t mVertexCount = 0;
+  size_t mDroppedVertexCount = 0;
+};
@@ -2,13 +2,30 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
+// GL_UNSIGNED_SHORT when every index of a mesh fits in 16 bits
+inline GLenum IndexTypeFor(size_t vertexCount) {
+  return vertexCount <= 0x10000 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+inline size_t IndexSize(GLenum type) {
+  return type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(GLuint);
+}
+
+inline std::vector<uint16_t> NarrowIndices(const GLuint *indices,
+                                           size_t count) {
+  return std::vector<uint16_t>(indices, indices + count);
+}
+
 class EBO {
 public:
   GLuint ID;
 
   EBO(std::vector<GLuint>& indices);
+  EBO(GLsizeiptr size, const void *data);
 
   void Bind();
   void Unbind();
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "EBO.h"
+#include "RangeAllocator.h"
+#include "VAO.h"
+
+#include <cstdint>
+#include <vector>
+
+// Layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+  GLuint count;
+  GLuint instanceCount;
+  GLuint firstIndex;
+  GLint baseVertex;
+  GLuint baseInstance;
+};
+
+// Static meshes sub-allocated from one vertex and one index buffer that
+// share a VAO, so any mix of them is drawn with a single
+// glMultiDrawElementsIndirect. Indices are 16 bit and relative to the
+// mesh's first vertex, so a mesh can have at most 65536 vertices.
+//
+// Removing meshes leaves holes that later meshes reuse. When no hole is
+// large enough the buffers are compacted, and grown if that is not enough
+// either. Both copy on the GPU and keep mesh ids stable.
+class GeometryPool {
+public:
+  using MeshId = uint32_t;
+  static constexpr MeshId InvalidId = UINT32_MAX;
+
+  explicit GeometryPool(VertexFormat format = VertexFormat::Packed,
+                        size_t vertexCapacity = 1 << 18,
+                        size_t indexCapacity = 1 << 20);
+  ~GeometryPool();
+
+  GeometryPool(const GeometryPool &) = delete;
+  GeometryPool &operator=(const GeometryPool &) = delete;
+
+  // vertexData is laid out as getFormat(). Throws std::runtime_error for
+  // meshes with more than 65536 vertices.
+  MeshId add(const void *vertexData, size_t vertexCount,
+             const uint16_t *indices, size_t indexCount);
+  void remove(MeshId id);
+
+  // Command drawing instanceCount instances of the mesh, reading model
+  // matrices from baseInstance on
+  DrawElementsIndirectCommand command(MeshId id, GLuint instanceCount,
+                                      GLuint baseInstance) const;
+  // One multi draw for all commands, models holds every instance's model
+  // matrix. The shader must already be active.
+  void draw(GLenum mode, const DrawElementsIndirectCommand *commands,
+            size_t commandCount, const glm::mat4 *models, size_t modelCount);
+
+  // Moves every mesh to the front of the buffers, closing all holes
+  void defragment();
+
+  VertexFormat getFormat() const { return mFormat; }
+  size_t getMeshCount() const { return mMeshCount; }
+  const RangeAllocator &getVertexAllocator() const { return mVertices; }
+  const RangeAllocator &getIndexAllocator() const { return mIndices; }
+
+private:
+  struct Allocation {
+    size_t vertexOffset = 0;
+    size_t vertexCount = 0;
+    size_t indexOffset = 0;
+    size_t indexCount = 0;
+    bool live = false;
+  };
+
+  // Copies every live mesh, compacted, into new buffers of the given
+  // capacities
+  void relocate(size_t vertexCapacity, size_t indexCapacity);
+  void linkVertexArray();
+
+  VertexFormat mFormat;
+  size_t mVertexStride;
+  VAO mVAO;
+  VBO mVertexBuffer;
+  EBO mIndexBuffer;
+  VBO mInstanceBuffer;
+  GLsizeiptr mInstanceCapacity = 0;
+  GLuint mIndirectBuffer = 0;
+  GLsizeiptr mIndirectCapacity = 0;
+
+  RangeAllocator mVertices;
+  RangeAllocator mIndices;
+  std::vector<Allocation> mAllocations;
+  std::vector<MeshId> mFreeIds;
+  size_t mMeshCount = 0;
+};
+
+// Owns one mesh in a pool and removes it when destroyed. Move only. The
+// pool must outlive it.
+class PooledGeometry {
+public:
+  PooledGeometry() = default;
+  PooledGeometry(GeometryPool *pool, GeometryPool::MeshId id)
+      : mPool(pool), mId(id) {}
+  ~PooledGeometry() { reset(); }
+
+  PooledGeometry(PooledGeometry &&other) noexcept
+      : mPool(other.mPool), mId(other.mId) {
+    other.mPool = nullptr;
+    other.mId = GeometryPool::InvalidId;
+  }
+  PooledGeometry &operator=(PooledGeometry &&other) noexcept {
+    if (this != &other) {
+      reset();
+      mPool = other.mPool;
+      mId = other.mId;
+      other.mPool = nullptr;
+      other.mId = GeometryPool::InvalidId;
+    }
+    return *this;
+  }
+  PooledGeometry(const PooledGeometry &) = delete;
+  PooledGeometry &operator=(const PooledGeometry &) = delete;
+
+  void reset() {
+    if (mPool) {
+      mPool->remove(mId);
+    }
+    mPool = nullptr;
+    mId = GeometryPool::InvalidId;
+  }
+
+  GeometryPool *pool() const { return mPool; }
+  GeometryPool::MeshId id() const { return mId; }
+
+private:
+  GeometryPool *mPool = nullptr;
+  GeometryPool::MeshId mId = GeometryPool::InvalidId;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// GPU time of named passes, measured with GL_TIME_ELAPSED queries. Results
+// are read FramesInFlight frames after they were issued, by which time the
+// GPU is normally done with them, so reading never stalls. A frame whose
+// queries are still pending when its slot comes around again is dropped.
+//
+// GL_TIME_ELAPSED queries can't nest, passes must follow one another.
+// Finished passes also go to the profiler's "GPU" track, placed at the
+// CPU time they were issued.
+class GpuTimer {
+public:
+  static constexpr size_t FramesInFlight = 4;
+
+  struct PassTime {
+    const char *name;
+    float ms;
+  };
+
+  GpuTimer();
+  ~GpuTimer();
+
+  GpuTimer(const GpuTimer &) = delete;
+  GpuTimer &operator=(const GpuTimer &) = delete;
+
+  // The name must outlive the timer
+  void begin(const char *name);
+  void end();
+  // Collects the oldest frame in flight and starts a new one
+  void endFrame();
+
+  // Passes of the newest frame that was read back
+  const std::vector<PassTime> &getResults() const { return mResults; }
+  size_t getDroppedFrames() const { return mDroppedFrames; }
+
+private:
+  struct Pass {
+    const char *name;
+    GLuint query;
+    int64_t cpuStartNs;
+  };
+  struct Frame {
+    std::vector<Pass> passes;
+    // Queries are kept across frames, passes use the first ones
+    std::vector<GLuint> queries;
+  };
+
+  void collect(Frame &frame);
+
+  Frame mFrames[FramesInFlight];
+  size_t mCurrent = 0;
+  bool mActive = false;
+  std::vector<PassTime> mResults;
+  size_t mDroppedFrames = 0;
+  int mTrack;
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Just enough JSON for glTF. Parse errors throw std::runtime_error, as do
+// lookups of missing keys or indices through operator[].
+class JsonValue {
+public:
+  enum class Type { Null, Bool, Number, String, Array, Object };
+
+  static JsonValue Parse(const std::string &text);
+
+  Type getType() const { return mType; }
+  bool isNull() const { return mType == Type::Null; }
+  bool isArray() const { return mType == Type::Array; }
+  bool isObject() const { return mType == Type::Object; }
+
+  bool asBool() const;
+  double asNumber() const;
+  int asInt() const { return static_cast<int>(asNumber()); }
+  const std::string &asString() const;
+
+  // Elements of an array, empty for every other type
+  const std::vector<JsonValue> &items() const { return mArray; }
+  // Keys and values of an object in file order, empty for every other type
+  const std::vector<std::pair<std::string, JsonValue>> &members() const {
+    return mObject;
+  }
+  size_t size() const { return isObject() ? mObject.size() : mArray.size(); }
+
+  // nullptr if this is not an object or has no such key
+  const JsonValue *find(const std::string &key) const;
+  const JsonValue &operator[](const std::string &key) const;
+  const JsonValue &operator[](size_t index) const;
+
+  // Number stored under key, or fallback if there is none
+  double numberOr(const std::string &key, double fallback) const;
+
+private:
+  friend class JsonParser;
+
+  Type mType = Type::Null;
+  bool mBool = false;
+  double mNumber = 0.0;
+  std::string mString;
+  std::vector<JsonValue> mArray;
+  std::vector<std::pair<std::string, JsonValue>> mObject;
+};
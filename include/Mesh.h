@@ -2,30 +2,97 @@
 
 #include <string>
 
+#include "Bounds.h"
 #include "Camera.h"
+#include "Transform.h"
 #include "EBO.h"
+#include "GeometryPool.h"
 #include "VAO.h"
 
+struct MeshLoadOptions {
+  // Read and write "<path>.emsh" next to the source file
+  bool useCache = true;
+  // Keep the vertices and indices around for GetVertices and GetIndices
+  bool keepCpuData = false;
+  // GPU storage, the cache is written in this format as well. Meshes whose
+  // bounds half floats can't represent precisely are stored as floats.
+  VertexFormat format = VertexFormat::Packed;
+  // Weld, vertex cache and fetch order the geometry before it is cached
+  bool optimize = true;
+  // Place the mesh in this pool, which then decides the format. Meshes the
+  // pool cannot hold get their own buffers.
+  GeometryPool *pool = nullptr;
+};
+
 class Mesh {
 public:
-  Mesh(std::vector<Vertex> &vertices, std::vector<GLuint> &indices);
+  Mesh(std::vector<Vertex> &vertices, std::vector<GLuint> &indices,
+       VertexFormat format = VertexFormat::Float,
+       GeometryPool *pool = nullptr);
+  // Uploads straight from the given memory, which may be a mapped file. No
+  // CPU copy is kept. bounds is computed from the vertices when null. With
+  // a pool the mesh is stored there, in the pool's format, when it fits.
+  Mesh(const Vertex *vertices, size_t vertexCount, const GLuint *indices,
+       size_t indexCount, const AABB *bounds = nullptr,
+       VertexFormat format = VertexFormat::Float,
+       GeometryPool *pool = nullptr);
+  // vertexData is already laid out as format, indexData holds indexType
+  // indices. The pool is only used if it has the same format.
+  Mesh(const void *vertexData, VertexFormat format, size_t vertexCount,
+       const void *indexData, GLenum indexType, size_t indexCount,
+       const AABB &bounds, GeometryPool *pool = nullptr);
 
-  static Mesh CreateCube(float size);
+  static Mesh CreateCube(float size,
+                         VertexFormat format = VertexFormat::Float,
+                         GeometryPool *pool = nullptr);
+  // Loads an OBJ or glTF file, going through the binary cache when allowed.
+  // Throws std::runtime_error if the file cannot be loaded.
+  static Mesh Load(const std::string &path,
+                   const MeshLoadOptions &options = MeshLoadOptions());
 
   // Draws the mesh
-  void Draw(Shader &shader, Camera &camera, GLuint mode);
+  void Draw(Shader &shader, GLuint mode);
+  // Draws one instance of the mesh per model matrix in a single call. The
+  // shader must already be active.
+  void DrawInstanced(GLuint mode, const glm::mat4 *models, GLsizei count);
 
   // Setters for position, rotation, and scale
   void SetTransform(const glm::mat4 &mat);
   void SetTransform(const glm::vec3& pos, const glm::quat& rot);
 
-  std::vector<Vertex> GetVertices() { return mVertices; }
-  std::vector<GLuint> GetIndices() { return mIndices; }
+  // Empty once ReleaseCpuData has been called
+  const std::vector<Vertex> &GetVertices() const { return mVertices; }
+  const std::vector<GLuint> &GetIndices() const { return mIndices; }
+  // Frees the CPU side copy, the GPU buffers stay
+  void ReleaseCpuData();
+  GLsizei GetIndexCount() const { return mIndexCount; }
+  VertexFormat GetVertexFormat() const { return mFormat; }
+  // GL_UNSIGNED_SHORT unless the mesh has more than 65536 vertices
+  GLenum GetIndexType() const { return mIndexType; }
+  // Pool holding the geometry, null if the mesh has its own buffers
+  GeometryPool *GetGeometryPool() const { return mPooled.pool(); }
+  GeometryPool::MeshId GetPoolId() const { return mPooled.id(); }
+  // Box around the vertex positions in model space, used for culling
+  const AABB &GetBounds() const { return mBounds; }
 
 private:
   std::vector<Vertex> mVertices;
   std::vector<GLuint> mIndices;
+  GLsizei mIndexCount = 0;
+  GLenum mIndexType = GL_UNSIGNED_INT;
+  VertexFormat mFormat = VertexFormat::Float;
+  AABB mBounds;
   VAO mVAO;
+  VBO mInstanceVBO;
+  GLsizeiptr mInstanceCapacity = 0;
+  PooledGeometry mPooled;
 
   glm::mat4 mModel = glm::mat4(1.0f);
+
+  void upload(const void *vertexData, size_t vertexCount,
+              const void *indexData, GLenum indexType, size_t indexCount,
+              GeometryPool *pool);
+  void uploadVertices(const Vertex *vertices, size_t vertexCount,
+                      const GLuint *indices, size_t indexCount,
+                      GeometryPool *pool);
 };
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Bounds.h"
+#include "EBO.h"
+#include "VertexLayout.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Binary mesh cache, written next to the source file as "<source>.emsh".
+// The vertex and index blocks are stored exactly as the VBO and EBO expect
+// them, in the mesh's VertexFormat, so a mapped file is handed to
+// glBufferData without any copy.
+//
+// Layout: MeshCacheHeader, then vertices at vertexOffset and indices at
+// indexOffset, both 16 byte aligned. Integers are little endian.
+struct MeshCacheHeader {
+  static constexpr uint32_t Magic = 0x48534d45; // "EMSH"
+  // Bump whenever Vertex or this header changes
+  static constexpr uint32_t CurrentVersion = 3;
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t vertexStride;
+  // 2 or 4 bytes
+  uint32_t indexSize;
+  uint32_t vertexFormat;
+  uint32_t reserved;
+  uint64_t vertexCount;
+  uint64_t indexCount;
+  uint64_t vertexOffset;
+  uint64_t indexOffset;
+  float boundsMin[3];
+  float boundsMax[3];
+  // Size and modification time of the file the cache was built from
+  uint64_t sourceSize;
+  int64_t sourceMTime;
+};
+
+// Path of the cache for a source mesh file
+std::string MeshCachePath(const std::string &sourcePath);
+
+// Writes to a temporary file and renames it over cachePath, so readers
+// never map a half written cache. Throws std::runtime_error on failure.
+void WriteMeshCache(const std::string &cachePath, const std::string &sourcePath,
+                    const void *vertexData, VertexFormat format,
+                    size_t vertexCount, const void *indexData,
+                    GLenum indexType, size_t indexCount, const AABB &bounds);
+
+// Read only mapping of a cache file
+class MappedMesh {
+public:
+  MappedMesh() = default;
+  ~MappedMesh();
+
+  MappedMesh(const MappedMesh &) = delete;
+  MappedMesh &operator=(const MappedMesh &) = delete;
+
+  // Maps cachePath and validates it. Returns false if the file is missing,
+  // corrupt, from another format version or older than sourcePath.
+  bool open(const std::string &cachePath, const std::string &sourcePath);
+  void close();
+
+  bool isOpen() const { return mData != nullptr; }
+  const MeshCacheHeader &header() const { return *mHeader; }
+  VertexFormat vertexFormat() const {
+    return static_cast<VertexFormat>(mHeader->vertexFormat);
+  }
+  const void *vertexData() const;
+  const void *indexData() const;
+  GLenum indexType() const {
+    return mHeader->indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT
+                                                  : GL_UNSIGNED_INT;
+  }
+  size_t vertexCount() const { return mHeader->vertexCount; }
+  size_t indexCount() const { return mHeader->indexCount; }
+  AABB bounds() const;
+
+private:
+  void *mData = nullptr;
+  size_t mSize = 0;
+  const MeshCacheHeader *mHeader = nullptr;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "VBO.h"
+
+#include <string>
+#include <vector>
+
+// Geometry as parsed from a file, indexed triangles
+struct MeshData {
+  std::vector<Vertex> vertices;
+  std::vector<GLuint> indices;
+};
+
+// Wavefront OBJ. Polygons are fanned into triangles, "v x y z r g b"
+// vertex colors are picked up and faces without normals get smooth ones.
+MeshData LoadOBJ(const std::string &path);
+
+// glTF 2.0, either .gltf with external or base64 embedded buffers or a
+// .glb. All triangle primitives of all meshes are merged; node transforms
+// are not applied.
+MeshData LoadGLTF(const std::string &path);
+
+// Picks the loader by extension. Throws std::runtime_error on failure.
+MeshData LoadMeshFile(const std::string &path);
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "MeshLoader.h"
+
+#include <cstddef>
+
+// Import time optimizations run on freshly loaded geometry before it is
+// uploaded or cached.
+
+// Average cache miss ratio, transformed vertices per triangle, of a FIFO
+// post-transform cache. 0.5 is the best a regular grid gets, 3 means no
+// reuse at all.
+float ComputeACMR(const GLuint *indices, size_t indexCount, size_t vertexCount,
+                  size_t cacheSize = 16);
+
+// Merges bitwise identical vertices, returns how many were removed
+size_t WeldVertices(MeshData &mesh);
+
+// Reorders triangles for the post-transform vertex cache, Tom Forsyth's
+// "Linear-Speed Vertex Cache Optimisation"
+void OptimizeVertexCache(std::vector<GLuint> &indices, size_t vertexCount);
+
+// Reorders vertices by first use so fetches walk the vertex buffer
+// forwards. Unreferenced vertices are dropped.
+void OptimizeVertexFetch(MeshData &mesh);
+
+struct MeshOptimizeStats {
+  size_t verticesBefore = 0;
+  size_t verticesAfter = 0;
+  float acmrBefore = 0.0f;
+  float acmrAfter = 0.0f;
+};
+
+// Weld, cache order and fetch order, in that order
+MeshOptimizeStats OptimizeMesh(MeshData &mesh);
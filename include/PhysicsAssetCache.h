@@ -0,0 +1,94 @@
+#pragma once
+
+#include "PxPhysicsAPI.h"
+
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+
+using namespace physx;
+
+struct PhysicsAssetStats {
+  size_t materials = 0;
+  size_t shapes = 0;
+  // Number of actor attachments across all cached shapes
+  size_t shapeReferences = 0;
+};
+
+// Hands out shared PxMaterials and PxShapes keyed by their parameters, so
+// thousands of identical bodies reference one material and one shape.
+// PhysX reference counts both: the cache holds one reference and every
+// actor the shape is attached to holds another.
+class PhysicsAssetCache {
+public:
+  explicit PhysicsAssetCache(PxPhysics &physics);
+  ~PhysicsAssetCache();
+
+  PhysicsAssetCache(const PhysicsAssetCache &) = delete;
+  PhysicsAssetCache &operator=(const PhysicsAssetCache &) = delete;
+
+  PxMaterial *getMaterial(float staticFriction, float dynamicFriction,
+                          float restitution);
+
+  PxShape *getBoxShape(const PxVec3 &halfExtents, PxMaterial &material);
+  PxShape *getSphereShape(float radius, PxMaterial &material);
+  PxShape *getCapsuleShape(float radius, float halfHeight,
+                           PxMaterial &material);
+
+  // Releases cached shapes and materials nothing else references any more
+  void collectGarbage();
+
+  PhysicsAssetStats getStats() const;
+
+private:
+  struct MaterialKey {
+    float staticFriction;
+    float dynamicFriction;
+    float restitution;
+
+    bool operator==(const MaterialKey &other) const {
+      return staticFriction == other.staticFriction &&
+             dynamicFriction == other.dynamicFriction &&
+             restitution == other.restitution;
+    }
+  };
+
+  struct ShapeKey {
+    PxGeometryType::Enum type;
+    float params[3];
+    const PxMaterial *material;
+
+    bool operator==(const ShapeKey &other) const {
+      return type == other.type && params[0] == other.params[0] &&
+             params[1] == other.params[1] && params[2] == other.params[2] &&
+             material == other.material;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const MaterialKey &key) const {
+      return combine(combine(hash(key.staticFriction),
+                             hash(key.dynamicFriction)),
+                     hash(key.restitution));
+    }
+    size_t operator()(const ShapeKey &key) const {
+      size_t seed = combine(std::hash<int>()(key.type),
+                            std::hash<const void *>()(key.material));
+      for (float param : key.params) {
+        seed = combine(seed, hash(param));
+      }
+      return seed;
+    }
+    static size_t hash(float value) { return std::hash<float>()(value); }
+    static size_t combine(size_t seed, size_t value) {
+      return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+    }
+  };
+
+  PxShape *getShape(const ShapeKey &key, const PxGeometry &geometry,
+                    PxMaterial &material);
+
+  PxPhysics &mPhysics;
+  std::unordered_map<MaterialKey, PxMaterial *, KeyHash> mMaterials;
+  std::unordered_map<ShapeKey, PxShape *, KeyHash> mShapes;
+};
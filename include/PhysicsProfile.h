@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// How PhysicsSystem sets up its scene and the bodies it creates. The
+// defaults match the PhysX defaults the engine always ran with.
+//
+// Profiles are loaded from JSON, either one object or {"profiles": [...]}.
+// Every key is optional and named like the member, enums are lower case
+// strings ("sap", "mbp", "abp", "pabp"; "pgs", "tgs"; "patch",
+// "one_directional", "two_directional"). Unknown keys are errors, so a
+// typo never silently falls back to a default. "pabp" needs PhysX 5.
+struct PhysicsProfile {
+  enum class BroadPhase { SAP, MBP, ABP, PABP };
+  enum class Solver { PGS, TGS };
+  enum class Friction { Patch, OneDirectional, TwoDirectional };
+
+  std::string name = "default";
+
+  BroadPhase broadPhase = BroadPhase::SAP;
+  // MBP only: the ground plane area split into subdivisions^2 regions,
+  // bodies outside of them are not simulated
+  float mbpHalfExtent = 512.0f;
+  int mbpSubdivisions = 4;
+
+  Solver solver = Solver::PGS;
+  Friction friction = Friction::Patch;
+  // Per body, see PxRigidDynamic::setSolverIterationCounts
+  int positionIterations = 4;
+  int velocityIterations = 1;
+
+  // Mass normalized kinetic energy below which bodies may fall asleep,
+  // PhysX's 5e-5 * speed^2 for the default tolerance speed of 10
+  float sleepThreshold = 0.005f;
+  // Below this, bodies in contact are damped to settle stacks, with
+  // stabilization on. PhysX's 2.5e-5 * speed^2.
+  float stabilizationThreshold = 0.0025f;
+  bool stabilization = false;
+  // Persistent contact manifolds, on in PxSceneDesc by default
+  bool pcm = true;
+  // Relative speed below which contacts don't bounce
+  float bounceThreshold = 2.0f;
+};
+
+// Throws std::runtime_error if the file is missing or invalid
+std::vector<PhysicsProfile> LoadPhysicsProfiles(const std::string &path);
+
+// Named variations of the defaults worth comparing on any workload
+std::vector<PhysicsProfile> BuiltinPhysicsProfiles();
+
+const char *BroadPhaseName(PhysicsProfile::BroadPhase broadPhase);
+const char *SolverName(PhysicsProfile::Solver solver);
@@ -1,12 +1,44 @@
+#pragma once
+
+#include "DebugDraw.h"
 #include "Entity.h"
+#include "PhysicsAssetCache.h"
+#include "PhysicsProfile.h"
+#include "Profiler.h"
+#include "Recording.h"
 #include "PxPhysicsAPI.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 #include <memory>
+#include <stdexcept>
 #include <vector>
 
 using namespace physx;
 
+// PxActor::userData of entity owned actors packs the generation in the
+// high and the entity id plus one in the low 32 bits, so actors without an
+// entity (the ground) keep a null userData
+static_assert(sizeof(uintptr_t) >= 8, "userData must hold a 64 bit handle");
+
+inline void *EntityToUserData(Entity entity) {
+  uint64_t packed = (static_cast<uint64_t>(entity.generation) << 32) |
+                    (static_cast<uint64_t>(entity.id) + 1);
+  return reinterpret_cast<void *>(static_cast<uintptr_t>(packed));
+}
+
+inline Entity EntityFromUserData(void *userData) {
+  Entity entity;
+  if (userData) {
+    uint64_t packed = reinterpret_cast<uintptr_t>(userData);
+    entity.id = static_cast<uint32_t>(packed & 0xffffffffu) - 1;
+    entity.generation = static_cast<uint32_t>(packed >> 32);
+  }
+  return entity;
+}
+
 struct PxFoundationDeleter {
   void operator()(PxFoundation *foundation) const {
     if (foundation) {
@@ -31,17 +63,88 @@ struct PxSceneDeleter {
   }
 };
 
-struct PxMaterialDeleter {
-  void operator()(PxMaterial *material) const {
-    if (material) {
-      material->release();
+// Allocator for PhysX that keeps track of how much memory is live. Every
+// block is prefixed with its size, keeping the 16 byte alignment PhysX
+// requires.
+class TrackingAllocator : public PxAllocatorCallback {
+public:
+  void *allocate(size_t size, const char *, const char *, int) override {
+    void *block = nullptr;
+    if (posix_memalign(&block, Alignment, size + Alignment) != 0) {
+      return nullptr;
+    }
+    *static_cast<size_t *>(block) = size;
+    mLiveBytes += size;
+    mLiveAllocations++;
+    return static_cast<char *>(block) + Alignment;
+  }
+
+  void deallocate(void *ptr) override {
+    if (!ptr) {
+      return;
+    }
+    void *block = static_cast<char *>(ptr) - Alignment;
+    mLiveBytes -= *static_cast<size_t *>(block);
+    mLiveAllocations--;
+    free(block);
+  }
+
+  size_t liveBytes() const { return mLiveBytes; }
+  size_t liveAllocations() const { return mLiveAllocations; }
+
+private:
+  static constexpr size_t Alignment = 16;
+
+  std::atomic<size_t> mLiveBytes{0};
+  std::atomic<size_t> mLiveAllocations{0};
+};
+
+// Handed to PxScene::simulate as completion task. PhysX adds a reference
+// when the step starts and removes it once fetchResults can be called, so
+// the last removeReference marks when the simulation really finished.
+class SimulationCompletionTask : public PxBaseTask {
+public:
+  void run() override {}
+  const char *getName() const override { return "Ember.SimulationComplete"; }
+  void addReference() override { mReferences++; }
+  void removeReference() override {
+    if (--mReferences == 0) {
+      mFinishedNs = std::chrono::steady_clock::now().time_since_epoch() /
+                    std::chrono::nanoseconds(1);
     }
   }
+  int32_t getReference() const override { return mReferences; }
+  void release() override {}
+
+  void reset() { mFinishedNs = 0; }
+  // steady_clock time in ns, 0 while the step is still running
+  int64_t finishedNs() const { return mFinishedNs; }
+
+private:
+  std::atomic<int32_t> mReferences{0};
+  std::atomic<int64_t> mFinishedNs{0};
+};
+
+// Timings of the last step that was split with beginStep/endStep
+struct SimulationOverlapStats {
+  // From simulate() until PhysX had the results ready
+  float simulateMs = 0.0f;
+  // Part of simulateMs that ran while the caller did other work
+  float hiddenMs = 0.0f;
+  // Time the caller spent waiting inside fetchResults
+  float blockedMs = 0.0f;
+
+  float hiddenFraction() const {
+    return simulateMs > 0.0f ? hiddenMs / simulateMs : 1.0f;
+  }
 };
 
 class PhysicsSystem {
 public:
-  PhysicsSystem() {
+  // PhysX runs its tasks on the given dispatcher, which must outlive this
+  explicit PhysicsSystem(PxCpuDispatcher &dispatcher,
+                         const PhysicsProfile &profile = PhysicsProfile())
+      : mProfile(profile) {
     // Create foundation
     mFoundation = std::unique_ptr<PxFoundation, PxFoundationDeleter>(
         PxCreateFoundation(PX_PHYSICS_VERSION, mAllocator, mErrorCallback));
@@ -56,66 +159,412 @@ public:
       throw std::runtime_error("Failed to create PhysX Physics.");
     }
 
-    // Create CPU dispatcher
-    mDispatcher = std::unique_ptr<PxDefaultCpuDispatcher>(
-        PxDefaultCpuDispatcherCreate(2));
-    if (!mDispatcher) {
-      throw std::runtime_error("Failed to create CPU dispatcher.");
-    }
+    mAssetCache = std::make_unique<PhysicsAssetCache>(*mPhysics);
 
     // Create scene
     PxSceneDesc sceneDesc(mPhysics->getTolerancesScale());
     sceneDesc.gravity = PxVec3(0.0f, 0.0f, -9.81f);
-    sceneDesc.cpuDispatcher = mDispatcher.get();
+    sceneDesc.cpuDispatcher = &dispatcher;
     sceneDesc.filterShader = PxDefaultSimulationFilterShader;
+    // Lets syncTransforms visit only the bodies that moved
+    sceneDesc.flags |= PxSceneFlag::eENABLE_ACTIVE_ACTORS;
+    applyProfile(sceneDesc);
 
     mScene = std::unique_ptr<PxScene, PxSceneDeleter>(
         mPhysics->createScene(sceneDesc));
     if (!mScene) {
       throw std::runtime_error("Failed to create PhysX Scene.");
     }
+    if (mProfile.broadPhase == PhysicsProfile::BroadPhase::MBP) {
+      addBroadPhaseRegions();
+    }
 
     // Create ground plane
     createGroundPlane();
   }
 
-  ~PhysicsSystem() = default;
+  // Pooled actors are outside the scene, so releasing it would miss them
+  ~PhysicsSystem() {
+    for (PxRigidDynamic *actor : mActorPool) {
+      actor->release();
+    }
+  }
+
+  void update(float deltaTime, Registry &registry) {
+    beginStep(deltaTime);
+    endStep(registry);
+  }
+
+  // Kicks off a step on the PhysX workers and returns immediately. The
+  // scene must not be modified until endStep.
+  void beginStep(float deltaTime) {
+    PROFILE_SCOPE("PhysicsSystem::beginStep");
+    mCompletionTask.reset();
+    mStepStartNs = nowNs();
+    mScene->simulate(deltaTime, &mCompletionTask);
+    mSimulating = true;
+  }
+
+  // Sync point: waits for the running step and copies the results back
+  void endStep(Registry &registry) {
+    fetchStep();
+    syncTransforms(registry);
+  }
+
+  // Waits for the running step and keeps the poses of the bodies it moved.
+  // The registry is left alone until syncTransforms, so the scene can be
+  // modified again while the entities still show the step before.
+  void fetchStep() {
+    PROFILE_SCOPE("PhysicsSystem::fetchStep");
+    int64_t syncNs = nowNs();
+    {
+      PROFILE_SCOPE("fetchResults");
+      mScene->fetchResults(true);
+    }
+    int64_t fetchedNs = nowNs();
+    mSimulating = false;
+    mScene->getSimulationStatistics(mSimulationStats);
+
+    int64_t finishedNs = mCompletionTask.finishedNs();
+    if (finishedNs == 0) {
+      finishedNs = fetchedNs;
+    }
+    mOverlapStats.simulateMs = (finishedNs - mStepStartNs) * 1e-6f;
+    mOverlapStats.hiddenMs =
+        (std::min(finishedNs, syncNs) - mStepStartNs) * 1e-6f;
+    mOverlapStats.blockedMs = (fetchedNs - syncNs) * 1e-6f;
+
+    captureActivePoses();
+    mSyncPending = true;
+  }
+
+  // Copies the poses of the actors PhysX reported as active in the last
+  // simulated step, the active actor list only lasts until the scene
+  // changes
+  void captureActivePoses() {
+    PxU32 activeCount = 0;
+    PxActor **activeActors = mScene->getActiveActors(activeCount);
+    mFetchedPoses.resize(activeCount);
+    for (PxU32 i = 0; i < activeCount; i++) {
+      mFetchedPoses[i].entity = EntityFromUserData(activeActors[i]->userData);
+      mFetchedPoses[i].pose =
+          static_cast<PxRigidActor *>(activeActors[i])->getGlobalPose();
+    }
+  }
+
+  bool isSimulating() const { return mSimulating; }
+  // A step was fetched but its poses are not in the registry yet
+  bool isSyncPending() const { return mSyncPending; }
+  const SimulationOverlapStats &getOverlapStats() const {
+    return mOverlapStats;
+  }
+  // PhysX's counters for the last finished step
+  const PxSimulationStatistics &getSimulationStatistics() const {
+    return mSimulationStats;
+  }
+
+  // Copies the poses of the actors the last fetched step moved back into
+  // their entities' TransformComponents, keeping the pose they replace for
+  // interpolation. Sleeping bodies are never touched, so the cost follows
+  // the number of moving bodies rather than the number of bodies. Entities
+  // destroyed since the fetch are skipped.
+  void syncTransforms(Registry &registry) {
+    PROFILE_SCOPE("PhysicsSystem::syncTransforms");
+    auto &transforms = registry.pool<TransformComponent>();
+    auto &previousTransforms = registry.pool<PreviousTransformComponent>();
+
+    // Bodies that moved last step but not in this one came to rest, make
+    // their previous pose match so interpolation stops blending
+    for (Entity entity : mMovedEntities) {
+      TransformComponent *transformComp = transforms.tryGet(entity);
+      PreviousTransformComponent *previousComp =
+          previousTransforms.tryGet(entity);
+      if (transformComp && previousComp) {
+        previousComp->position = transformComp->position;
+        previousComp->rotation = transformComp->rotation;
+      }
+    }
+    mMovedEntities.clear();
+    mSyncPending = false;
+
+    for (const FetchedPose &fetched : mFetchedPoses) {
+      Entity entity = fetched.entity;
+      TransformComponent *transformComp = transforms.tryGet(entity);
+      if (!transformComp) {
+        continue;
+      }
+
+      if (PreviousTransformComponent *previousComp =
+              previousTransforms.tryGet(entity)) {
+        previousComp->position = transformComp->position;
+        previousComp->rotation = transformComp->rotation;
+      }
+      const PxTransform &pose = fetched.pose;
+      transformComp->position = glm::vec3(pose.p.x, pose.p.y, pose.p.z);
+      transformComp->rotation =
+          glm::quat(pose.q.w, pose.q.x, pose.q.y, pose.q.z);
+      mMovedEntities.push_back(entity);
+    }
+
+    if (mRecorder) {
+      mRecorder->recordStep(registry, mMovedEntities);
+    }
+  }
+
+  // Gets every step's moved entities after they were synced, null stops
+  // recording. The recorder must outlive this or be unset first.
+  void setRecorder(SimulationRecorder *recorder) { mRecorder = recorder; }
+
+  // Entities whose transform changed in the last syncTransforms
+  const std::vector<Entity> &getMovedEntities() const {
+    return mMovedEntities;
+  }
+
+  // Creates one unit box actor per spawn and inserts all of them with a
+  // single addActors call. Actors left by releaseActors are reused before
+  // new ones are created. Bodies of equal mass share the mass properties
+  // computed for the first of them instead of integrating each shape again.
+  void createDynamicBoxes(const Entity *entities, const SpawnDesc *spawns,
+                          size_t count, PxRigidDynamic **outActors) {
+    if (mSimulating) {
+      throw std::runtime_error("Cannot add actors while the scene simulates.");
+    }
 
-  void update(float deltaTime, std::vector<Entity> &entities) {
-    // std::cout << "PhysicsSystem - update" << std::endl;
-    // Step the simulation
-    mScene->simulate(deltaTime);
-    mScene->fetchResults(true);
+    PxMaterial *material = mAssetCache->getMaterial(0.5f, 0.5f, 0.6f);
+    PxShape *shape =
+        mAssetCache->getBoxShape(PxVec3(0.5f, 0.5f, 0.5f), *material);
 
-    // Update entities with physics components
-    for (auto &entity : entities) {
-      auto transformComp = entity.getComponent<TransformComponent>();
-      auto physicsComp = entity.getComponent<PhysicsComponent>();
+    float cachedMass = -1.0f;
+    PxVec3 cachedInertia(0.0f);
+    for (size_t i = 0; i < count; i++) {
+      const SpawnDesc &spawn = spawns[i];
+      PxTransform pxTransform(
+          PxVec3(spawn.position.x, spawn.position.y, spawn.position.z),
+          PxQuat(spawn.rotation.x, spawn.rotation.y, spawn.rotation.z,
+                 spawn.rotation.w));
+      if (!pxTransform.isValid()) {
+        throw std::runtime_error("PxTransform is invalid!");
+      }
 
-      if (transformComp && physicsComp) {
-        PxRigidDynamic *actor = physicsComp->actor;
-        if (actor) {
-          PxTransform pose = actor->getGlobalPose();
-          transformComp->position = glm::vec3(pose.p.x, pose.p.y, pose.p.z);
-          transformComp->rotation =
-              glm::quat(pose.q.w, pose.q.x, pose.q.y, pose.q.z);
-          // std::cout << pose.p.x << ", " << pose.p.y << ", " << pose.p.z << std::endl;
+      PxRigidDynamic *dynamicActor = nullptr;
+      if (!mActorPool.empty()) {
+        // Pooled actors keep their box shape, only the state is reset
+        dynamicActor = mActorPool.back();
+        mActorPool.pop_back();
+        dynamicActor->setGlobalPose(pxTransform);
+        dynamicActor->setLinearVelocity(PxVec3(0.0f));
+        dynamicActor->setAngularVelocity(PxVec3(0.0f));
+        // It may have gone back to the pool asleep, enter the scene awake
+        dynamicActor->setWakeCounter(0.4f);
+      } else {
+        dynamicActor = mPhysics->createRigidDynamic(pxTransform);
+        if (!dynamicActor) {
+          throw std::runtime_error("Failed to create RigidDynamic actor!");
         }
+        dynamicActor->attachShape(*shape);
+        dynamicActor->setSolverIterationCounts(
+            static_cast<PxU32>(mProfile.positionIterations),
+            static_cast<PxU32>(mProfile.velocityIterations));
+        dynamicActor->setSleepThreshold(mProfile.sleepThreshold);
+        dynamicActor->setStabilizationThreshold(
+            mProfile.stabilizationThreshold);
+      }
+      dynamicActor->userData = EntityToUserData(entities[i]);
+
+      if (spawn.mass == cachedMass) {
+        dynamicActor->setMass(cachedMass);
+        dynamicActor->setMassSpaceInertiaTensor(cachedInertia);
+      } else {
+        PxRigidBodyExt::updateMassAndInertia(*dynamicActor, spawn.mass);
+        cachedMass = spawn.mass;
+        cachedInertia = dynamicActor->getMassSpaceInertiaTensor();
+      }
+      outActors[i] = dynamicActor;
+    }
+
+    mBatchActors.assign(outActors, outActors + count);
+    mScene->addActors(mBatchActors.data(), static_cast<PxU32>(count));
+  }
+
+  // Takes the actors out of the scene in one batch and keeps them for the
+  // next createDynamicBoxes, so despawning and respawning does not touch
+  // the PhysX heap.
+  void releaseActors(PxRigidDynamic *const *actors, size_t count) {
+    if (mSimulating) {
+      throw std::runtime_error(
+          "Cannot remove actors while the scene simulates.");
+    }
+    if (count == 0) {
+      return;
+    }
+
+    mBatchActors.assign(actors, actors + count);
+    mScene->removeActors(mBatchActors.data(), static_cast<PxU32>(count));
+    for (size_t i = 0; i < count; i++) {
+      actors[i]->userData = nullptr;
+      if (!releaseDeserialized(actors[i])) {
+        mActorPool.push_back(actors[i]);
       }
     }
   }
 
+  // Actors waiting in the pool for reuse
+  size_t getPooledActorCount() const { return mActorPool.size(); }
+
+  // Makes PhysX record collision shapes, contacts and body axes every
+  // step. Costs simulation time, keep it off unless it is looked at.
+  void setDebugVisualization(bool enabled) {
+    if (mSimulating) {
+      throw std::runtime_error(
+          "Cannot change visualization while the scene simulates.");
+    }
+    float on = enabled ? 1.0f : 0.0f;
+    mScene->setVisualizationParameter(PxVisualizationParameter::eSCALE, on);
+    mScene->setVisualizationParameter(
+        PxVisualizationParameter::eCOLLISION_SHAPES, on);
+    mScene->setVisualizationParameter(
+        PxVisualizationParameter::eCONTACT_POINT, on);
+    mScene->setVisualizationParameter(
+        PxVisualizationParameter::eCONTACT_NORMAL, on);
+    mScene->setVisualizationParameter(PxVisualizationParameter::eBODY_AXES,
+                                      on);
+    mDebugVisualization = enabled;
+  }
+  bool isDebugVisualizationEnabled() const { return mDebugVisualization; }
+
+  // Appends the geometry PhysX visualized in the last step. The render
+  // buffer is only valid between fetchResults and the next simulate.
+  void appendDebugGeometry(DebugDraw &debugDraw) {
+    if (mSimulating || !mDebugVisualization) {
+      return;
+    }
+    debugDraw.addRenderBuffer(mScene->getRenderBuffer());
+  }
+
   PxPhysics *GetPhysics() { return mPhysics.get(); }
   PxScene *GetScene() { return mScene.get(); }
+  PxPhysics &getPhysics() { return *mPhysics; }
+
+  // Adds every actor of a deserialized collection in one call. The size
+  // bytes at memory they were deserialized into are kept until the last of
+  // them is released by releaseActors.
+  void addCollection(const PxCollection &collection,
+                     std::shared_ptr<void> memory, size_t size) {
+    if (mSimulating) {
+      throw std::runtime_error("Cannot add actors while the scene simulates.");
+    }
+    mScene->addCollection(collection);
+
+    CollectionMemory block;
+    block.begin = reinterpret_cast<uintptr_t>(memory.get());
+    block.end = block.begin + size;
+    for (PxU32 i = 0; i < collection.getNbObjects(); i++) {
+      if (collection.getObject(i).is<PxActor>()) {
+        block.liveActors++;
+      }
+    }
+    block.memory = std::move(memory);
+    if (block.liveActors > 0) {
+      mCollectionMemory.push_back(std::move(block));
+    }
+  }
+  // Deserialized memory blocks still holding live actors
+  size_t getCollectionMemoryCount() const { return mCollectionMemory.size(); }
+  PhysicsAssetCache &GetAssetCache() { return *mAssetCache; }
+  const PhysicsProfile &getProfile() const { return mProfile; }
+
+  // Bytes PhysX currently has allocated through our allocator
+  size_t getAllocatedBytes() const { return mAllocator.liveBytes(); }
 
 private:
-  void createGroundPlane() {
-    // Create material for the ground
-    auto groundMaterial = std::unique_ptr<PxMaterial, PxMaterialDeleter>(
-        mPhysics->createMaterial(0.5f, 0.5f, 0.6f));
-    if (!groundMaterial) {
-      throw std::runtime_error("Failed to create ground material.");
+  static int64_t nowNs() {
+    return std::chrono::steady_clock::now().time_since_epoch() /
+           std::chrono::nanoseconds(1);
+  }
+
+  // Actors living in a deserialized block are released for good instead
+  // of pooled, the block goes with the last of them
+  bool releaseDeserialized(PxRigidDynamic *actor) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(actor);
+    for (size_t i = 0; i < mCollectionMemory.size(); i++) {
+      CollectionMemory &block = mCollectionMemory[i];
+      if (address < block.begin || address >= block.end) {
+        continue;
+      }
+      actor->release();
+      if (--block.liveActors == 0) {
+        mCollectionMemory.erase(mCollectionMemory.begin() + i);
+      }
+      return true;
+    }
+    return false;
+  }
+
+  void applyProfile(PxSceneDesc &sceneDesc) const {
+    switch (mProfile.broadPhase) {
+    case PhysicsProfile::BroadPhase::SAP:
+      sceneDesc.broadPhaseType = PxBroadPhaseType::eSAP;
+      break;
+    case PhysicsProfile::BroadPhase::MBP:
+      sceneDesc.broadPhaseType = PxBroadPhaseType::eMBP;
+      break;
+    case PhysicsProfile::BroadPhase::ABP:
+      sceneDesc.broadPhaseType = PxBroadPhaseType::eABP;
+      break;
+    case PhysicsProfile::BroadPhase::PABP:
+#if PX_PHYSICS_VERSION_MAJOR >= 5
+      sceneDesc.broadPhaseType = PxBroadPhaseType::ePABP;
+#else
+      // LoadPhysicsProfiles rejects these, only reachable by hand
+      throw std::runtime_error("The pabp broad phase needs PhysX 5.");
+#endif
+      break;
     }
+    sceneDesc.solverType = mProfile.solver == PhysicsProfile::Solver::TGS
+                               ? PxSolverType::eTGS
+                               : PxSolverType::ePGS;
+    switch (mProfile.friction) {
+    case PhysicsProfile::Friction::Patch:
+      sceneDesc.frictionType = PxFrictionType::ePATCH;
+      break;
+    case PhysicsProfile::Friction::OneDirectional:
+      sceneDesc.frictionType = PxFrictionType::eONE_DIRECTIONAL;
+      break;
+    case PhysicsProfile::Friction::TwoDirectional:
+      sceneDesc.frictionType = PxFrictionType::eTWO_DIRECTIONAL;
+      break;
+    }
+    if (mProfile.pcm) {
+      sceneDesc.flags |= PxSceneFlag::eENABLE_PCM;
+    } else {
+      sceneDesc.flags.clear(PxSceneFlag::eENABLE_PCM);
+    }
+    if (mProfile.stabilization) {
+      sceneDesc.flags |= PxSceneFlag::eENABLE_STABILIZATION;
+    }
+    sceneDesc.bounceThresholdVelocity = mProfile.bounceThreshold;
+  }
+
+  // MBP only tracks bodies inside its regions, these tile a cube around
+  // the origin along the ground plane
+  void addBroadPhaseRegions() {
+    float extent = mProfile.mbpHalfExtent;
+    PxBounds3 bounds(PxVec3(-extent), PxVec3(extent));
+    std::vector<PxBounds3> regions(mProfile.mbpSubdivisions *
+                                   mProfile.mbpSubdivisions);
+    PxU32 count = PxBroadPhaseExt::createRegionsFromWorldBounds(
+        regions.data(), bounds, static_cast<PxU32>(mProfile.mbpSubdivisions),
+        2);
+    for (PxU32 i = 0; i < count; i++) {
+      PxBroadPhaseRegion region;
+      region.mBounds = regions[i];
+      region.mUserData = nullptr;
+      mScene->addBroadPhaseRegion(region);
+    }
+  }
+
+  void createGroundPlane() {
+    PxMaterial *groundMaterial = mAssetCache->getMaterial(0.5f, 0.5f, 0.6f);
 
     // Create ground plane
     PxRigidStatic *groundPlane =
@@ -127,11 +576,41 @@ private:
     mScene->addActor(*groundPlane);
   }
 
+  PhysicsProfile mProfile;
+
+  // Declared first so they outlive the foundation that uses them
+  TrackingAllocator mAllocator;
+  PxDefaultErrorCallback mErrorCallback;
+  // Outlives the SDK too, deserialized objects are released with it
+  struct CollectionMemory {
+    std::shared_ptr<void> memory;
+    uintptr_t begin = 0;
+    uintptr_t end = 0;
+    size_t liveActors = 0;
+  };
+  std::vector<CollectionMemory> mCollectionMemory;
+
   std::unique_ptr<PxFoundation, PxFoundationDeleter> mFoundation;
   std::unique_ptr<PxPhysics, PxPhysicsDeleter> mPhysics;
   std::unique_ptr<PxScene, PxSceneDeleter> mScene;
-  std::unique_ptr<PxDefaultCpuDispatcher> mDispatcher;
+  // Released before the scene and physics it was created from
+  std::unique_ptr<PhysicsAssetCache> mAssetCache;
 
-  PxDefaultAllocator mAllocator;
-  PxDefaultErrorCallback mErrorCallback;
+  SimulationCompletionTask mCompletionTask;
+  SimulationOverlapStats mOverlapStats;
+  PxSimulationStatistics mSimulationStats;
+  int64_t mStepStartNs = 0;
+  bool mSimulating = false;
+  bool mDebugVisualization = false;
+
+  struct FetchedPose {
+    Entity entity;
+    PxTransform pose;
+  };
+  std::vector<FetchedPose> mFetchedPoses;
+  bool mSyncPending = false;
+  std::vector<Entity> mMovedEntities;
+  SimulationRecorder *mRecorder = nullptr;
+  std::vector<PxActor *> mBatchActors;
+  std::vector<PxRigidDynamic *> mActorPool;
 };
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// One timed scope. Names must outlive the profiler, string literals or
+// names PhysX hands out for its tasks.
+struct ProfileEvent {
+  const char *name = nullptr;
+  int64_t startNs = 0;
+  int64_t endNs = 0;
+  uint32_t depth = 0;
+};
+
+// Everything a thread or track recorded in some time window, in the order
+// the scopes ended
+struct ProfileTrack {
+  std::string name;
+  std::vector<ProfileEvent> events;
+};
+
+// Scoped CPU timers for the whole process. Every thread writes into a ring
+// buffer of its own, so recording takes no lock and the oldest events are
+// overwritten once a ring is full. Reading may happen on any thread while
+// the others keep recording; events overwritten during the copy are
+// dropped from it.
+//
+// Besides threads there are tracks filled from outside, e.g. GPU timings
+// that arrive frames after the work was issued. A track must only be
+// written from one thread.
+class Profiler {
+public:
+  static constexpr size_t RingCapacity = 1 << 14;
+
+  static Profiler &get();
+
+  // Recording is on by default, while off scopes cost a load and a branch
+  void setEnabled(bool enabled) {
+    mEnabled.store(enabled, std::memory_order_relaxed);
+  }
+  bool isEnabled() const { return mEnabled.load(std::memory_order_relaxed); }
+
+  // Name shown for the calling thread
+  void setThreadName(const std::string &name);
+
+  // Appends to the calling thread's ring
+  void record(const char *name, int64_t startNs, int64_t endNs,
+              uint32_t depth);
+
+  // Track not tied to a thread, returns its id for recordOn
+  int createTrack(const std::string &name);
+  void recordOn(int track, const char *name, int64_t startNs, int64_t endNs,
+                uint32_t depth = 0);
+
+  // Marks the start of a frame, called from the main loop only
+  void beginFrame();
+  // Bounds of the last finished frame, false before the second frame
+  bool lastFrame(int64_t &startNs, int64_t &endNs) const;
+
+  // Copies the events overlapping [fromNs, toNs) out of every ring. Tracks
+  // without such events are left out.
+  std::vector<ProfileTrack> collect(int64_t fromNs, int64_t toNs) const;
+
+  // Writes everything still in the rings as Chrome trace event JSON, for
+  // chrome://tracing or ui.perfetto.dev. False if the file can't be written.
+  bool exportChromeTrace(const std::string &path) const;
+
+  // steady_clock time in ns, the clock of every event
+  static int64_t nowNs();
+
+  // Used by ProfileScope to track nesting on the calling thread
+  static uint32_t enterScope();
+  static void leaveScope();
+
+private:
+  // One event behind a sequence number: odd while the event with index
+  // (sequence - 1) / 2 is written, 2 * index + 2 once it is complete.
+  // Fields are relaxed atomics so readers racing the owner stay defined.
+  struct Slot {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<const char *> name{nullptr};
+    std::atomic<int64_t> startNs{0};
+    std::atomic<int64_t> endNs{0};
+    std::atomic<uint32_t> depth{0};
+  };
+
+  struct Ring {
+    std::string name;
+    std::vector<Slot> slots;
+    // Total number of events ever written, the next slot is head % capacity
+    std::atomic<uint64_t> head{0};
+
+    Ring() : slots(RingCapacity) {}
+    void push(const ProfileEvent &event);
+    void copy(int64_t fromNs, int64_t toNs,
+              std::vector<ProfileEvent> &out) const;
+  };
+
+  Profiler() = default;
+  Ring &threadRing();
+
+  std::atomic<bool> mEnabled{true};
+  // Rings are never freed, a thread that exits keeps its events
+  mutable std::mutex mRingsMutex;
+  std::vector<std::unique_ptr<Ring>> mRings;
+
+  static constexpr size_t FrameHistory = 4;
+  int64_t mFrameStarts[FrameHistory] = {};
+  uint64_t mFrameCount = 0;
+};
+
+// Times the enclosing block on the calling thread
+class ProfileScope {
+public:
+  explicit ProfileScope(const char *name) : mName(name) {
+    if (Profiler::get().isEnabled()) {
+      mDepth = Profiler::enterScope();
+      mStartNs = Profiler::nowNs();
+    }
+  }
+  ~ProfileScope() {
+    if (mStartNs != 0) {
+      Profiler::leaveScope();
+      Profiler::get().record(mName, mStartNs, Profiler::nowNs(), mDepth);
+    }
+  }
+
+  ProfileScope(const ProfileScope &) = delete;
+  ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+  const char *mName;
+  int64_t mStartNs = 0;
+  uint32_t mDepth = 0;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name)                                                    \
+  ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
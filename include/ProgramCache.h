@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+
+// On disk cache of linked programs from glGetProgramBinary. Entries are
+// keyed by a hash of the shader sources and the GL vendor, renderer and
+// version, so a driver update or an edited shader simply misses. The
+// driver may still reject a binary, callers compile from source then.
+class ProgramCache {
+public:
+  // The directory is created on first store
+  explicit ProgramCache(std::string directory);
+
+  // False if the driver offers no binary formats
+  bool isSupported() const { return mSupported; }
+
+  uint64_t key(const std::string &vertexSource,
+               const std::string &fragmentSource) const;
+
+  // New program created from the cached binary, 0 on a miss or when the
+  // driver rejects it
+  GLuint load(uint64_t key) const;
+  // Saves the binary of a linked program that was created with
+  // GL_PROGRAM_BINARY_RETRIEVABLE_HINT. Failures are only logged.
+  void store(uint64_t key, GLuint program) const;
+
+private:
+  std::string path(uint64_t key) const;
+
+  std::string mDirectory;
+  // Hash of vendor, renderer and version, the start of every key
+  uint64_t mDriverHash = 0;
+  bool mSupported = false;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <map>
+
+// Hands out [offset, offset + size) ranges of an abstract buffer. Free
+// ranges are kept sorted by offset and merged with their neighbours when
+// released, allocation picks the smallest range that fits.
+class RangeAllocator {
+public:
+  static constexpr size_t Invalid = SIZE_MAX;
+
+  explicit RangeAllocator(size_t capacity = 0) { reset(capacity, 0); }
+
+  // Offset of the new range, Invalid if no free range is large enough
+  size_t allocate(size_t size) {
+    if (size == 0) {
+      return Invalid;
+    }
+    auto best = mFree.end();
+    for (auto it = mFree.begin(); it != mFree.end(); ++it) {
+      if (it->second >= size &&
+          (best == mFree.end() || it->second < best->second)) {
+        best = it;
+        if (best->second == size) {
+          break;
+        }
+      }
+    }
+    if (best == mFree.end()) {
+      return Invalid;
+    }
+
+    size_t offset = best->first;
+    size_t remaining = best->second - size;
+    mFree.erase(best);
+    if (remaining > 0) {
+      mFree.emplace(offset + size, remaining);
+    }
+    mUsed += size;
+    return offset;
+  }
+
+  void free(size_t offset, size_t size) {
+    if (size == 0) {
+      return;
+    }
+    mUsed -= size;
+    auto next = mFree.lower_bound(offset);
+    if (next != mFree.begin()) {
+      auto previous = std::prev(next);
+      if (previous->first + previous->second == offset) {
+        offset = previous->first;
+        size += previous->second;
+        mFree.erase(previous);
+      }
+    }
+    if (next != mFree.end() && offset + size == next->first) {
+      size += next->second;
+      mFree.erase(next);
+    }
+    mFree.emplace(offset, size);
+  }
+
+  // Everything below used is allocated, the rest is one free range. This is
+  // the state after compacting the buffer.
+  void reset(size_t capacity, size_t used) {
+    mFree.clear();
+    mCapacity = capacity;
+    mUsed = used;
+    if (capacity > used) {
+      mFree.emplace(used, capacity - used);
+    }
+  }
+
+  size_t capacity() const { return mCapacity; }
+  size_t used() const { return mUsed; }
+  size_t freeRangeCount() const { return mFree.size(); }
+  size_t largestFreeRange() const {
+    size_t largest = 0;
+    for (const auto &range : mFree) {
+      largest = range.second > largest ? range.second : largest;
+    }
+    return largest;
+  }
+
+private:
+  // offset -> size
+  std::map<size_t, size_t> mFree;
+  size_t mCapacity = 0;
+  size_t mUsed = 0;
+};
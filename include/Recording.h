@@ -0,0 +1,228 @@
+#pragma once
+
+#include "Entity.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Recording of the transforms a simulation produced, one frame per physics
+// step, played back later without PhysX.
+//
+// Positions are stored as fixed point with PositionScale steps per meter,
+// rotations as the three smallest quaternion components with
+// RotationScale steps per unit. A frame lists the bodies removed, bodies
+// written whole (new ones, or every live one on a key frame) and the moved
+// bodies as deltas against their previous frame. Bodies at rest are not
+// written at all. Integers are zigzag varints, body ids are the entity ids
+// of the recorded world, gap coded in ascending order.
+//
+// Every ChunkFrames frames form a chunk that starts with a key frame, so
+// playback can seek by decoding at most one chunk. Chunks are compressed
+// with zlib when the build has it and stored as they are otherwise.
+//
+// Layout: RecordingHeader, the chunks, then chunkCount RecordingChunk
+// entries at indexOffset, 8 byte aligned. Integers are little endian.
+struct RecordingHeader {
+  static constexpr uint32_t Magic = 0x43455245; // "EREC"
+  // Bump whenever the header, the chunks or the frame encoding change
+  static constexpr uint32_t CurrentVersion = 1;
+
+  uint32_t magic;
+  uint32_t version;
+  float stepSeconds;
+  float positionScale;
+  uint64_t frameCount;
+  uint64_t chunkCount;
+  uint64_t indexOffset;
+  // Sum over all frames of the bodies alive in them
+  uint64_t bodyFrames;
+  uint64_t rawBytes;
+  uint64_t storedBytes;
+};
+
+struct RecordingChunk {
+  enum Codec : uint32_t { Raw = 0, Zlib = 1 };
+
+  uint64_t firstFrame;
+  uint64_t offset;
+  uint32_t frameCount;
+  uint32_t codec;
+  uint32_t rawSize;
+  uint32_t storedSize;
+};
+
+struct RecordingStats {
+  uint64_t frames = 0;
+  uint64_t chunks = 0;
+  uint64_t bodyFrames = 0;
+  // Frame data before and after chunk compression
+  uint64_t rawBytes = 0;
+  uint64_t storedBytes = 0;
+
+  double bytesPerBodyFrame() const {
+    return bodyFrames > 0 ? double(storedBytes) / bodyFrames : 0.0;
+  }
+  double rawBytesPerBodyFrame() const {
+    return bodyFrames > 0 ? double(rawBytes) / bodyFrames : 0.0;
+  }
+};
+
+namespace recording {
+
+constexpr float PositionScale = 1024.0f;
+constexpr float RotationScale = 32767.0f;
+constexpr uint32_t ChunkFrames = 120;
+
+// Pose as it is stored, also what the previous frame is kept as
+struct QuantizedPose {
+  int32_t position[3];
+  // Smallest three, the largest component is dropped and made positive
+  int32_t rotation[3];
+  uint8_t largest;
+};
+
+} // namespace recording
+
+// Streams the bodies of a world to a file. Fed by the world: spawns and
+// destructions as they happen, moved bodies by PhysicsSystem after every
+// transform sync. The file is written under a temporary name and renamed
+// by finish, a recording that never finished is never mistaken for one.
+class SimulationRecorder {
+public:
+  // Throws std::runtime_error if path can't be created
+  SimulationRecorder(const std::string &path, float stepSeconds);
+  // Finishes the file, errors are only reported by an explicit finish
+  ~SimulationRecorder();
+
+  SimulationRecorder(const SimulationRecorder &) = delete;
+  SimulationRecorder &operator=(const SimulationRecorder &) = delete;
+
+  // Bodies appear in the next frame, with whatever pose and RenderComponent
+  // they have by then
+  void addBodies(const Entity *entities, size_t count);
+  void removeBody(Entity entity);
+
+  // Ends a frame, called after the transforms of a step were synced
+  void recordStep(Registry &registry, const std::vector<Entity> &moved);
+
+  // Writes the last chunk and the index. Spawns and removals after the
+  // last step are dropped. Throws std::runtime_error on failure.
+  void finish();
+
+  const RecordingStats &getStats() const { return mStats; }
+
+private:
+  struct Body {
+    recording::QuantizedPose pose;
+    uint32_t generation = 0;
+    bool live = false;
+    bool rendered = false;
+  };
+
+  void writeBody(Registry &registry, uint32_t id, bool moved);
+  void flushChunk();
+
+  std::string mPath;
+  std::string mTempPath;
+  FILE *mFile = nullptr;
+  float mStepSeconds;
+  uint64_t mOffset = 0;
+  RecordingStats mStats;
+
+  std::vector<Body> mBodies;
+  size_t mLiveCount = 0;
+  std::vector<Entity> mPendingSpawns;
+  std::vector<uint32_t> mPendingRemovals;
+  std::vector<RecordingChunk> mChunks;
+  std::vector<uint8_t> mChunk;
+  uint32_t mChunkFrameCount = 0;
+
+  // Scratch space reused by every frame
+  std::vector<uint32_t> mWhole;
+  std::vector<uint32_t> mUpdates;
+  std::vector<uint64_t> mMovedFrame;
+  std::vector<uint64_t> mWholeFrame;
+  std::vector<uint8_t> mCompressed;
+};
+
+// Plays a recording back into a registry of its own, with the same
+// components the world gives its entities minus physics. Drop-in for the
+// world as far as RenderSystem is concerned.
+class SimulationPlayback {
+public:
+  // Maps path and validates it. Bodies that were drawn when recorded get
+  // the given mesh. Throws std::runtime_error if the file is missing,
+  // corrupt or needs zlib this build does not have.
+  explicit SimulationPlayback(const std::string &path,
+                              std::shared_ptr<Mesh> mesh = nullptr);
+  ~SimulationPlayback();
+
+  SimulationPlayback(const SimulationPlayback &) = delete;
+  SimulationPlayback &operator=(const SimulationPlayback &) = delete;
+
+  // Advances by the frame time in recorded steps and sets the alpha to
+  // interpolate with, like World::Update. Holds at the last frame.
+  void Update(float frameTime);
+  // Shows the state after the given step. Short forward seeks continue
+  // decoding, others restart at the key frame of the target's chunk.
+  void Seek(size_t frame);
+
+  size_t GetFrame() const { return mFrame; }
+  size_t GetFrameCount() const { return mHeader.frameCount; }
+  float GetStepSeconds() const { return mHeader.stepSeconds; }
+  float GetInterpolationAlpha() const { return mAlpha; }
+  RecordingStats GetStats() const;
+
+  Registry &GetRegistry() { return mRegistry; }
+  // Entities spawned, moved or destroyed since the last clear
+  const std::vector<Entity> &GetChangedEntities() const {
+    return mChangedEntities;
+  }
+  void ClearChangedEntities() { mChangedEntities.clear(); }
+  int GetEntitiesCount() { return mRegistry.size(); }
+
+private:
+  size_t chunkOf(size_t frame) const;
+  void loadChunk(size_t chunk);
+  // Decodes frames until the given one is the newest, from the current
+  // state when that is close enough and from a key frame otherwise
+  void advanceTo(size_t frame);
+  void decodeNext();
+  // Previous poses of the bodies that moved in the shown frame are made
+  // current, so it is drawn exactly whatever the alpha
+  void settle();
+  void destroyAll();
+
+  std::string mPath;
+  void *mData = nullptr;
+  size_t mSize = 0;
+  RecordingHeader mHeader = {};
+  const RecordingChunk *mChunks = nullptr;
+  std::shared_ptr<Mesh> mMesh;
+
+  // Frames of the current chunk, in the mapping or decompressed into
+  // mChunkData, and the read position of the next frame in them
+  size_t mChunk = 0;
+  bool mChunkLoaded = false;
+  std::vector<uint8_t> mChunkData;
+  const uint8_t *mFrameData = nullptr;
+  size_t mFrameSize = 0;
+  size_t mCursor = 0;
+
+  Registry mRegistry;
+  // Stream state per body id, plus the entity standing for it
+  std::vector<recording::QuantizedPose> mPoses;
+  std::vector<Entity> mEntities;
+  std::vector<uint32_t> mMoved;
+  std::vector<Entity> mChangedEntities;
+
+  // Newest decoded frame, the one shown at an alpha of one
+  size_t mFrame = 0;
+  size_t mNextFrame = 0;
+  float mAccumulator = 0.0f;
+  float mAlpha = 1.0f;
+};
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Lightweight handle to an entity living in a Registry. Ids are recycled
+// after destruction; the generation tells a stale handle from the entity
+// that reuses its id.
+struct Entity {
+  static constexpr uint32_t Invalid = std::numeric_limits<uint32_t>::max();
+
+  uint32_t id = Invalid;
+  uint32_t generation = 0;
+
+  bool isValid() const { return id != Invalid; }
+  uint32_t getId() const { return id; }
+
+  bool operator==(const Entity &other) const {
+    return id == other.id && generation == other.generation;
+  }
+  bool operator!=(const Entity &other) const { return !(*this == other); }
+};
+
+namespace detail {
+inline uint32_t NextComponentTypeId() {
+  static uint32_t counter = 0;
+  return counter++;
+}
+} // namespace detail
+
+// Dense, per type id assigned once on first use. Used to index the pools.
+template <typename T> uint32_t ComponentTypeId() {
+  static const uint32_t id = detail::NextComponentTypeId();
+  return id;
+}
+
+// Type independent part of a sparse set: entity id -> dense index
+class ComponentPoolBase {
+public:
+  static constexpr uint32_t Npos = std::numeric_limits<uint32_t>::max();
+
+  virtual ~ComponentPoolBase() = default;
+  virtual void remove(Entity entity) = 0;
+  virtual void reserve(size_t capacity) = 0;
+
+  bool contains(Entity entity) const {
+    return entity.id < mSparse.size() && mSparse[entity.id] != Npos &&
+           mEntities[mSparse[entity.id]].generation == entity.generation;
+  }
+  size_t size() const { return mEntities.size(); }
+  const std::vector<Entity> &entities() const { return mEntities; }
+
+protected:
+  std::vector<uint32_t> mSparse;
+  std::vector<Entity> mEntities;
+};
+
+// Stores all components of one type contiguously, in the same order as
+// mEntities, so iteration is a linear walk over two arrays.
+template <typename T> class ComponentPool : public ComponentPoolBase {
+public:
+  template <typename... Args> T &emplace(Entity entity, Args &&...args) {
+    if (entity.id >= mSparse.size()) {
+      mSparse.resize(entity.id + 1, Npos);
+    }
+    if (contains(entity)) {
+      T &component = mComponents[mSparse[entity.id]];
+      component = T{std::forward<Args>(args)...};
+      return component;
+    }
+    mSparse[entity.id] = static_cast<uint32_t>(mEntities.size());
+    mEntities.push_back(entity);
+    mComponents.push_back(T{std::forward<Args>(args)...});
+    return mComponents.back();
+  }
+
+  void remove(Entity entity) override {
+    if (!contains(entity)) {
+      return;
+    }
+    // Swap with the last element to keep storage dense
+    uint32_t index = mSparse[entity.id];
+    uint32_t last = static_cast<uint32_t>(mEntities.size() - 1);
+    if (index != last) {
+      mEntities[index] = mEntities[last];
+      mComponents[index] = std::move(mComponents[last]);
+      mSparse[mEntities[index].id] = index;
+    }
+    mEntities.pop_back();
+    mComponents.pop_back();
+    mSparse[entity.id] = Npos;
+  }
+
+  void reserve(size_t capacity) override {
+    mEntities.reserve(capacity);
+    mComponents.reserve(capacity);
+  }
+
+  T *tryGet(Entity entity) {
+    return contains(entity) ? &mComponents[mSparse[entity.id]] : nullptr;
+  }
+  // Caller must guarantee that the entity owns this component
+  T &get(Entity entity) { return mComponents[mSparse[entity.id]]; }
+
+  std::vector<T> &components() { return mComponents; }
+
+private:
+  std::vector<T> mComponents;
+};
+
+// Iterates every entity owning all of Ts. Walks the smallest pool and
+// looks the rest up through their sparse arrays, so it never allocates.
+template <typename... Ts> class View {
+public:
+  explicit View(ComponentPool<Ts> *...pools) : mPools(pools...) {}
+
+  template <typename Func> void each(Func &&func) {
+    const ComponentPoolBase *lead = smallest();
+    const std::vector<Entity> &entities = lead->entities();
+    for (size_t i = 0; i < entities.size(); ++i) {
+      Entity entity = entities[i];
+      if ((std::get<ComponentPool<Ts> *>(mPools)->contains(entity) && ...)) {
+        func(entity, std::get<ComponentPool<Ts> *>(mPools)->get(entity)...);
+      }
+    }
+  }
+
+  // Upper bound on the number of entities visited by each()
+  size_t sizeHint() const { return smallest()->size(); }
+
+private:
+  const ComponentPoolBase *smallest() const {
+    const ComponentPoolBase *lead = std::get<0>(mPools);
+    ((lead = std::get<ComponentPool<Ts> *>(mPools)->size() < lead->size()
+                 ? std::get<ComponentPool<Ts> *>(mPools)
+                 : lead),
+     ...);
+    return lead;
+  }
+
+  std::tuple<ComponentPool<Ts> *...> mPools;
+};
+
+class Registry {
+public:
+  // Reuses the id of a destroyed entity when there is one
+  Entity create() {
+    Entity entity;
+    if (!mFreeIds.empty()) {
+      entity.id = mFreeIds.back();
+      mFreeIds.pop_back();
+    } else {
+      entity.id = static_cast<uint32_t>(mGenerations.size());
+      mGenerations.push_back(0);
+    }
+    entity.generation = mGenerations[entity.id];
+    ++mAlive;
+    return entity;
+  }
+
+  // Removes all components and invalidates every handle to the entity.
+  // Pools swap-remove, so their storage is kept for the next entities.
+  void destroy(Entity entity) {
+    if (!valid(entity)) {
+      return;
+    }
+    for (auto &pool : mPools) {
+      if (pool) {
+        pool->remove(entity);
+      }
+    }
+    mGenerations[entity.id]++;
+    mFreeIds.push_back(entity.id);
+    --mAlive;
+  }
+
+  bool valid(Entity entity) const {
+    return entity.id < mGenerations.size() &&
+           mGenerations[entity.id] == entity.generation;
+  }
+
+  // Throws std::runtime_error for a destroyed entity. Its id may already
+  // belong to a newer one, whose component the pool would orphan.
+  template <typename T, typename... Args>
+  T &emplace(Entity entity, Args &&...args) {
+    if (!valid(entity)) {
+      throw std::runtime_error("Cannot add a component to a stale entity.");
+    }
+    return pool<T>().emplace(entity, std::forward<Args>(args)...);
+  }
+
+  template <typename T> void remove(Entity entity) {
+    pool<T>().remove(entity);
+  }
+
+  // Returns nullptr if the entity does not own a T
+  template <typename T> T *get(Entity entity) {
+    return pool<T>().tryGet(entity);
+  }
+
+  template <typename T> bool has(Entity entity) {
+    return pool<T>().contains(entity);
+  }
+
+  template <typename... Ts> View<Ts...> view() {
+    return View<Ts...>(&pool<Ts>()...);
+  }
+
+  template <typename T> void reserve(size_t capacity) {
+    pool<T>().reserve(capacity);
+  }
+
+  template <typename T> ComponentPool<T> &pool() {
+    uint32_t typeId = ComponentTypeId<T>();
+    if (typeId >= mPools.size()) {
+      mPools.resize(typeId + 1);
+    }
+    if (!mPools[typeId]) {
+      mPools[typeId] = std::make_unique<ComponentPool<T>>();
+    }
+    return static_cast<ComponentPool<T> &>(*mPools[typeId]);
+  }
+
+  size_t size() const { return mAlive; }
+
+private:
+  std::vector<std::unique_ptr<ComponentPoolBase>> mPools;
+  std::vector<uint32_t> mGenerations;
+  std::vector<uint32_t> mFreeIds;
+  size_t mAlive = 0;
+};
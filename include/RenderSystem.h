@@ -1,23 +1,183 @@
+#pragma once
+
+#include "BoundingVolumeHierarchy.h"
 #include "Entity.h"
+#include "Mesh.h"
+#include "Profiler.h"
+#include "TransformBatch.h"
 #include <glm/glm.hpp>
+#include <unordered_map>
 #include <vector>
 
+struct RenderStats {
+  size_t drawn = 0;
+  size_t culled = 0;
+  // Draw calls issued, a multi draw counts once
+  size_t drawCalls = 0;
+};
+
 class RenderSystem {
 public:
-  void render(Shader &shader, Camera &camera, std::vector<Entity> &entities) {
-    // std::cout << "Renderer System - update" << std::endl;
-    for (auto &entity : entities) {
-      auto renderComp = entity.getComponent<RenderComponent>();
-      auto transformComp = entity.getComponent<TransformComponent>();
-
-      if (renderComp && transformComp) {
-        renderComp->mesh->SetTransform(transformComp->position,
-                                       transformComp->rotation);
-        renderComp->mesh->Draw(shader, camera, GL_TRIANGLES);
-        /* std::cout << transformComp->position.x << ","
-                  << transformComp->position.y << ", "
-                  << transformComp->position.z << std::endl; */
+  // Groups the entities inside the frustum by mesh. Meshes living in a
+  // GeometryPool become one indirect command each and are drawn with a
+  // single multi draw per pool, other meshes get one instanced draw each.
+  // Poses are gathered per mesh and turned into model matrices by the batch
+  // kernels, all arrays keep their capacity between frames. Entities with a
+  // previous pose are drawn alpha of the way from it to the current one.
+  //
+  // Visibility comes from a bounding volume hierarchy that is only refitted
+  // for the changed entities (see World::GetChangedEntities), so the cost
+  // follows what moved and what is visible, not the size of the scene.
+  void render(Shader &shader, Registry &registry,
+              const std::vector<Entity> &changedEntities,
+              const Frustum &frustum, float alpha) {
+    PROFILE_SCOPE("RenderSystem::render");
+    updateProxies(registry, changedEntities);
+
+    for (auto &batch : mBatches) {
+      batch.second.transforms.clear();
+    }
+
+    auto &renderPool = registry.pool<RenderComponent>();
+    auto &transformPool = registry.pool<TransformComponent>();
+    auto &previousPool = registry.pool<PreviousTransformComponent>();
+    mStats = RenderStats();
+    mBvh.queryFrustum(frustum, [&](uint32_t id) {
+      Entity entity = mProxies[id].entity;
+      RenderComponent *renderComp = renderPool.tryGet(entity);
+      TransformComponent *transformComp = transformPool.tryGet(entity);
+      if (!renderComp || !transformComp) {
+        return;
+      }
+
+      glm::vec3 position = transformComp->position;
+      glm::quat rotation = transformComp->rotation;
+      if (auto *previous = previousPool.tryGet(entity)) {
+        position = glm::mix(previous->position, position, alpha);
+        rotation = glm::slerp(previous->rotation, rotation, alpha);
       }
+      mBatches[renderComp->mesh.get()].transforms.push(position, rotation);
+      mStats.drawn++;
+    });
+    mStats.culled = mBvh.size() - mStats.drawn;
+
+    for (auto &poolBatch : mPoolBatches) {
+      poolBatch.second.commands.clear();
+      poolBatch.second.models.clear();
+    }
+
+    // Camera data comes from the uniform buffer, only instances vary
+    shader.Activate();
+    for (auto &batch : mBatches) {
+      MeshBatch &meshBatch = batch.second;
+      size_t count = meshBatch.transforms.size();
+      if (count == 0) {
+        continue;
+      }
+
+      Mesh *mesh = batch.first;
+      if (GeometryPool *pool = mesh->GetGeometryPool()) {
+        PoolBatch &poolBatch = mPoolBatches[pool];
+        size_t first = poolBatch.models.size();
+        poolBatch.models.resize(first + count);
+        BuildModelMatrices(meshBatch.transforms,
+                           poolBatch.models.data() + first);
+        poolBatch.commands.push_back(
+            pool->command(mesh->GetPoolId(), static_cast<GLuint>(count),
+                          static_cast<GLuint>(first)));
+        continue;
+      }
+
+      meshBatch.models.resize(count);
+      BuildModelMatrices(meshBatch.transforms, meshBatch.models.data());
+      mesh->DrawInstanced(GL_TRIANGLES, meshBatch.models.data(), count);
+      mStats.drawCalls++;
+    }
+
+    for (auto &poolBatch : mPoolBatches) {
+      PoolBatch &batch = poolBatch.second;
+      if (batch.commands.empty()) {
+        continue;
+      }
+      poolBatch.first->draw(GL_TRIANGLES, batch.commands.data(),
+                            batch.commands.size(), batch.models.data(),
+                            batch.models.size());
+      mStats.drawCalls++;
     }
   }
+
+  const RenderStats &getStats() const { return mStats; }
+
+private:
+  struct MeshBatch {
+    TransformBatch transforms;
+    std::vector<glm::mat4> models;
+  };
+
+  // Everything drawn from one pool, models indexed by baseInstance
+  struct PoolBatch {
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<glm::mat4> models;
+  };
+
+  // Leaf of an entity in the hierarchy, indexed by entity id
+  struct Proxy {
+    Entity entity;
+    int32_t leaf = BoundingVolumeHierarchy::Null;
+  };
+
+  void updateProxies(Registry &registry, const std::vector<Entity> &changed) {
+    auto &renderPool = registry.pool<RenderComponent>();
+    auto &transformPool = registry.pool<TransformComponent>();
+    auto &previousPool = registry.pool<PreviousTransformComponent>();
+
+    for (Entity entity : changed) {
+      if (entity.id >= mProxies.size()) {
+        mProxies.resize(entity.id + 1);
+      }
+      Proxy &proxy = mProxies[entity.id];
+
+      // The owner of the slot is gone, its id may already be reused
+      if (proxy.leaf != BoundingVolumeHierarchy::Null &&
+          !registry.valid(proxy.entity)) {
+        mBvh.remove(proxy.leaf);
+        proxy.leaf = BoundingVolumeHierarchy::Null;
+      }
+      if (!registry.valid(entity)) {
+        continue;
+      }
+
+      RenderComponent *renderComp = renderPool.tryGet(entity);
+      TransformComponent *transformComp = transformPool.tryGet(entity);
+      if (!renderComp || !renderComp->mesh || !transformComp) {
+        if (proxy.leaf != BoundingVolumeHierarchy::Null) {
+          mBvh.remove(proxy.leaf);
+          proxy.leaf = BoundingVolumeHierarchy::Null;
+        }
+        continue;
+      }
+
+      // Cover the previous pose too, rendering interpolates between them
+      const AABB &local = renderComp->mesh->GetBounds();
+      AABB box = TransformAABB(
+          local, ModelMatrix(transformComp->position, transformComp->rotation));
+      if (auto *previous = previousPool.tryGet(entity)) {
+        box = Merge(box, TransformAABB(local, ModelMatrix(previous->position,
+                                                          previous->rotation)));
+      }
+
+      if (proxy.leaf == BoundingVolumeHierarchy::Null) {
+        proxy.entity = entity;
+        proxy.leaf = mBvh.insert(box, entity.id);
+      } else {
+        mBvh.update(proxy.leaf, box);
+      }
+    }
+  }
+
+  std::unordered_map<Mesh *, MeshBatch> mBatches;
+  std::unordered_map<GeometryPool *, PoolBatch> mPoolBatches;
+  BoundingVolumeHierarchy mBvh;
+  std::vector<Proxy> mProxies;
+  RenderStats mStats;
 };
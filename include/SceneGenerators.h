@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Entity.h"
+
+#include <string>
+#include <vector>
+
+// Spawn lists for stress scenes, meant for World::SpawnBatch. Positions are
+// in engine coordinates (Z up) with the ground plane at z = 0.
+
+// Columns of height boxes standing side by side on a square grid
+std::vector<SpawnDesc> GenerateStacks(int count, int height = 10,
+                                      float spacing = 2.0f);
+
+// Square pyramid, baseSize x baseSize boxes on the ground
+std::vector<SpawnDesc> GeneratePyramid(int baseSize);
+
+// countX * countY * countZ boxes on a regular lattice floating above ground
+std::vector<SpawnDesc> GenerateGrid(int countX, int countY, int countZ,
+                                    float spacing = 1.5f);
+
+// Randomly placed and oriented boxes dropped from up to height
+std::vector<SpawnDesc> GenerateRandomDrop(int count, float extent,
+                                          float height, unsigned seed = 1234);
+
+// Builds a layout by name ("stack", "pyramid", "grid" or "drop") with
+// roughly count boxes. Returns false for an unknown name.
+bool GenerateLayout(const std::string &layout, int count,
+                    std::vector<SpawnDesc> &outSpawns);
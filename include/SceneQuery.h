@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Entity.h"
+#include "ThreadPool.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+
+// Which bodies a query may hit
+struct QueryFilter {
+  bool statics = true;
+  bool dynamics = true;
+  // Report whatever is hit first instead of the closest hit. Enough for
+  // line of sight checks and cheaper. Overlaps then stop at one entity.
+  bool anyHit = false;
+  // Skipped by the query, e.g. the entity casting it
+  Entity ignore;
+};
+
+// Geometry swept or overlapped, centered on the query's position
+struct QueryShape {
+  enum class Type { Sphere, Box, Capsule };
+
+  Type type = Type::Sphere;
+  float radius = 0.5f;
+  // Half the length of the capsule's segment, along its local x axis
+  float halfHeight = 0.0f;
+  glm::vec3 halfExtents = glm::vec3(0.5f);
+
+  static QueryShape Sphere(float radius) {
+    QueryShape shape;
+    shape.radius = radius;
+    return shape;
+  }
+  static QueryShape Box(const glm::vec3 &halfExtents) {
+    QueryShape shape;
+    shape.type = Type::Box;
+    shape.halfExtents = halfExtents;
+    return shape;
+  }
+  static QueryShape Capsule(float radius, float halfHeight) {
+    QueryShape shape;
+    shape.type = Type::Capsule;
+    shape.radius = radius;
+    shape.halfHeight = halfHeight;
+    return shape;
+  }
+};
+
+struct RaycastQuery {
+  glm::vec3 origin;
+  // Normalized by the query, a zero direction never hits
+  glm::vec3 direction;
+  float maxDistance = 1000.0f;
+  QueryFilter filter;
+};
+
+struct SweepQuery {
+  QueryShape shape;
+  glm::vec3 position;
+  glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+  glm::vec3 direction;
+  float maxDistance = 1000.0f;
+  QueryFilter filter;
+};
+
+struct OverlapQuery {
+  QueryShape shape;
+  glm::vec3 position;
+  glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+  QueryFilter filter;
+};
+
+// Closest (or any, see QueryFilter::anyHit) hit of a raycast or sweep.
+// Bodies that belong to no entity, like the ground, are hit with an
+// invalid entity.
+struct QueryHit {
+  bool hit = false;
+  Entity entity;
+  glm::vec3 position = glm::vec3(0.0f);
+  glm::vec3 normal = glm::vec3(0.0f);
+  float distance = 0.0f;
+};
+
+// Entities of one overlap query, a range of the shared entity list. Only
+// entity owned bodies are reported, at most MaxOverlapHits per query.
+struct OverlapResult {
+  static constexpr uint32_t MaxOverlapHits = 256;
+
+  uint32_t first = 0;
+  uint32_t count = 0;
+};
+
+// Runs batches of read-only queries against a scene, split across the
+// pool. Results are written in query order and independent of how the
+// batch was split. The scene must not be modified meanwhile.
+void RunRaycasts(const PxScene &scene, ThreadPool &threadPool,
+                 const RaycastQuery *queries, size_t count, QueryHit *hits);
+void RunSweeps(const PxScene &scene, ThreadPool &threadPool,
+               const SweepQuery *queries, size_t count, QueryHit *hits);
+// Clears entities and fills it with every query's range
+void RunOverlaps(const PxScene &scene, ThreadPool &threadPool,
+                 const OverlapQuery *queries, size_t count,
+                 OverlapResult *results, std::vector<Entity> &entities);
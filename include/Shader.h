@@ -6,14 +6,27 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 
 #include <glm/glm.hpp>
 
+#include "ProgramCache.h"
+
 std::string get_file_contents(const char *filename);
 
+// Location of a uniform resolved once, typed by the value it accepts
+template <typename T> struct Uniform {
+  GLint location = -1;
+
+  bool isValid() const { return location >= 0; }
+};
+
 class Shader {
 public:
-  Shader(const char *vertexFile, const char *fragmentFile);
+  // With a cache the linked program is loaded from disk when possible and
+  // stored there after compiling otherwise
+  Shader(const char *vertexFile, const char *fragmentFile,
+         const ProgramCache *cache = nullptr);
 
   void Activate();
   void Delete();
@@ -25,10 +38,28 @@ public:
   void setVec4(const std::string &name, glm::vec4 &value) const;
   void setMat4(const std::string &name, glm::mat4 &value) const;
 
+  // Resolves a uniform from the table built at link time
+  template <typename T> Uniform<T> getUniform(const std::string &name) const {
+    Uniform<T> uniform;
+    uniform.location = getLocation(name);
+    return uniform;
+  }
+
+  void set(Uniform<bool> uniform, bool value) const;
+  void set(Uniform<int> uniform, int value) const;
+  void set(Uniform<float> uniform, float value) const;
+  void set(Uniform<glm::vec3> uniform, const glm::vec3 &value) const;
+  void set(Uniform<glm::vec4> uniform, const glm::vec4 &value) const;
+  void set(Uniform<glm::mat4> uniform, const glm::mat4 &value) const;
+
 private:
+  void compileProgram(const std::string &vertexCode,
+                      const std::string &fragmentCode, bool retrievable);
   void compileErrors(unsigned int shader, const char *type);
+  void reflectUniforms();
   int getLocation(const std::string &name) const;
 
 private:
   GLuint mID;
+  std::unordered_map<std::string, GLint> mUniformLocations;
 };
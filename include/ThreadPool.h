@@ -0,0 +1,123 @@
+#pragma once
+
+#include "PxPhysicsAPI.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace physx;
+
+struct ThreadPoolDesc {
+  // 0 picks one worker per hardware thread, minus the main thread
+  unsigned workerCount = 0;
+  // Pin worker i to CPU (firstCpu + i) modulo the number of CPUs
+  bool pinWorkers = false;
+  unsigned firstCpu = 1;
+  // Nice value applied to every worker, 0 keeps the process default
+  int niceLevel = 0;
+};
+
+// Counts outstanding jobs so a caller can wait for a batch of them
+class TaskGroup {
+public:
+  bool done() const { return mPending.load(std::memory_order_acquire) == 0; }
+
+private:
+  friend class ThreadPool;
+  std::atomic<int> mPending{0};
+};
+
+// Work-stealing pool shared by PhysX and the engine. Every worker owns a
+// deque: it pops its own work LIFO and steals from the others FIFO. Jobs
+// submitted from outside the pool go to a shared injection queue.
+class ThreadPool : public PxCpuDispatcher {
+public:
+  explicit ThreadPool(const ThreadPoolDesc &desc = ThreadPoolDesc());
+  ~ThreadPool() override;
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // PxCpuDispatcher
+  void submitTask(PxBaseTask &task) override;
+  PxU32 getWorkerCount() const override { return mWorkers.size(); }
+
+  // Queues an engine job, optionally tracked by a group
+  void submit(std::function<void()> function, TaskGroup *group = nullptr);
+
+  // Runs queued jobs on the calling thread until the group is finished
+  void wait(TaskGroup &group);
+
+  // Calls func(begin, end) over [0, count) in chunks of at most grain
+  // items and returns once all of them ran. The caller works too. Chunks
+  // are aligned to the grain: every begin is a multiple of it, so
+  // begin / grain numbers the chunk. Without workers it is one chunk from
+  // zero. Callers rely on that to give each chunk its own output.
+  template <typename Func>
+  void parallelFor(size_t count, size_t grain, const Func &func) {
+    if (count == 0) {
+      return;
+    }
+    grain = grain > 0 ? grain : 1;
+    size_t chunks = (count + grain - 1) / grain;
+    if (chunks == 1 || mWorkers.empty()) {
+      func(size_t(0), count);
+      return;
+    }
+
+    // Captures stay within std::function's inline storage
+    struct Range {
+      const Func *func;
+      size_t count;
+      size_t grain;
+    } range{&func, count, grain};
+    const Range *rangePtr = &range;
+
+    TaskGroup group;
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+      submit(
+          [rangePtr, chunk]() {
+            size_t begin = chunk * rangePtr->grain;
+            size_t end = std::min(begin + rangePtr->grain, rangePtr->count);
+            (*rangePtr->func)(begin, end);
+          },
+          &group);
+    }
+    wait(group);
+  }
+
+private:
+  struct Job {
+    PxBaseTask *task = nullptr;
+    std::function<void()> function;
+    TaskGroup *group = nullptr;
+  };
+
+  struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+  };
+
+  void push(Job job);
+  bool pop(Job &job);
+  void run(Job &job);
+  void workerMain(unsigned index);
+  void configureWorker(unsigned index);
+
+  ThreadPoolDesc mDesc;
+  std::vector<std::thread> mWorkers;
+  std::vector<std::unique_ptr<WorkerQueue>> mQueues;
+  WorkerQueue mInjectQueue;
+
+  std::mutex mSleepMutex;
+  std::condition_variable mWakeUp;
+  std::atomic<int> mQueued{0};
+  std::atomic<bool> mStopping{false};
+};
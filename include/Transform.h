@@ -0,0 +1,21 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Rotation that takes the engine's Z-up coordinates to OpenGL's Y-up ones
+inline const glm::mat4 &BasisConversion() {
+  static const glm::mat4 basis =
+      glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f),
+                  glm::vec3(0.0f, 1.0f, 0.0f)) *
+      glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f),
+                  glm::vec3(1.0f, 0.0f, 0.0f));
+  return basis;
+}
+
+// Model matrix for a rigid transform, already converted to OpenGL coords
+inline glm::mat4 ModelMatrix(const glm::vec3 &pos, const glm::quat &rot) {
+  glm::mat4 transform = glm::translate(glm::mat4(1.0f), pos) * glm::toMat4(rot);
+  return BasisConversion() * transform;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// Positions and rotations of many rigid transforms, one array per
+// component so the matrix kernels can load several transforms at once
+struct TransformBatch {
+  std::vector<float> px, py, pz;
+  std::vector<float> qx, qy, qz, qw;
+
+  size_t size() const { return px.size(); }
+
+  void clear() {
+    for (std::vector<float> *component : components()) {
+      component->clear();
+    }
+  }
+
+  void reserve(size_t capacity) {
+    for (std::vector<float> *component : components()) {
+      component->reserve(capacity);
+    }
+  }
+
+  void push(const glm::vec3 &position, const glm::quat &rotation) {
+    px.push_back(position.x);
+    py.push_back(position.y);
+    pz.push_back(position.z);
+    qx.push_back(rotation.x);
+    qy.push_back(rotation.y);
+    qz.push_back(rotation.z);
+    qw.push_back(rotation.w);
+  }
+
+private:
+  std::array<std::vector<float> *, 7> components() {
+    return {&px, &py, &pz, &qx, &qy, &qz, &qw};
+  }
+};
+
+enum class SimdLevel { Scalar, SSE2, AVX };
+
+// Widest kernel this binary was compiled with. AVX needs -mavx (or the
+// EMBER_NATIVE_ARCH CMake option), SSE2 is always there on x86-64.
+SimdLevel BestSimdLevel();
+const char *SimdLevelName(SimdLevel level);
+
+// Writes ModelMatrix(position[i], rotation[i]) for every transform of the
+// batch into out, which must hold batch.size() matrices. The basis
+// conversion is folded into the kernel. Rotations must be unit length.
+void BuildModelMatrices(const TransformBatch &batch, glm::mat4 *out);
+
+// Same, with a given kernel. Levels above BestSimdLevel() fall back to it.
+void BuildModelMatrices(const TransformBatch &batch, glm::mat4 *out,
+                        SimdLevel level);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "VBO.h"
+#include "VertexLayout.h"
 #include <glad/glad.h>
 
 class VAO {
@@ -9,8 +10,14 @@ public:
 
   VAO();
 
+  // normalized maps integer types to [0, 1] or [-1, 1]
   void LinkAttrib(VBO &VBO, GLuint layout, GLuint numComponents, GLenum type,
-                  GLsizeiptr stride, void *offset);
+                  GLsizeiptr stride, void *offset,
+                  GLboolean normalized = GL_FALSE);
+  // Links every attribute of the layout
+  void LinkLayout(VBO &VBO, const VertexLayout &layout);
+  // Links a per-instance mat4 spanning layouts [layout, layout + 3]
+  void LinkInstanceMat4(VBO &VBO, GLuint layout);
   void Bind();
   void Unbind();
   void Delete();
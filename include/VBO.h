@@ -15,6 +15,10 @@ public:
   GLuint ID;
 
   VBO(std::vector<Vertex> &vertices);
+  VBO(GLsizeiptr size, const void *data, GLenum usage);
+
+  // Replaces the whole buffer store, orphaning the previous one
+  void Upload(GLsizeiptr size, const void *data, GLenum usage);
 
   void Bind();
   void Unbind();
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "VBO.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// How a mesh's vertices are stored on the GPU. The shaders see the same
+// vec3 position, normal and color inputs for every format.
+enum class VertexFormat : uint32_t {
+  // Vertex, 36 bytes
+  Float = 0,
+  // PackedVertex, 16 bytes
+  Packed = 1,
+};
+
+// Half float position, signed normalized 2_10_10_10 normal and RGBA8 color.
+// Half floats keep about three significant digits, plenty for meshes
+// authored in model space around the origin.
+struct PackedVertex {
+  uint16_t Position[3];
+  uint16_t Padding;
+  uint32_t Normal;
+  uint32_t Color;
+};
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must stay 16 bytes");
+
+// One glVertexAttribPointer call
+struct VertexAttribute {
+  GLuint location;
+  GLint components;
+  GLenum type;
+  GLboolean normalized;
+  size_t offset;
+};
+
+struct VertexLayout {
+  GLsizei stride;
+  std::vector<VertexAttribute> attributes;
+};
+
+// Layout matching the locations in shaders/vert.glsl
+const VertexLayout &GetVertexLayout(VertexFormat format);
+size_t VertexStride(VertexFormat format);
+bool IsValidVertexFormat(uint32_t format);
+
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t value);
+
+PackedVertex PackVertex(const Vertex &vertex);
+Vertex UnpackVertex(const PackedVertex &vertex);
+std::vector<PackedVertex> PackVertices(const Vertex *vertices, size_t count);
@@ -1,22 +1,470 @@
+#pragma once
+
 #include "PhysicsSystem.h"
-#include "RenderSystem.h"
+#include "Recording.h"
+#include "SceneQuery.h"
+#include "ThreadPool.h"
+#include "WorldSnapshot.h"
+
+#include <cmath>
 
+// Simulation state only. Rendering reads the registry from outside so the
+// world can run without a window or GL context.
 class World {
 public:
-  void AddEntity(Entity entity) { entities.push_back(entity); }
+  explicit World(const ThreadPoolDesc &threadPoolDesc = ThreadPoolDesc(),
+                 const PhysicsProfile &physicsProfile = PhysicsProfile())
+      : mThreadPool(threadPoolDesc),
+        mPhysicsSystem(mThreadPool, physicsProfile) {}
+
+  // Creates a physics driven cube entity that is not rendered
+  Entity AddEntity(const glm::vec3 &position, const glm::quat &rotation,
+                   float mass = 1.0f) {
+    flushDestroyed();
+
+    SpawnDesc spawn{position, rotation, mass};
+    Entity entity = mRegistry.create();
+    PxRigidDynamic *actor = nullptr;
+    mPhysicsSystem.createDynamicBoxes(&entity, &spawn, 1, &actor);
+    mRegistry.emplace<TransformComponent>(entity, position, rotation);
+    mRegistry.emplace<PreviousTransformComponent>(entity, position, rotation);
+    mRegistry.emplace<PhysicsComponent>(entity, actor);
+    recordSpawns(&entity, 1);
+    return entity;
+  }
+
+  // Creates a physics driven cube entity drawn with the given mesh
+  Entity AddEntity(std::shared_ptr<Mesh> mesh, const glm::vec3 &position,
+                   const glm::quat &rotation, float mass = 1.0f) {
+    Entity entity = AddEntity(position, rotation, mass);
+    mRegistry.emplace<RenderComponent>(entity, std::move(mesh));
+    return entity;
+  }
+
+  // Creates one cube entity per spawn. Component storage is reserved up
+  // front and the actors enter the scene in one bulk insertion. A null mesh
+  // spawns physics-only entities. Created entities are appended to
+  // outEntities when given.
+  void SpawnBatch(const std::vector<SpawnDesc> &spawns,
+                  std::shared_ptr<Mesh> mesh = nullptr,
+                  std::vector<Entity> *outEntities = nullptr) {
+    PROFILE_SCOPE("World::SpawnBatch");
+    flushDestroyed();
+
+    size_t count = spawns.size();
+    size_t total = mRegistry.size() + count;
+    mRegistry.reserve<TransformComponent>(total);
+    mRegistry.reserve<PreviousTransformComponent>(total);
+    mRegistry.reserve<PhysicsComponent>(total);
+    if (mesh) {
+      mRegistry.reserve<RenderComponent>(total);
+    }
+
+    mSpawnEntities.resize(count);
+    mSpawnActors.resize(count);
+    for (size_t i = 0; i < count; i++) {
+      mSpawnEntities[i] = mRegistry.create();
+    }
+    mPhysicsSystem.createDynamicBoxes(mSpawnEntities.data(), spawns.data(),
+                                      count, mSpawnActors.data());
+
+    for (size_t i = 0; i < count; i++) {
+      Entity entity = mSpawnEntities[i];
+      const SpawnDesc &spawn = spawns[i];
+      mRegistry.emplace<TransformComponent>(entity, spawn.position,
+                                            spawn.rotation);
+      mRegistry.emplace<PreviousTransformComponent>(entity, spawn.position,
+                                                    spawn.rotation);
+      mRegistry.emplace<PhysicsComponent>(entity, mSpawnActors[i]);
+      if (mesh) {
+        mRegistry.emplace<RenderComponent>(entity, mesh);
+      }
+    }
+
+    recordSpawns(mSpawnEntities.data(), count);
+    if (outEntities) {
+      outEntities->insert(outEntities->end(), mSpawnEntities.begin(),
+                          mSpawnEntities.end());
+    }
+  }
+
+  // Writes every physics entity, its components and its actor to one
+  // binary file, see WorldSnapshot.h. Meshes are not saved, only whether
+  // an entity was drawn. Must not be called between BeginUpdate and
+  // EndUpdate. Throws std::runtime_error on failure.
+  void SaveSnapshot(const std::string &path) {
+    PROFILE_SCOPE("World::SaveSnapshot");
+    requireIdleScene();
+    flushDestroyed();
+    syncPendingStep();
+
+    auto &physicsPool = mRegistry.pool<PhysicsComponent>();
+    auto &renderPool = mRegistry.pool<RenderComponent>();
+    size_t count = physicsPool.size();
+    std::vector<SnapshotBody> bodies(count);
+    mSpawnActors.resize(count);
+    for (size_t i = 0; i < count; i++) {
+      // World creates physics entities with both transforms
+      Entity entity = physicsPool.entities()[i];
+      const TransformComponent *transform =
+          mRegistry.get<TransformComponent>(entity);
+      const PreviousTransformComponent *previous =
+          mRegistry.get<PreviousTransformComponent>(entity);
+      mSpawnActors[i] = physicsPool.components()[i].actor;
+
+      SnapshotBody &body = bodies[i];
+      for (int k = 0; k < 3; k++) {
+        body.position[k] = transform->position[k];
+        body.previousPosition[k] = previous->position[k];
+      }
+      for (int k = 0; k < 4; k++) {
+        // glm stores quaternions as x, y, z, w
+        body.rotation[k] = transform->rotation[k];
+        body.previousRotation[k] = previous->rotation[k];
+      }
+      body.flags = renderPool.tryGet(entity) ? SnapshotBody::Rendered : 0;
+    }
+    WriteWorldSnapshot(path, mPhysicsSystem, bodies.data(),
+                       mSpawnActors.data(), count);
+  }
+
+  // Adds the entities of a snapshot to the world. The actors are mapped
+  // and deserialized in place and enter the scene in one bulk insertion,
+  // nothing is created or integrated per body. Entities that were drawn
+  // when saved get the given mesh. Created entities are appended to
+  // outEntities when given. Throws std::runtime_error if the snapshot
+  // can't be loaded.
+  void LoadSnapshot(const std::string &path,
+                    std::shared_ptr<Mesh> mesh = nullptr,
+                    std::vector<Entity> *outEntities = nullptr) {
+    PROFILE_SCOPE("World::LoadSnapshot");
+    requireIdleScene();
+    flushDestroyed();
+
+    LoadedSnapshot snapshot = ReadWorldSnapshot(path, mPhysicsSystem);
+    size_t count = snapshot.count;
+    size_t total = mRegistry.size() + count;
+    mRegistry.reserve<TransformComponent>(total);
+    mRegistry.reserve<PreviousTransformComponent>(total);
+    mRegistry.reserve<PhysicsComponent>(total);
+    if (mesh) {
+      mRegistry.reserve<RenderComponent>(total);
+    }
+
+    mSpawnEntities.resize(count);
+    for (size_t i = 0; i < count; i++) {
+      const SnapshotBody &body = snapshot.bodies[i];
+      Entity entity = mRegistry.create();
+      mSpawnEntities[i] = entity;
+      snapshot.actors[i]->userData = EntityToUserData(entity);
+      mRegistry.emplace<TransformComponent>(
+          entity, glm::vec3(body.position[0], body.position[1],
+                            body.position[2]),
+          glm::quat(body.rotation[3], body.rotation[0], body.rotation[1],
+                    body.rotation[2]));
+      mRegistry.emplace<PreviousTransformComponent>(
+          entity,
+          glm::vec3(body.previousPosition[0], body.previousPosition[1],
+                    body.previousPosition[2]),
+          glm::quat(body.previousRotation[3], body.previousRotation[0],
+                    body.previousRotation[1], body.previousRotation[2]));
+      mRegistry.emplace<PhysicsComponent>(entity, snapshot.actors[i]);
+      if (mesh && (body.flags & SnapshotBody::Rendered)) {
+        mRegistry.emplace<RenderComponent>(entity, mesh);
+      }
+    }
+
+    recordSpawns(mSpawnEntities.data(), count);
+    if (outEntities) {
+      outEntities->insert(outEntities->end(), mSpawnEntities.begin(),
+                          mSpawnEntities.end());
+    }
+  }
+
+  // Marks the entity for destruction. It stays alive until the next safe
+  // point (the start of BeginUpdate, Step or a spawn), where its actor goes
+  // back to the physics pool and its id is freed. Safe to call at any
+  // time, stale and repeated handles are ignored.
+  void DestroyEntity(Entity entity) {
+    if (mRegistry.valid(entity)) {
+      mPendingDestroy.push_back(entity);
+    }
+  }
+
+  bool IsAlive(Entity entity) const { return mRegistry.valid(entity); }
+
+  // Advances the simulation by the real frame time in fixed steps. Time
+  // that is left over carries into the next frame and sets the alpha used
+  // to interpolate rendering between the last two steps.
+  void Update(float frameTime) {
+    BeginUpdate(frameTime);
+    EndUpdate();
+    syncPendingStep();
+  }
+
+  // Split version of Update. Every step due this frame but the last runs
+  // to completion; the last one is left simulating on the PhysX workers so
+  // the caller can render the previous state in the meantime. The registry
+  // and scene must not be modified before EndUpdate.
+  //
+  // The registry trails the newest step by one: EndUpdate fetches the last
+  // step but its poses only reach the entities when the next step starts.
+  // Whether a frame starts a step or not, the alpha then interpolates
+  // between the two states before the newest, so the drawn pose lags real
+  // time by a constant two steps instead of jumping by one.
+  void BeginUpdate(float frameTime) {
+    PROFILE_SCOPE("World::BeginUpdate");
+    flushDestroyed();
+    mAccumulator += frameTime;
+
+    int steps = 0;
+    while (mAccumulator >= mFixedStep && steps < mMaxSubsteps) {
+      mAccumulator -= mFixedStep;
+      steps++;
+    }
+
+    // Too far behind to catch up, drop the backlog instead of spiralling
+    if (mAccumulator >= mFixedStep) {
+      mAccumulator = std::fmod(mAccumulator, mFixedStep);
+    }
+    mAlpha = mAccumulator / mFixedStep;
+
+    mStepsLastUpdate = steps;
+    if (steps > 0) {
+      syncPendingStep();
+    }
+    for (int i = 0; i + 1 < steps; i++) {
+      Step(mFixedStep);
+    }
+    if (steps > 0) {
+      mPhysicsSystem.beginStep(mFixedStep);
+    }
+  }
+
+  // Sync point for BeginUpdate, waits for the step still in flight. Its
+  // poses are synced when the next step starts or the world is saved.
+  void EndUpdate() {
+    PROFILE_SCOPE("World::EndUpdate");
+    if (mPhysicsSystem.isSimulating()) {
+      mPhysicsSystem.fetchStep();
+    }
+  }
+
+  // Runs exactly one physics step of the given length
+  void Step(float deltaTime) {
+    flushDestroyed();
+    syncPendingStep();
+    mPhysicsSystem.update(deltaTime, mRegistry);
+    afterStep();
+  }
 
-  void Update(float deltaTime, Shader &shader, Camera &camera) {
-    mPhysicsSystem.update(deltaTime, entities);
-    mRenderSystem.render(shader, camera, entities);
-    // std::cout << "Entities: " << entities.size() << std::endl;
+  void SetStepRate(float stepsPerSecond) { mFixedStep = 1.0f / stepsPerSecond; }
+  float GetStepRate() const { return 1.0f / mFixedStep; }
+  void SetMaxSubsteps(int maxSubsteps) { mMaxSubsteps = maxSubsteps; }
+  int GetMaxSubsteps() const { return mMaxSubsteps; }
+
+  // Fraction of a step between the previous and the current physics state
+  float GetInterpolationAlpha() const { return mAlpha; }
+  int GetStepsLastUpdate() const { return mStepsLastUpdate; }
+
+  // Off by default. While on, every entity that is spawned, moved by a step
+  // or destroyed is appended to a list that grows until it is cleared.
+  // Entries may repeat and may refer to entities that no longer exist.
+  void SetChangeTracking(bool enabled) {
+    mTrackChanges = enabled;
+    mChangedEntities.clear();
+  }
+  const std::vector<Entity> &GetChangedEntities() const {
+    return mChangedEntities;
+  }
+  void ClearChangedEntities() { mChangedEntities.clear(); }
+
+  // While on, the physics debug geometry is refreshed after every step:
+  // what PhysX visualizes plus the bounds of every sleeping body. Must not
+  // be called between BeginUpdate and EndUpdate.
+  void SetDebugVisualization(bool enabled) {
+    mPhysicsSystem.setDebugVisualization(enabled);
+    mPhysicsDebugDraw.clear();
+  }
+  bool GetDebugVisualization() const {
+    return mPhysicsSystem.isDebugVisualizationEnabled();
+  }
+  const DebugDraw &GetPhysicsDebugDraw() const { return mPhysicsDebugDraw; }
+  // Engine side lines and boxes, cleared by whoever draws them
+  DebugDraw &GetDebugDraw() { return mDebugDraw; }
+
+  // Batched scene queries, spread over the thread pool and answered in
+  // terms of entities. hits and results get one entry per query, in query
+  // order. Must not be called between BeginUpdate and EndUpdate.
+  void RaycastBatch(const std::vector<RaycastQuery> &queries,
+                    std::vector<QueryHit> &hits) {
+    requireIdleScene();
+    hits.resize(queries.size());
+    RunRaycasts(*mPhysicsSystem.GetScene(), mThreadPool, queries.data(),
+                queries.size(), hits.data());
+  }
+  void SweepBatch(const std::vector<SweepQuery> &queries,
+                  std::vector<QueryHit> &hits) {
+    requireIdleScene();
+    hits.resize(queries.size());
+    RunSweeps(*mPhysicsSystem.GetScene(), mThreadPool, queries.data(),
+              queries.size(), hits.data());
+  }
+  // The entities overlapping query i are
+  // entities[results[i].first, results[i].first + results[i].count)
+  void OverlapBatch(const std::vector<OverlapQuery> &queries,
+                    std::vector<OverlapResult> &results,
+                    std::vector<Entity> &entities) {
+    requireIdleScene();
+    results.resize(queries.size());
+    RunOverlaps(*mPhysicsSystem.GetScene(), mThreadPool, queries.data(),
+                queries.size(), results.data(), entities);
+  }
+
+  // Streams the pose of every physics entity after each step to path, see
+  // Recording.h. Frames are stamped with the current step rate. Replaces a
+  // recording in progress. Must not be called between BeginUpdate and
+  // EndUpdate. Throws std::runtime_error if path can't be created.
+  void StartRecording(const std::string &path) {
+    requireIdleScene();
+    flushDestroyed();
+    syncPendingStep();
+    StopRecording();
+    mRecorder = std::make_unique<SimulationRecorder>(path, mFixedStep);
+    const auto &entities = mRegistry.pool<PhysicsComponent>().entities();
+    mRecorder->addBodies(entities.data(), entities.size());
+    mPhysicsSystem.setRecorder(mRecorder.get());
+  }
+
+  // Finishes the file and returns what the recording cost. Does nothing
+  // without a recording. Throws std::runtime_error if the file can't be
+  // completed, it is removed then.
+  RecordingStats StopRecording() {
+    requireIdleScene();
+    if (!mRecorder) {
+      return RecordingStats();
+    }
+    // The last fetched step belongs to the recording
+    syncPendingStep();
+    mPhysicsSystem.setRecorder(nullptr);
+    std::unique_ptr<SimulationRecorder> recorder = std::move(mRecorder);
+    recorder->finish();
+    return recorder->getStats();
+  }
+
+  bool IsRecording() const { return mRecorder != nullptr; }
+  RecordingStats GetRecordingStats() const {
+    return mRecorder ? mRecorder->getStats() : RecordingStats();
   }
 
   PhysicsSystem *GetPhysicsSystem() { return &mPhysicsSystem; }
+  // Shared by PhysX and engine jobs, see ThreadPool::parallelFor
+  ThreadPool &GetThreadPool() { return mThreadPool; }
+  Registry &GetRegistry() { return mRegistry; }
 
-  int GetEntitiesCount() { return entities.size(); }
+  int GetEntitiesCount() { return mRegistry.size(); }
 
 private:
-  std::vector<Entity> entities;
+  void requireIdleScene() const {
+    if (mPhysicsSystem.isSimulating()) {
+      throw std::runtime_error("Cannot query the scene while it simulates.");
+    }
+  }
+
+  // Applies pending DestroyEntity calls. Needs the scene to be idle.
+  void flushDestroyed() {
+    if (mPendingDestroy.empty()) {
+      return;
+    }
+
+    mDestroyActors.clear();
+    auto &physicsPool = mRegistry.pool<PhysicsComponent>();
+    for (Entity entity : mPendingDestroy) {
+      // A handle queued twice is already stale the second time
+      if (!mRegistry.valid(entity)) {
+        continue;
+      }
+      if (PhysicsComponent *physicsComp = physicsPool.tryGet(entity)) {
+        mDestroyActors.push_back(physicsComp->actor);
+      }
+      if (mRecorder) {
+        mRecorder->removeBody(entity);
+      }
+      mRegistry.destroy(entity);
+      recordChanges(&entity, 1);
+    }
+    mPendingDestroy.clear();
+
+    mPhysicsSystem.releaseActors(mDestroyActors.data(), mDestroyActors.size());
+  }
+
+  void recordSpawns(const Entity *entities, size_t count) {
+    recordChanges(entities, count);
+    if (mRecorder) {
+      mRecorder->addBodies(entities, count);
+    }
+  }
+
+  void recordChanges(const Entity *entities, size_t count) {
+    if (mTrackChanges) {
+      mChangedEntities.insert(mChangedEntities.end(), entities,
+                              entities + count);
+    }
+  }
+
+  void syncPendingStep() {
+    if (mPhysicsSystem.isSyncPending()) {
+      mPhysicsSystem.syncTransforms(mRegistry);
+      afterStep();
+    }
+  }
+
+  // Runs after the results of every step were synced
+  void afterStep() {
+    const std::vector<Entity> &moved = mPhysicsSystem.getMovedEntities();
+    recordChanges(moved.data(), moved.size());
+
+    if (mPhysicsSystem.isDebugVisualizationEnabled()) {
+      mPhysicsDebugDraw.clear();
+      mPhysicsSystem.appendDebugGeometry(mPhysicsDebugDraw);
+      for (const PhysicsComponent &physicsComp :
+           mRegistry.pool<PhysicsComponent>().components()) {
+        if (physicsComp.actor->isSleeping()) {
+          PxBounds3 bounds = physicsComp.actor->getWorldBounds(1.0f);
+          AABB box;
+          box.min = glm::vec3(bounds.minimum.x, bounds.minimum.y,
+                              bounds.minimum.z);
+          box.max = glm::vec3(bounds.maximum.x, bounds.maximum.y,
+                              bounds.maximum.z);
+          mPhysicsDebugDraw.addAABB(box, DebugDraw::Blue);
+        }
+      }
+    }
+  }
+
+  Registry mRegistry;
+  // Declared before the physics system so it outlives the scene
+  ThreadPool mThreadPool;
   PhysicsSystem mPhysicsSystem;
-  RenderSystem mRenderSystem;
+
+  float mFixedStep = 1.0f / 60.0f;
+  int mMaxSubsteps = 8;
+  float mAccumulator = 0.0f;
+  float mAlpha = 0.0f;
+  int mStepsLastUpdate = 0;
+
+  // Scratch space reused by SpawnBatch and flushDestroyed
+  std::vector<Entity> mSpawnEntities;
+  std::vector<PxRigidDynamic *> mSpawnActors;
+  std::vector<Entity> mPendingDestroy;
+  std::vector<PxRigidDynamic *> mDestroyActors;
+
+  bool mTrackChanges = false;
+  std::vector<Entity> mChangedEntities;
+
+  DebugDraw mPhysicsDebugDraw;
+  DebugDraw mDebugDraw;
+
+  // Finishes its file when the world goes away
+  std::unique_ptr<SimulationRecorder> mRecorder;
 };
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "PhysicsSystem.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary snapshot of every physics entity in a World. The actors are a
+// PhysX binary collection, which restores them exactly (pose, velocities,
+// sleep state, mass) without creating or integrating anything, and which
+// PhysX deserializes in place in the mapped file.
+//
+// Shapes and materials are not part of the collection. They are stored by
+// their parameters and taken from the PhysicsAssetCache on load, so they
+// stay shared with everything spawned later.
+//
+// Layout: WorldSnapshotHeader, then materials, shapes and bodies, each 16
+// byte aligned, then the collection at a multiple of 128 bytes as PhysX
+// requires. Snapshots only load into the PhysX version that wrote them.
+struct WorldSnapshotHeader {
+  static constexpr uint32_t Magic = 0x504e5345; // "ESNP"
+  // Bump whenever one of the records below changes
+  static constexpr uint32_t CurrentVersion = 1;
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t physxVersion;
+  uint32_t reserved;
+  uint64_t materialCount;
+  uint64_t shapeCount;
+  uint64_t bodyCount;
+  uint64_t materialOffset;
+  uint64_t shapeOffset;
+  uint64_t bodyOffset;
+  uint64_t collectionOffset;
+  uint64_t collectionSize;
+};
+
+struct SnapshotMaterial {
+  float staticFriction;
+  float dynamicFriction;
+  float restitution;
+};
+
+// A cached box, sphere or capsule, params as PhysicsAssetCache keys them
+struct SnapshotShape {
+  uint32_t type;
+  float params[3];
+  uint32_t material;
+};
+
+// Components of one entity, in the order of the collection's actors
+struct SnapshotBody {
+  static constexpr uint32_t Rendered = 1;
+
+  float position[3];
+  // x, y, z, w
+  float rotation[4];
+  float previousPosition[3];
+  float previousRotation[4];
+  uint32_t flags;
+};
+
+// Writes to a temporary file and renames it over path. The scene must not
+// be simulating. Throws std::runtime_error on failure.
+void WriteWorldSnapshot(const std::string &path, PhysicsSystem &physics,
+                        const SnapshotBody *bodies,
+                        PxRigidDynamic *const *actors, size_t count);
+
+struct LoadedSnapshot {
+  size_t count = 0;
+  // Point into the mapped file, valid until one of the actors is released
+  const SnapshotBody *bodies = nullptr;
+  // Already in the scene, userData is still unset
+  std::vector<PxRigidDynamic *> actors;
+};
+
+// Maps path, deserializes its actors and adds all of them to the scene in
+// one go. The actors live in the mapping, the physics system keeps it until
+// the last of them is released. Throws std::runtime_error if the file is
+// missing, corrupt or from another format or PhysX version, nothing is
+// added then.
+LoadedSnapshot ReadWorldSnapshot(const std::string &path,
+                                 PhysicsSystem &physics);
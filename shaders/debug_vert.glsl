@@ -0,0 +1,22 @@
+#version 430 core
+
+layout (location = 0) in vec3 aPos;
+// Packed 0xAARRGGBB, unpacked by the BGRA attribute format
+layout (location = 1) in vec4 aColor;
+
+out vec4 color;
+
+layout (std140, binding = 0) uniform CameraBlock
+{
+	mat4 camMatrix;
+	vec4 camPos;
+};
+
+// Engine (Z up) to OpenGL coordinates, see BasisConversion()
+uniform mat4 basis;
+
+void main()
+{
+	gl_Position = camMatrix * basis * vec4(aPos, 1.0f);
+	color = aColor;
+}
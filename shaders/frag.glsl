@@ -9,7 +9,11 @@ in vec3 crntPos;
 vec4 lightColor = vec4(1,1,1,1);
 vec3 lightPos = vec3(0.5f, 0.5f, 0.5f);
 
-uniform vec3 camPos;
+layout (std140, binding = 0) uniform CameraBlock
+{
+	mat4 camMatrix;
+	vec4 camPos;
+};
 
 vec4 direcLight()
 {
@@ -23,7 +27,7 @@ vec4 direcLight()
 
 	// specular lighting
 	float specularLight = 0.50f;
-	vec3 viewDirection = normalize(camPos - crntPos);
+	vec3 viewDirection = normalize(camPos.xyz - crntPos);
 	vec3 reflectionDirection = reflect(-lightDirection, normal);
 	float specAmount = pow(max(dot(viewDirection, reflectionDirection), 0.0f), 16);
 	float specular = specAmount * specularLight;
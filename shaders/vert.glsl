@@ -1,23 +1,31 @@
 #version 430 core
 
+// See GetVertexLayout. With VertexFormat::Packed the position arrives as
+// half floats, the color as normalized RGBA8 and the normal as normalized
+// 2_10_10_10, the normalize in main() absorbs its quantization error.
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aColor;
 layout (location = 2) in vec3 aNormal;
+// Per-instance model matrix, occupies locations 3-6
+layout (location = 3) in mat4 aModel;
 
 out vec3 color;
 out vec3 Normal;
 out vec3 crntPos;
 
-uniform mat4 camMatrix;
-uniform mat4 model;
+layout (std140, binding = 0) uniform CameraBlock
+{
+	mat4 camMatrix;
+	vec4 camPos;
+};
 
 void main()
 {
-  crntPos = vec3(model * vec4(aPos, 1.0f));
+  crntPos = vec3(aModel * vec4(aPos, 1.0f));
 	gl_Position = camMatrix * vec4(crntPos, 1.0f);
 
 	color = aColor;
 
-  mat3 normalMatrix = transpose(inverse(mat3(model)));
+  mat3 normalMatrix = transpose(inverse(mat3(aModel)));
   Normal = normalize(normalMatrix * aNormal);
 }
@@ -6,47 +6,66 @@
 #include <backends/imgui_impl_opengl3.h>
 #include <imgui.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <unistd.h>
 
+static const char *sSpawnLayouts[] = {"stack", "pyramid", "grid", "drop"};
+
 Application::Application(unsigned int width, unsigned int height,
-                         bool fullscreen)
+                         bool fullscreen, const std::string &replayPath)
     : mWindow(nullptr, glfwDestroyWindow) {
   initWindow(width, height, fullscreen);
   mResolution = glm::vec2(width, height);
-  mShader =
-      std::make_unique<Shader>("../shaders/vert.glsl", "../shaders/frag.glsl");
+  auto shaderStart = std::chrono::steady_clock::now();
+  mProgramCache = std::make_unique<ProgramCache>("shader_cache");
+  mShader = std::make_unique<Shader>("../shaders/vert.glsl",
+                                     "../shaders/frag.glsl",
+                                     mProgramCache.get());
+  mDebugShader = std::make_unique<Shader>("../shaders/debug_vert.glsl",
+                                         "../shaders/debug_frag.glsl",
+                                         mProgramCache.get());
+  std::cout << "Shaders ready in "
+            << std::chrono::duration<float, std::milli>(
+                   std::chrono::steady_clock::now() - shaderStart)
+                   .count()
+            << " ms" << std::endl;
+  mDebugShader->Activate();
+  mDebugShader->set(mDebugShader->getUniform<glm::mat4>("basis"),
+                    BasisConversion());
+  mDebugRenderer = std::make_unique<DebugRenderer>();
+  mGpuTimer = std::make_unique<GpuTimer>();
+  Profiler::get().setThreadName("main");
   mCamera =
       std::make_unique<Camera>(width, height, glm::vec3(0.0f, 1.0f, 2.0f));
-  mWorld = std::make_unique<World>();
 
   initImGui();
 
-  mCubeMesh = std::make_shared<Mesh>(Mesh::CreateCube(1.0f));
+  mGeometryPool = std::make_unique<GeometryPool>(VertexFormat::Packed);
+  mCubeMesh = std::make_shared<Mesh>(
+      Mesh::CreateCube(1.0f, VertexFormat::Packed, mGeometryPool.get()));
+  // Only the GPU buffers are drawn from
+  mCubeMesh->ReleaseCpuData();
 
-  // Entity 1
-  Entity cubeEntity1(mCubeMesh, glm::vec3(0.0f, 0.0f, 2.0f),
-                     glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
-                     mWorld->GetPhysicsSystem()->GetPhysics(),
-                     mWorld->GetPhysicsSystem()->GetScene(), 10.0f);
+  if (!replayPath.empty()) {
+    mPlayback = std::make_unique<SimulationPlayback>(replayPath, mCubeMesh);
+    return;
+  }
 
-  // Entity 2
-  Entity cubeEntity2(
-      mCubeMesh, glm::vec3(1.0f, 2.0f, 5.0f),
-      glm::angleAxis(glm::radians(40.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
-      mWorld->GetPhysicsSystem()->GetPhysics(),
-      mWorld->GetPhysicsSystem()->GetScene(), 5.0f);
+  mWorld = std::make_unique<World>();
+  // Feeds the render system's culling hierarchy
+  mWorld->SetChangeTracking(true);
 
-  Entity cubeEntity3(
+  mWorld->AddEntity(mCubeMesh, glm::vec3(0.0f, 0.0f, 2.0f),
+                    glm::quat(1.0f, 0.0f, 0.0f, 0.0f), 10.0f);
+  mWorld->AddEntity(
+      mCubeMesh, glm::vec3(1.0f, 2.0f, 5.0f),
+      glm::angleAxis(glm::radians(40.0f), glm::vec3(0.0f, 1.0f, 0.0f)), 5.0f);
+  mWorld->AddEntity(
       mCubeMesh, glm::vec3(2.0f, 2.0f, 5.0f),
-      glm::angleAxis(glm::radians(40.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-      mWorld->GetPhysicsSystem()->GetPhysics(),
-      mWorld->GetPhysicsSystem()->GetScene(), 5.0f);
-
-  // Add entities to the world
-  mWorld->AddEntity(cubeEntity1);
-  mWorld->AddEntity(cubeEntity2);
-  mWorld->AddEntity(cubeEntity3);
+      glm::angleAxis(glm::radians(40.0f), glm::vec3(1.0f, 0.0f, 0.0f)), 5.0f);
 }
 
 void Application::initWindow(unsigned int width, unsigned int height,
@@ -114,61 +133,402 @@ void Application::initImGui() {
 void Application::Run() {
   std::cout << "Application Run" << std::endl;
 
-  float ts = 0.0f;
+  double lastTime = glfwGetTime();
 
   // Render loop
   while (!glfwWindowShouldClose(mWindow.get())) {
+    Profiler::get().beginFrame();
+    PROFILE_SCOPE("Frame");
+
     int width, height;
     glfwGetWindowSize(mWindow.get(), &width, &height);
     mResolution = glm::vec2(width, height);
     mCamera->OnResize(mResolution);
 
-    processInput();
+    {
+      PROFILE_SCOPE("Input");
+      processInput();
+    }
 
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    float ts = 1.0f / ImGui::GetIO().Framerate;
+    double time = glfwGetTime();
+    float ts = (float)(time - lastTime);
+    lastTime = time;
+
     mCamera->Inputs(mWindow.get(), ts);
     mCamera->updateMatrix();
-
-    ts = 1.0f / 60.0f;
-    // std::cout << ts << std::endl;
-    mWorld->Update(ts, *mShader, *mCamera);
+    mCamera->UploadUniforms();
+
+    if (mPlayback) {
+      // Recorded steps are interpolated the same way as simulated ones
+      mPlayback->Update(mPlaybackPaused ? 0.0f : ts * mPlaybackSpeed);
+      mGpuTimer->begin("Scene");
+      mRenderSystem.render(*mShader, mPlayback->GetRegistry(),
+                           mPlayback->GetChangedEntities(),
+                           Frustum::FromMatrix(mCamera->GetMatrix()),
+                           mPlayback->GetInterpolationAlpha());
+      mGpuTimer->end();
+      mPlayback->ClearChangedEntities();
+      renderImGui();
+      mGpuTimer->endFrame();
+
+      {
+        PROFILE_SCOPE("SwapBuffers");
+        glfwSwapBuffers(mWindow.get());
+      }
+      glfwPollEvents();
+      continue;
+    }
+
+    // Physics runs at its own fixed rate, rendering interpolates between
+    // steps. The last step of the frame simulates while we render the state
+    // before it and is collected at the sync point below. The registry
+    // keeps trailing it by one step in frames without a step, so every
+    // frame is drawn with the same delay.
+    mWorld->BeginUpdate(ts);
+    mGpuTimer->begin("Scene");
+    mRenderSystem.render(*mShader, mWorld->GetRegistry(),
+                         mWorld->GetChangedEntities(),
+                         Frustum::FromMatrix(mCamera->GetMatrix()),
+                         mWorld->GetInterpolationAlpha());
+    mGpuTimer->end();
+    mWorld->ClearChangedEntities();
+    {
+      PROFILE_SCOPE("DebugRenderer::draw");
+      mGpuTimer->begin("Debug");
+      mDebugRenderer->draw(*mDebugShader, {&mWorld->GetPhysicsDebugDraw(),
+                                           &mWorld->GetDebugDraw()});
+      mGpuTimer->end();
+      mWorld->GetDebugDraw().clear();
+    }
     renderImGui();
+    mGpuTimer->endFrame();
+    mWorld->EndUpdate();
 
-    glfwSwapBuffers(mWindow.get());
+    {
+      PROFILE_SCOPE("SwapBuffers");
+      glfwSwapBuffers(mWindow.get());
+    }
     glfwPollEvents();
   }
 }
 
 void Application::renderImGui() {
+  PROFILE_SCOPE("ImGui");
   ImGui_ImplOpenGL3_NewFrame();
   ImGui_ImplGlfw_NewFrame();
   ImGui::NewFrame();
 
-  {
+  if (mPlayback) {
+    renderPlayback();
+  } else {
     ImGui::Begin("INFO");
     ImGui::Text("Application average %.3f ms/frame (%.1f FPS)",
                 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
     ImGui::Text("Entities count: %i", mWorld->GetEntitiesCount());
+    const RenderStats &renderStats = mRenderSystem.getStats();
+    ImGui::Text("Drawn %zu, culled %zu, %zu draw calls", renderStats.drawn,
+                renderStats.culled, renderStats.drawCalls);
+
+    float stepRate = mWorld->GetStepRate();
+    if (ImGui::SliderFloat("Physics rate (Hz)", &stepRate, 10.0f, 240.0f)) {
+      mWorld->SetStepRate(stepRate);
+    }
+    int maxSubsteps = mWorld->GetMaxSubsteps();
+    if (ImGui::SliderInt("Max substeps", &maxSubsteps, 1, 16)) {
+      mWorld->SetMaxSubsteps(maxSubsteps);
+    }
+    ImGui::Text("Physics steps this frame: %i", mWorld->GetStepsLastUpdate());
+
+    PhysicsSystem *physics = mWorld->GetPhysicsSystem();
+    PhysicsAssetStats assets = physics->GetAssetCache().getStats();
+    ImGui::Text("Materials %zu, shapes %zu (%zu attachments), PhysX %.2f MB",
+                assets.materials, assets.shapes, assets.shapeReferences,
+                physics->getAllocatedBytes() / (1024.0 * 1024.0));
+
+    ImGui::Separator();
+    ImGui::Combo("Layout", &mSpawnLayout, sSpawnLayouts,
+                 IM_ARRAYSIZE(sSpawnLayouts));
+    ImGui::InputInt("Count", &mSpawnCount, 100, 10000);
+    if (ImGui::Button("Spawn")) {
+      mSpawnRequested = true;
+    }
+    ImGui::SameLine();
+    ImGui::Text("last spawn %.2f ms", mLastSpawnMs);
+    if (ImGui::Button("Despawn all")) {
+      // Destruction is deferred by the world, safe while a step is running
+      for (Entity entity :
+           mWorld->GetRegistry().pool<PhysicsComponent>().entities()) {
+        mWorld->DestroyEntity(entity);
+      }
+    }
+    ImGui::SameLine();
+    ImGui::Text("%zu actors pooled",
+                mWorld->GetPhysicsSystem()->getPooledActorCount());
+    if (ImGui::Button("Save snapshot")) {
+      mSaveRequested = true;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Load snapshot")) {
+      mLoadRequested = true;
+    }
+    if (!mSnapshotStatus.empty()) {
+      ImGui::SameLine();
+      ImGui::TextUnformatted(mSnapshotStatus.c_str());
+    }
+    if (ImGui::Button(mWorld->IsRecording() ? "Stop recording" : "Record")) {
+      mRecordToggleRequested = true;
+    }
+    ImGui::SameLine();
+    if (mWorld->IsRecording()) {
+      RecordingStats recording = mWorld->GetRecordingStats();
+      ImGui::Text("%llu frames, %.2f MB, %.2f bytes/body/frame",
+                  (unsigned long long)recording.frames,
+                  recording.storedBytes / (1024.0 * 1024.0),
+                  recording.bytesPerBodyFrame());
+    } else {
+      ImGui::TextUnformatted(mRecordingStatus.c_str());
+    }
+
+    ImGui::Separator();
+    ImGui::Checkbox("Physics debug", &mDebugVisualization);
+    ImGui::SameLine();
+    ImGui::Text("%zu lines (%zu dropped), %s",
+                mDebugRenderer->getVertexCount() / 2,
+                mDebugRenderer->getDroppedVertexCount() / 2,
+                mDebugRenderer->isPersistentlyMapped() ? "persistent map"
+                                                       : "buffer upload");
+
+    const SimulationOverlapStats &overlap =
+        mWorld->GetPhysicsSystem()->getOverlapStats();
+    ImGui::Text("Simulate %.3f ms, hidden %.3f ms (%.0f%%), blocked %.3f ms",
+                overlap.simulateMs, overlap.hiddenMs,
+                overlap.hiddenFraction() * 100.0f, overlap.blockedMs);
     ImGui::End();
   }
+  renderProfiler();
   ImGui::Render();
+  mGpuTimer->begin("ImGui");
   ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+  mGpuTimer->end();
+}
+
+void Application::renderPlayback() {
+  ImGui::Begin("PLAYBACK");
+  ImGui::Text("Application average %.3f ms/frame (%.1f FPS)",
+              1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+  ImGui::Text("Entities count: %i", mPlayback->GetEntitiesCount());
+  const RenderStats &renderStats = mRenderSystem.getStats();
+  ImGui::Text("Drawn %zu, culled %zu, %zu draw calls", renderStats.drawn,
+              renderStats.culled, renderStats.drawCalls);
+
+  ImGui::Separator();
+  size_t frameCount = mPlayback->GetFrameCount();
+  int frame = static_cast<int>(mPlayback->GetFrame());
+  int lastFrame = frameCount > 0 ? static_cast<int>(frameCount) - 1 : 0;
+  if (ImGui::SliderInt("Frame", &frame, 0, lastFrame)) {
+    mPlayback->Seek(frame);
+  }
+  if (ImGui::Button(mPlaybackPaused ? "Play" : "Pause")) {
+    mPlaybackPaused = !mPlaybackPaused;
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Restart")) {
+    mPlayback->Seek(0);
+  }
+  ImGui::SliderFloat("Speed", &mPlaybackSpeed, 0.1f, 4.0f);
+  ImGui::Text("%.2f s of %.2f s at %.0f Hz",
+              mPlayback->GetFrame() * mPlayback->GetStepSeconds(),
+              lastFrame * mPlayback->GetStepSeconds(),
+              1.0f / mPlayback->GetStepSeconds());
+
+  RecordingStats stats = mPlayback->GetStats();
+  ImGui::Text("%.2f MB in %llu chunks, %.2f bytes/body/frame (%.2f raw)",
+              stats.storedBytes / (1024.0 * 1024.0),
+              (unsigned long long)stats.chunks, stats.bytesPerBodyFrame(),
+              stats.rawBytesPerBodyFrame());
+  ImGui::End();
+}
+
+// Stable color per scope name
+static ImU32 scopeColor(const char *name) {
+  uint32_t hash = 2166136261u;
+  for (const char *c = name; *c; c++) {
+    hash = (hash ^ static_cast<unsigned char>(*c)) * 16777619u;
+  }
+  return ImColor::HSV((hash % 360) / 360.0f, 0.5f, 0.75f);
+}
+
+void Application::renderProfiler() {
+  Profiler &profiler = Profiler::get();
+  ImGui::Begin("PROFILER");
+
+  bool recording = profiler.isEnabled();
+  if (ImGui::Checkbox("Record", &recording)) {
+    profiler.setEnabled(recording);
+  }
+  ImGui::SameLine();
+  ImGui::Checkbox("Freeze", &mProfilerFrozen);
+  ImGui::SameLine();
+  if (ImGui::Button("Export trace")) {
+    mTraceStatus = profiler.exportChromeTrace("ember_trace.json")
+                       ? "wrote ember_trace.json"
+                       : "failed to write ember_trace.json";
+  }
+  if (!mTraceStatus.empty()) {
+    ImGui::SameLine();
+    ImGui::TextUnformatted(mTraceStatus.c_str());
+  }
+
+  if (!mProfilerFrozen &&
+      profiler.lastFrame(mProfiledFrameStart, mProfiledFrameEnd)) {
+    mProfiledTracks = profiler.collect(mProfiledFrameStart, mProfiledFrameEnd);
+  }
+  int64_t frameNs =
+      std::max<int64_t>(mProfiledFrameEnd - mProfiledFrameStart, 1);
+  ImGui::Text("Frame %.3f ms", frameNs * 1e-6f);
+
+  // One lane per thread, nested scopes stacked below their parents
+  ImDrawList *drawList = ImGui::GetWindowDrawList();
+  const float labelWidth = 150.0f;
+  const float rowHeight = ImGui::GetTextLineHeight() + 2.0f;
+  float width =
+      std::max(ImGui::GetContentRegionAvail().x - labelWidth, 50.0f);
+  float scale = width / frameNs;
+  for (const ProfileTrack &track : mProfiledTracks) {
+    uint32_t maxDepth = 0;
+    for (const ProfileEvent &event : track.events) {
+      maxDepth = std::max(maxDepth, event.depth);
+    }
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    drawList->AddText(origin, IM_COL32(200, 200, 200, 255),
+                      track.name.c_str());
+
+    for (const ProfileEvent &event : track.events) {
+      int64_t startNs = std::max(event.startNs, mProfiledFrameStart);
+      int64_t endNs = std::min(event.endNs, mProfiledFrameEnd);
+      float left = origin.x + labelWidth;
+      ImVec2 min(left + (startNs - mProfiledFrameStart) * scale,
+                 origin.y + event.depth * rowHeight);
+      ImVec2 max(left + (endNs - mProfiledFrameStart) * scale,
+                 min.y + rowHeight - 1.0f);
+      max.x = std::max(max.x, min.x + 1.0f);
+
+      drawList->AddRectFilled(min, max, scopeColor(event.name));
+      drawList->PushClipRect(min, max, true);
+      drawList->AddText(ImVec2(min.x + 2.0f, min.y + 1.0f),
+                        IM_COL32(0, 0, 0, 255), event.name);
+      drawList->PopClipRect();
+      if (ImGui::IsMouseHoveringRect(min, max)) {
+        ImGui::SetTooltip("%s\n%.3f ms", event.name,
+                          (event.endNs - event.startNs) * 1e-6f);
+      }
+    }
+    ImGui::Dummy(ImVec2(labelWidth + width, (maxDepth + 1) * rowHeight));
+  }
+
+  ImGui::Separator();
+  ImGui::Text("GPU (%zu frames dropped)", mGpuTimer->getDroppedFrames());
+  for (const GpuTimer::PassTime &pass : mGpuTimer->getResults()) {
+    ImGui::SameLine();
+    ImGui::Text("%s %.3f ms", pass.name, pass.ms);
+  }
+
+  if (!mWorld) {
+    ImGui::End();
+    return;
+  }
+  const PxSimulationStatistics &stats =
+      mWorld->GetPhysicsSystem()->getSimulationStatistics();
+  ImGui::Text("PhysX bodies: %u active of %u dynamic, %u static",
+              stats.nbActiveDynamicBodies, stats.nbDynamicBodies,
+              stats.nbStaticBodies);
+  ImGui::Text("Pairs: %u (%u touching), %u new, %u lost",
+              stats.nbDiscreteContactPairsTotal,
+              stats.nbDiscreteContactPairsWithContacts, stats.nbNewPairs,
+              stats.nbLostPairs);
+  ImGui::Text("Constraints: %u, contact memory %u KB",
+              stats.nbActiveConstraints, stats.compressedContactSize / 1024);
+  ImGui::End();
 }
 
 void Application::processInput() {
   if (glfwGetKey(mWindow.get(), GLFW_KEY_ESCAPE) == GLFW_PRESS ||
       glfwGetKey(mWindow.get(), GLFW_KEY_Q) == GLFW_PRESS)
     glfwSetWindowShouldClose(mWindow.get(), true);
+  if (!mWorld) {
+    return;
+  }
   if (glfwGetKey(mWindow.get(), GLFW_KEY_A) == GLFW_PRESS) {
-    Entity cubeEntity4(
+    mWorld->AddEntity(
         mCubeMesh, glm::vec3(2.0f, 2.0f, 5.0f),
         glm::angleAxis(glm::radians(40.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-        mWorld->GetPhysicsSystem()->GetPhysics(),
-        mWorld->GetPhysicsSystem()->GetScene(), 5.0f);
-    mWorld->AddEntity(cubeEntity4);
+        5.0f);
+  }
+
+  if (mDebugVisualization != mWorld->GetDebugVisualization()) {
+    mWorld->SetDebugVisualization(mDebugVisualization);
+  }
+
+  if (mSpawnRequested) {
+    mSpawnRequested = false;
+    std::vector<SpawnDesc> spawns;
+    if (GenerateLayout(sSpawnLayouts[mSpawnLayout], mSpawnCount, spawns)) {
+      auto start = std::chrono::steady_clock::now();
+      mWorld->SpawnBatch(spawns, mCubeMesh);
+      mLastSpawnMs = std::chrono::duration<float, std::milli>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    }
+  }
+
+  if (mSaveRequested || mLoadRequested) {
+    const char *path = "world.snapshot";
+    auto start = std::chrono::steady_clock::now();
+    try {
+      if (mSaveRequested) {
+        mWorld->SaveSnapshot(path);
+      } else {
+        // Replaces the scene, the old entities are gone before the load
+        for (Entity entity :
+             mWorld->GetRegistry().pool<PhysicsComponent>().entities()) {
+          mWorld->DestroyEntity(entity);
+        }
+        mWorld->LoadSnapshot(path, mCubeMesh);
+      }
+      char status[64];
+      std::snprintf(status, sizeof(status), "%s in %.2f ms",
+                    mSaveRequested ? "saved" : "loaded",
+                    std::chrono::duration<float, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count());
+      mSnapshotStatus = status;
+    } catch (const std::exception &error) {
+      mSnapshotStatus = error.what();
+    }
+    mSaveRequested = false;
+    mLoadRequested = false;
+  }
+
+  if (mRecordToggleRequested) {
+    mRecordToggleRequested = false;
+    const char *path = "ember.rec";
+    try {
+      if (mWorld->IsRecording()) {
+        RecordingStats stats = mWorld->StopRecording();
+        char status[96];
+        std::snprintf(status, sizeof(status),
+                      "wrote %s, %.2f bytes/body/frame", path,
+                      stats.bytesPerBodyFrame());
+        mRecordingStatus = status;
+      } else {
+        mWorld->StartRecording(path);
+      }
+    } catch (const std::exception &error) {
+      mRecordingStatus = error.what();
+    }
   }
 }
 
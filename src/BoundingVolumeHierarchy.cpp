@@ -0,0 +1,225 @@
+#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+
+int32_t BoundingVolumeHierarchy::insert(const AABB &box, uint32_t userData) {
+  int32_t leaf = allocateNode();
+  mNodes[leaf].box = Inflate(box, mMargin);
+  mNodes[leaf].userData = userData;
+  insertLeaf(leaf);
+  mLeafCount++;
+  return leaf;
+}
+
+void BoundingVolumeHierarchy::remove(int32_t leaf) {
+  removeLeaf(leaf);
+  freeNode(leaf);
+  mLeafCount--;
+}
+
+bool BoundingVolumeHierarchy::update(int32_t leaf, const AABB &box) {
+  if (mNodes[leaf].box.contains(box)) {
+    return false;
+  }
+  removeLeaf(leaf);
+  mNodes[leaf].box = Inflate(box, mMargin);
+  insertLeaf(leaf);
+  return true;
+}
+
+int32_t BoundingVolumeHierarchy::allocateNode() {
+  int32_t index;
+  if (mFreeList != Null) {
+    index = mFreeList;
+    mFreeList = mNodes[index].next;
+  } else {
+    index = static_cast<int32_t>(mNodes.size());
+    mNodes.emplace_back();
+  }
+  mNodes[index] = Node();
+  return index;
+}
+
+void BoundingVolumeHierarchy::freeNode(int32_t index) {
+  mNodes[index].next = mFreeList;
+  mNodes[index].height = -1;
+  mFreeList = index;
+}
+
+void BoundingVolumeHierarchy::replaceChild(int32_t parent, int32_t oldChild,
+                                           int32_t newChild) {
+  if (parent == Null) {
+    mRoot = newChild;
+  } else if (mNodes[parent].child1 == oldChild) {
+    mNodes[parent].child1 = newChild;
+  } else {
+    mNodes[parent].child2 = newChild;
+  }
+}
+
+void BoundingVolumeHierarchy::insertLeaf(int32_t leaf) {
+  if (mRoot == Null) {
+    mRoot = leaf;
+    mNodes[leaf].parent = Null;
+    return;
+  }
+
+  // Walk down to the cheapest sibling. Descending into a child costs the
+  // growth of every box on the way, stopping here costs a new parent.
+  AABB leafBox = mNodes[leaf].box;
+  int32_t index = mRoot;
+  while (!mNodes[index].isLeaf()) {
+    const Node &node = mNodes[index];
+    float area = node.box.halfArea();
+    float combinedArea = Merge(node.box, leafBox).halfArea();
+    float cost = 2.0f * combinedArea;
+    float inheritance = 2.0f * (combinedArea - area);
+
+    auto descendCost = [&](int32_t child) {
+      const Node &childNode = mNodes[child];
+      float mergedArea = Merge(childNode.box, leafBox).halfArea();
+      if (childNode.isLeaf()) {
+        return mergedArea + inheritance;
+      }
+      return mergedArea - childNode.box.halfArea() + inheritance;
+    };
+    float cost1 = descendCost(node.child1);
+    float cost2 = descendCost(node.child2);
+
+    if (cost < cost1 && cost < cost2) {
+      break;
+    }
+    index = cost1 < cost2 ? node.child1 : node.child2;
+  }
+
+  int32_t sibling = index;
+  int32_t oldParent = mNodes[sibling].parent;
+  int32_t newParent = allocateNode();
+  mNodes[newParent].parent = oldParent;
+  mNodes[newParent].box = Merge(leafBox, mNodes[sibling].box);
+  mNodes[newParent].height = mNodes[sibling].height + 1;
+  mNodes[newParent].child1 = sibling;
+  mNodes[newParent].child2 = leaf;
+  replaceChild(oldParent, sibling, newParent);
+  mNodes[sibling].parent = newParent;
+  mNodes[leaf].parent = newParent;
+
+  // Refit the ancestors
+  index = mNodes[leaf].parent;
+  while (index != Null) {
+    index = balance(index);
+    Node &node = mNodes[index];
+    node.height =
+        1 + std::max(mNodes[node.child1].height, mNodes[node.child2].height);
+    node.box = Merge(mNodes[node.child1].box, mNodes[node.child2].box);
+    index = node.parent;
+  }
+}
+
+void BoundingVolumeHierarchy::removeLeaf(int32_t leaf) {
+  if (leaf == mRoot) {
+    mRoot = Null;
+    return;
+  }
+
+  int32_t parent = mNodes[leaf].parent;
+  int32_t grandParent = mNodes[parent].parent;
+  int32_t sibling = mNodes[parent].child1 == leaf ? mNodes[parent].child2
+                                                  : mNodes[parent].child1;
+
+  // The sibling takes the place of the parent
+  replaceChild(grandParent, parent, sibling);
+  mNodes[sibling].parent = grandParent;
+  freeNode(parent);
+
+  int32_t index = grandParent;
+  while (index != Null) {
+    index = balance(index);
+    Node &node = mNodes[index];
+    node.height =
+        1 + std::max(mNodes[node.child1].height, mNodes[node.child2].height);
+    node.box = Merge(mNodes[node.child1].box, mNodes[node.child2].box);
+    index = node.parent;
+  }
+}
+
+// If one subtree of a is more than one level taller than the other, rotates
+// the taller child up into a's place. Returns the new root of the subtree.
+int32_t BoundingVolumeHierarchy::balance(int32_t iA) {
+  Node &a = mNodes[iA];
+  if (a.isLeaf() || a.height < 2) {
+    return iA;
+  }
+
+  int32_t iB = a.child1;
+  int32_t iC = a.child2;
+  Node &b = mNodes[iB];
+  Node &c = mNodes[iC];
+  int32_t difference = c.height - b.height;
+
+  if (difference > 1) {
+    // Rotate c up
+    int32_t iF = c.child1;
+    int32_t iG = c.child2;
+    Node &f = mNodes[iF];
+    Node &g = mNodes[iG];
+
+    c.child1 = iA;
+    c.parent = a.parent;
+    a.parent = iC;
+    replaceChild(c.parent, iA, iC);
+
+    if (f.height > g.height) {
+      c.child2 = iF;
+      a.child2 = iG;
+      g.parent = iA;
+      a.box = Merge(b.box, g.box);
+      c.box = Merge(a.box, f.box);
+      a.height = 1 + std::max(b.height, g.height);
+      c.height = 1 + std::max(a.height, f.height);
+    } else {
+      c.child2 = iG;
+      a.child2 = iF;
+      f.parent = iA;
+      a.box = Merge(b.box, f.box);
+      c.box = Merge(a.box, g.box);
+      a.height = 1 + std::max(b.height, f.height);
+      c.height = 1 + std::max(a.height, g.height);
+    }
+    return iC;
+  }
+
+  if (difference < -1) {
+    // Rotate b up
+    int32_t iD = b.child1;
+    int32_t iE = b.child2;
+    Node &d = mNodes[iD];
+    Node &e = mNodes[iE];
+
+    b.child1 = iA;
+    b.parent = a.parent;
+    a.parent = iB;
+    replaceChild(b.parent, iA, iB);
+
+    if (d.height > e.height) {
+      b.child2 = iD;
+      a.child1 = iE;
+      e.parent = iA;
+      a.box = Merge(c.box, e.box);
+      b.box = Merge(a.box, d.box);
+      a.height = 1 + std::max(c.height, e.height);
+      b.height = 1 + std::max(a.height, d.height);
+    } else {
+      b.child2 = iE;
+      a.child1 = iD;
+      d.parent = iA;
+      a.box = Merge(c.box, d.box);
+      b.box = Merge(a.box, e.box);
+      a.height = 1 + std::max(c.height, d.height);
+      b.height = 1 + std::max(a.height, e.height);
+    }
+    return iB;
+  }
+
+  return iA;
+}
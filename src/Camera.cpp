@@ -7,6 +7,14 @@ Camera::Camera(int width, int height, glm::vec3 position) {
   mFront = glm::vec3(-1, -0.5, -1);
   mUp = glm::vec3(0, 1, 0);
   mAspectRatio = (float)mResolution.x / (float)mResolution.y;
+
+  // Matches the std140 layout of CameraBlock: mat4 camMatrix, vec4 camPos
+  glGenBuffers(1, &mUBO);
+  glBindBuffer(GL_UNIFORM_BUFFER, mUBO);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::mat4) + sizeof(glm::vec4),
+               nullptr, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glBindBufferBase(GL_UNIFORM_BUFFER, CameraBlockBinding, mUBO);
 }
 
 void Camera::updateMatrix() {
@@ -23,8 +31,14 @@ void Camera::updateMatrix() {
   mMatrix = projection * view;
 }
 
-void Camera::Matrix(Shader &shader, const char *uniform) {
-  shader.setMat4(uniform, mMatrix);
+void Camera::UploadUniforms() {
+  glm::vec4 position(mPosition, 1.0f);
+  glBindBuffer(GL_UNIFORM_BUFFER, mUBO);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4),
+                  glm::value_ptr(mMatrix));
+  glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::vec4),
+                  glm::value_ptr(position));
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 void Camera::Inputs(GLFWwindow *window, float ts) {
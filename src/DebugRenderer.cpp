@@ -0,0 +1,121 @@
+#include "DebugRenderer.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+DebugRenderer::DebugRenderer(size_t maxVertices) : mMaxVertices(maxVertices) {
+  glGenVertexArrays(1, &mVAO);
+  glGenBuffers(1, &mBuffer);
+  glBindVertexArray(mVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, mBuffer);
+
+  if (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage) {
+    GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLsizeiptr size = RegionCount * mMaxVertices * sizeof(DebugVertex);
+    glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+    mMapped = static_cast<DebugVertex *>(
+        glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+    if (!mMapped) {
+      // Immutable storage cannot be respecified, start over with a buffer
+      // for the upload path
+      glDeleteBuffers(1, &mBuffer);
+      glGenBuffers(1, &mBuffer);
+      glBindBuffer(GL_ARRAY_BUFFER, mBuffer);
+    }
+  }
+
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(DebugVertex),
+                        (void *)offsetof(DebugVertex, x));
+  glEnableVertexAttribArray(0);
+  // GL_BGRA reads the little endian 0xAARRGGBB bytes as r, g, b, a
+  glVertexAttribPointer(1, GL_BGRA, GL_UNSIGNED_BYTE, GL_TRUE,
+                        sizeof(DebugVertex),
+                        (void *)offsetof(DebugVertex, color));
+  glEnableVertexAttribArray(1);
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+DebugRenderer::~DebugRenderer() {
+  for (GLsync fence : mFences) {
+    if (fence) {
+      glDeleteSync(fence);
+    }
+  }
+  if (mMapped) {
+    glBindBuffer(GL_ARRAY_BUFFER, mBuffer);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+  glDeleteBuffers(1, &mBuffer);
+  glDeleteVertexArrays(1, &mVAO);
+}
+
+void DebugRenderer::waitForRegion(int region) {
+  GLsync &fence = mFences[region];
+  if (!fence) {
+    return;
+  }
+  // Normally signalled long ago, the region was drawn two frames back
+  GLenum result = glClientWaitSync(fence, 0, 0);
+  while (result == GL_TIMEOUT_EXPIRED) {
+    result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+  }
+  glDeleteSync(fence);
+  fence = nullptr;
+}
+
+void DebugRenderer::draw(Shader &shader,
+                         std::initializer_list<const DebugDraw *> lists) {
+  size_t total = 0;
+  for (const DebugDraw *list : lists) {
+    total += list->vertices().size();
+  }
+  // Keep whole lines
+  mVertexCount = std::min(total, mMaxVertices) & ~size_t(1);
+  mDroppedVertexCount = total - mVertexCount;
+  if (mVertexCount == 0) {
+    return;
+  }
+
+  GLint first = 0;
+  glBindBuffer(GL_ARRAY_BUFFER, mBuffer);
+  if (mMapped) {
+    waitForRegion(mRegion);
+    first = static_cast<GLint>(mRegion * mMaxVertices);
+  } else {
+    glBufferData(GL_ARRAY_BUFFER, mMaxVertices * sizeof(DebugVertex), nullptr,
+                 GL_STREAM_DRAW);
+  }
+
+  size_t written = 0;
+  for (const DebugDraw *list : lists) {
+    size_t count =
+        std::min(list->vertices().size(), mVertexCount - written);
+    if (count == 0) {
+      continue;
+    }
+    if (mMapped) {
+      std::memcpy(mMapped + first + written, list->vertices().data(),
+                  count * sizeof(DebugVertex));
+    } else {
+      glBufferSubData(GL_ARRAY_BUFFER, written * sizeof(DebugVertex),
+                      count * sizeof(DebugVertex), list->vertices().data());
+    }
+    written += count;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  shader.Activate();
+  glBindVertexArray(mVAO);
+  glDrawArrays(GL_LINES, first, static_cast<GLsizei>(mVertexCount));
+  glBindVertexArray(0);
+
+  if (mMapped) {
+    mFences[mRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    mRegion = (mRegion + 1) % RegionCount;
+  }
+}
@@ -0,0 +1,219 @@
+#include "GeometryPool.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// Creating an EBO binds it, which must not land in whatever VAO is bound
+EBO CreateIndexBuffer(size_t indexCapacity) {
+  glBindVertexArray(0);
+  EBO indexBuffer(indexCapacity * sizeof(uint16_t), nullptr);
+  indexBuffer.Unbind();
+  return indexBuffer;
+}
+
+} // namespace
+
+GeometryPool::GeometryPool(VertexFormat format, size_t vertexCapacity,
+                           size_t indexCapacity)
+    : mFormat(format), mVertexStride(VertexStride(format)),
+      mVertexBuffer(vertexCapacity * mVertexStride, nullptr, GL_STATIC_DRAW),
+      mIndexBuffer(CreateIndexBuffer(indexCapacity)),
+      mInstanceBuffer(0, nullptr, GL_STREAM_DRAW), mVertices(vertexCapacity),
+      mIndices(indexCapacity) {
+  glGenBuffers(1, &mIndirectBuffer);
+  linkVertexArray();
+}
+
+GeometryPool::~GeometryPool() {
+  glDeleteBuffers(1, &mIndirectBuffer);
+  mInstanceBuffer.Delete();
+  mIndexBuffer.Delete();
+  mVertexBuffer.Delete();
+  mVAO.Delete();
+}
+
+void GeometryPool::linkVertexArray() {
+  mVAO.Bind();
+  mVAO.LinkLayout(mVertexBuffer, GetVertexLayout(mFormat));
+  mIndexBuffer.Bind();
+  // Per-instance model matrix, see shaders/vert.glsl
+  mVAO.LinkInstanceMat4(mInstanceBuffer, 3);
+  mVAO.Unbind();
+  mIndexBuffer.Unbind();
+}
+
+GeometryPool::MeshId GeometryPool::add(const void *vertexData,
+                                       size_t vertexCount,
+                                       const uint16_t *indices,
+                                       size_t indexCount) {
+  if (vertexCount == 0 || indexCount == 0) {
+    throw std::runtime_error("GeometryPool: empty mesh");
+  }
+  if (vertexCount > 0x10000) {
+    throw std::runtime_error("GeometryPool: mesh exceeds 16 bit indices");
+  }
+
+  size_t vertexOffset = mVertices.allocate(vertexCount);
+  size_t indexOffset = mIndices.allocate(indexCount);
+  if (vertexOffset == RangeAllocator::Invalid ||
+      indexOffset == RangeAllocator::Invalid) {
+    if (vertexOffset != RangeAllocator::Invalid) {
+      mVertices.free(vertexOffset, vertexCount);
+    }
+    if (indexOffset != RangeAllocator::Invalid) {
+      mIndices.free(indexOffset, indexCount);
+    }
+
+    // Compacting is enough when the holes add up, otherwise grow as well
+    size_t vertexCapacity = std::max<size_t>(mVertices.capacity(), 1);
+    while (mVertices.used() + vertexCount > vertexCapacity) {
+      vertexCapacity *= 2;
+    }
+    size_t indexCapacity = std::max<size_t>(mIndices.capacity(), 1);
+    while (mIndices.used() + indexCount > indexCapacity) {
+      indexCapacity *= 2;
+    }
+    relocate(vertexCapacity, indexCapacity);
+    vertexOffset = mVertices.allocate(vertexCount);
+    indexOffset = mIndices.allocate(indexCount);
+  }
+
+  // The copy targets leave the element buffer binding of any VAO alone
+  glBindBuffer(GL_COPY_WRITE_BUFFER, mVertexBuffer.ID);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, vertexOffset * mVertexStride,
+                  vertexCount * mVertexStride, vertexData);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, mIndexBuffer.ID);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset * sizeof(uint16_t),
+                  indexCount * sizeof(uint16_t), indices);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  MeshId id;
+  if (!mFreeIds.empty()) {
+    id = mFreeIds.back();
+    mFreeIds.pop_back();
+  } else {
+    id = static_cast<MeshId>(mAllocations.size());
+    mAllocations.emplace_back();
+  }
+  Allocation &allocation = mAllocations[id];
+  allocation.vertexOffset = vertexOffset;
+  allocation.vertexCount = vertexCount;
+  allocation.indexOffset = indexOffset;
+  allocation.indexCount = indexCount;
+  allocation.live = true;
+  mMeshCount++;
+  return id;
+}
+
+void GeometryPool::remove(MeshId id) {
+  if (id >= mAllocations.size() || !mAllocations[id].live) {
+    return;
+  }
+  Allocation &allocation = mAllocations[id];
+  mVertices.free(allocation.vertexOffset, allocation.vertexCount);
+  mIndices.free(allocation.indexOffset, allocation.indexCount);
+  allocation.live = false;
+  mFreeIds.push_back(id);
+  mMeshCount--;
+}
+
+DrawElementsIndirectCommand GeometryPool::command(MeshId id,
+                                                  GLuint instanceCount,
+                                                  GLuint baseInstance) const {
+  const Allocation &allocation = mAllocations[id];
+  DrawElementsIndirectCommand command;
+  command.count = static_cast<GLuint>(allocation.indexCount);
+  command.instanceCount = instanceCount;
+  command.firstIndex = static_cast<GLuint>(allocation.indexOffset);
+  command.baseVertex = static_cast<GLint>(allocation.vertexOffset);
+  command.baseInstance = baseInstance;
+  return command;
+}
+
+void GeometryPool::draw(GLenum mode, const DrawElementsIndirectCommand *commands,
+                        size_t commandCount, const glm::mat4 *models,
+                        size_t modelCount) {
+  if (commandCount == 0 || modelCount == 0) {
+    return;
+  }
+
+  // Both streams are rewritten every frame, orphan them like
+  // Mesh::DrawInstanced does
+  GLsizeiptr modelSize = modelCount * sizeof(glm::mat4);
+  if (modelSize > mInstanceCapacity) {
+    mInstanceCapacity = std::max(modelSize, mInstanceCapacity * 2);
+  }
+  mInstanceBuffer.Upload(mInstanceCapacity, nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, modelSize, models);
+  mInstanceBuffer.Unbind();
+
+  GLsizeiptr commandSize = commandCount * sizeof(DrawElementsIndirectCommand);
+  if (commandSize > mIndirectCapacity) {
+    mIndirectCapacity = std::max(commandSize, mIndirectCapacity * 2);
+  }
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mIndirectBuffer);
+  glBufferData(GL_DRAW_INDIRECT_BUFFER, mIndirectCapacity, nullptr,
+               GL_STREAM_DRAW);
+  glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commandSize, commands);
+
+  mVAO.Bind();
+  glMultiDrawElementsIndirect(mode, GL_UNSIGNED_SHORT, nullptr,
+                              static_cast<GLsizei>(commandCount),
+                              sizeof(DrawElementsIndirectCommand));
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void GeometryPool::defragment() {
+  relocate(mVertices.capacity(), mIndices.capacity());
+}
+
+void GeometryPool::relocate(size_t vertexCapacity, size_t indexCapacity) {
+  VBO vertexBuffer(vertexCapacity * mVertexStride, nullptr, GL_STATIC_DRAW);
+  EBO indexBuffer = CreateIndexBuffer(indexCapacity);
+
+  // Keep the current order, meshes loaded together stay together
+  std::vector<MeshId> order;
+  order.reserve(mMeshCount);
+  for (MeshId id = 0; id < mAllocations.size(); id++) {
+    if (mAllocations[id].live) {
+      order.push_back(id);
+    }
+  }
+  std::sort(order.begin(), order.end(), [&](MeshId a, MeshId b) {
+    return mAllocations[a].vertexOffset < mAllocations[b].vertexOffset;
+  });
+
+  size_t vertexEnd = 0;
+  size_t indexEnd = 0;
+  for (MeshId id : order) {
+    Allocation &allocation = mAllocations[id];
+    glBindBuffer(GL_COPY_READ_BUFFER, mVertexBuffer.ID);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer.ID);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                        allocation.vertexOffset * mVertexStride,
+                        vertexEnd * mVertexStride,
+                        allocation.vertexCount * mVertexStride);
+    glBindBuffer(GL_COPY_READ_BUFFER, mIndexBuffer.ID);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer.ID);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                        allocation.indexOffset * sizeof(uint16_t),
+                        indexEnd * sizeof(uint16_t),
+                        allocation.indexCount * sizeof(uint16_t));
+    allocation.vertexOffset = vertexEnd;
+    allocation.indexOffset = indexEnd;
+    vertexEnd += allocation.vertexCount;
+    indexEnd += allocation.indexCount;
+  }
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  mVertexBuffer.Delete();
+  mIndexBuffer.Delete();
+  mVertexBuffer = vertexBuffer;
+  mIndexBuffer = indexBuffer;
+  mVertices.reset(vertexCapacity, vertexEnd);
+  mIndices.reset(indexCapacity, indexEnd);
+  linkVertexArray();
+}
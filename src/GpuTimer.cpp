@@ -0,0 +1,72 @@
+#include "GpuTimer.h"
+
+#include "Profiler.h"
+
+GpuTimer::GpuTimer() : mTrack(Profiler::get().createTrack("GPU")) {}
+
+GpuTimer::~GpuTimer() {
+  for (Frame &frame : mFrames) {
+    if (!frame.queries.empty()) {
+      glDeleteQueries(static_cast<GLsizei>(frame.queries.size()),
+                      frame.queries.data());
+    }
+  }
+}
+
+void GpuTimer::begin(const char *name) {
+  if (mActive) {
+    end();
+  }
+  Frame &frame = mFrames[mCurrent];
+  size_t index = frame.passes.size();
+  if (index == frame.queries.size()) {
+    GLuint query = 0;
+    glGenQueries(1, &query);
+    frame.queries.push_back(query);
+  }
+  GLuint query = frame.queries[index];
+  frame.passes.push_back({name, query, Profiler::nowNs()});
+  glBeginQuery(GL_TIME_ELAPSED, query);
+  mActive = true;
+}
+
+void GpuTimer::end() {
+  if (!mActive) {
+    return;
+  }
+  glEndQuery(GL_TIME_ELAPSED);
+  mActive = false;
+}
+
+void GpuTimer::endFrame() {
+  end();
+  mCurrent = (mCurrent + 1) % FramesInFlight;
+  collect(mFrames[mCurrent]);
+}
+
+void GpuTimer::collect(Frame &frame) {
+  if (frame.passes.empty()) {
+    return;
+  }
+
+  // Queries finish in order, the last one being ready means all are
+  GLuint available = GL_FALSE;
+  glGetQueryObjectuiv(frame.passes.back().query, GL_QUERY_RESULT_AVAILABLE,
+                      &available);
+  if (available == GL_FALSE) {
+    mDroppedFrames++;
+    frame.passes.clear();
+    return;
+  }
+
+  mResults.clear();
+  for (const Pass &pass : frame.passes) {
+    GLuint64 elapsedNs = 0;
+    glGetQueryObjectui64v(pass.query, GL_QUERY_RESULT, &elapsedNs);
+    mResults.push_back({pass.name, elapsedNs * 1e-6f});
+    Profiler::get().recordOn(mTrack, pass.name, pass.cpuStartNs,
+                             pass.cpuStartNs +
+                                 static_cast<int64_t>(elapsedNs));
+  }
+  frame.passes.clear();
+}
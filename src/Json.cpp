@@ -0,0 +1,284 @@
+#include "Json.h"
+
+#include <cstdlib>
+#include <stdexcept>
+
+class JsonParser {
+public:
+  explicit JsonParser(const std::string &text) : mText(text) {}
+
+  JsonValue parseDocument() {
+    JsonValue value = parseValue(0);
+    skipWhitespace();
+    if (mPos != mText.size()) {
+      fail("trailing characters");
+    }
+    return value;
+  }
+
+private:
+  // Deep enough for any real glTF, keeps hostile input off the stack limit
+  static constexpr int MaxDepth = 128;
+
+  [[noreturn]] void fail(const char *what) const {
+    throw std::runtime_error("JSON: " + std::string(what) + " at offset " +
+                             std::to_string(mPos));
+  }
+
+  void skipWhitespace() {
+    while (mPos < mText.size() &&
+           (mText[mPos] == ' ' || mText[mPos] == '\t' || mText[mPos] == '\n' ||
+            mText[mPos] == '\r')) {
+      mPos++;
+    }
+  }
+
+  char peek() {
+    skipWhitespace();
+    if (mPos >= mText.size()) {
+      fail("unexpected end");
+    }
+    return mText[mPos];
+  }
+
+  void expect(char c) {
+    if (peek() != c) {
+      fail("unexpected character");
+    }
+    mPos++;
+  }
+
+  bool consumeLiteral(const char *literal) {
+    size_t length = std::char_traits<char>::length(literal);
+    if (mText.compare(mPos, length, literal) != 0) {
+      return false;
+    }
+    mPos += length;
+    return true;
+  }
+
+  JsonValue parseValue(int depth) {
+    if (depth > MaxDepth) {
+      fail("nested too deep");
+    }
+
+    JsonValue value;
+    char c = peek();
+    if (c == '{') {
+      mPos++;
+      value.mType = JsonValue::Type::Object;
+      if (peek() == '}') {
+        mPos++;
+        return value;
+      }
+      while (true) {
+        if (peek() != '"') {
+          fail("expected key");
+        }
+        std::string key = parseString();
+        expect(':');
+        value.mObject.emplace_back(std::move(key), parseValue(depth + 1));
+        char next = peek();
+        mPos++;
+        if (next == '}') {
+          break;
+        }
+        if (next != ',') {
+          fail("expected , or }");
+        }
+      }
+    } else if (c == '[') {
+      mPos++;
+      value.mType = JsonValue::Type::Array;
+      if (peek() == ']') {
+        mPos++;
+        return value;
+      }
+      while (true) {
+        value.mArray.push_back(parseValue(depth + 1));
+        char next = peek();
+        mPos++;
+        if (next == ']') {
+          break;
+        }
+        if (next != ',') {
+          fail("expected , or ]");
+        }
+      }
+    } else if (c == '"') {
+      value.mType = JsonValue::Type::String;
+      value.mString = parseString();
+    } else if (consumeLiteral("true")) {
+      value.mType = JsonValue::Type::Bool;
+      value.mBool = true;
+    } else if (consumeLiteral("false")) {
+      value.mType = JsonValue::Type::Bool;
+    } else if (consumeLiteral("null")) {
+      value.mType = JsonValue::Type::Null;
+    } else {
+      const char *begin = mText.c_str() + mPos;
+      char *end = nullptr;
+      value.mNumber = std::strtod(begin, &end);
+      if (end == begin) {
+        fail("unexpected character");
+      }
+      value.mType = JsonValue::Type::Number;
+      mPos += end - begin;
+    }
+    return value;
+  }
+
+  static void appendUtf8(std::string &out, unsigned codepoint) {
+    if (codepoint < 0x80) {
+      out += static_cast<char>(codepoint);
+    } else if (codepoint < 0x800) {
+      out += static_cast<char>(0xc0 | (codepoint >> 6));
+      out += static_cast<char>(0x80 | (codepoint & 0x3f));
+    } else if (codepoint < 0x10000) {
+      out += static_cast<char>(0xe0 | (codepoint >> 12));
+      out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f));
+      out += static_cast<char>(0x80 | (codepoint & 0x3f));
+    } else {
+      out += static_cast<char>(0xf0 | (codepoint >> 18));
+      out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3f));
+      out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f));
+      out += static_cast<char>(0x80 | (codepoint & 0x3f));
+    }
+  }
+
+  unsigned parseHex4() {
+    if (mPos + 4 > mText.size()) {
+      fail("truncated escape");
+    }
+    unsigned value = 0;
+    for (int i = 0; i < 4; i++) {
+      char c = mText[mPos++];
+      value <<= 4;
+      if (c >= '0' && c <= '9') {
+        value |= c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        value |= c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        value |= c - 'A' + 10;
+      } else {
+        fail("bad escape");
+      }
+    }
+    return value;
+  }
+
+  std::string parseString() {
+    expect('"');
+    std::string out;
+    while (true) {
+      if (mPos >= mText.size()) {
+        fail("unterminated string");
+      }
+      char c = mText[mPos++];
+      if (c == '"') {
+        return out;
+      }
+      if (c != '\\') {
+        out += c;
+        continue;
+      }
+      if (mPos >= mText.size()) {
+        fail("unterminated string");
+      }
+      char escape = mText[mPos++];
+      switch (escape) {
+      case '"':
+      case '\\':
+      case '/':
+        out += escape;
+        break;
+      case 'b':
+        out += '\b';
+        break;
+      case 'f':
+        out += '\f';
+        break;
+      case 'n':
+        out += '\n';
+        break;
+      case 'r':
+        out += '\r';
+        break;
+      case 't':
+        out += '\t';
+        break;
+      case 'u': {
+        unsigned codepoint = parseHex4();
+        // Surrogate pair
+        if (codepoint >= 0xd800 && codepoint < 0xdc00 &&
+            consumeLiteral("\\u")) {
+          unsigned low = parseHex4();
+          codepoint = 0x10000 + ((codepoint - 0xd800) << 10) + (low - 0xdc00);
+        }
+        appendUtf8(out, codepoint);
+        break;
+      }
+      default:
+        fail("bad escape");
+      }
+    }
+  }
+
+  const std::string &mText;
+  size_t mPos = 0;
+};
+
+JsonValue JsonValue::Parse(const std::string &text) {
+  return JsonParser(text).parseDocument();
+}
+
+bool JsonValue::asBool() const {
+  if (mType != Type::Bool) {
+    throw std::runtime_error("JSON: value is not a bool");
+  }
+  return mBool;
+}
+
+double JsonValue::asNumber() const {
+  if (mType != Type::Number) {
+    throw std::runtime_error("JSON: value is not a number");
+  }
+  return mNumber;
+}
+
+const std::string &JsonValue::asString() const {
+  if (mType != Type::String) {
+    throw std::runtime_error("JSON: value is not a string");
+  }
+  return mString;
+}
+
+const JsonValue *JsonValue::find(const std::string &key) const {
+  for (const auto &member : mObject) {
+    if (member.first == key) {
+      return &member.second;
+    }
+  }
+  return nullptr;
+}
+
+const JsonValue &JsonValue::operator[](const std::string &key) const {
+  const JsonValue *value = find(key);
+  if (!value) {
+    throw std::runtime_error("JSON: missing key " + key);
+  }
+  return *value;
+}
+
+const JsonValue &JsonValue::operator[](size_t index) const {
+  if (index >= mArray.size()) {
+    throw std::runtime_error("JSON: index " + std::to_string(index) +
+                             " out of range");
+  }
+  return mArray[index];
+}
+
+double JsonValue::numberOr(const std::string &key, double fallback) const {
+  const JsonValue *value = find(key);
+  return value && value->mType == Type::Number ? value->mNumber : fallback;
+}
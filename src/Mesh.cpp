@@ -1,60 +1,263 @@
 #include "Mesh.h"
 
-Mesh::Mesh(std::vector<Vertex> &vertices, std::vector<GLuint> &indices) {
+#include "MeshCache.h"
+#include "MeshLoader.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+
+Mesh::Mesh(std::vector<Vertex> &vertices, std::vector<GLuint> &indices,
+           VertexFormat format, GeometryPool *pool)
+    : mFormat(pool ? pool->getFormat() : format),
+      mInstanceVBO(0, nullptr, GL_STREAM_DRAW) {
   this->mVertices = vertices;
   this->mIndices = indices;
+  for (const Vertex &vertex : vertices) {
+    mBounds.expand(vertex.Position);
+  }
+  uploadVertices(vertices.data(), vertices.size(), indices.data(),
+                 indices.size(), pool);
+}
+
+Mesh::Mesh(const Vertex *vertices, size_t vertexCount, const GLuint *indices,
+           size_t indexCount, const AABB *bounds, VertexFormat format,
+           GeometryPool *pool)
+    : mFormat(pool ? pool->getFormat() : format),
+      mInstanceVBO(0, nullptr, GL_STREAM_DRAW) {
+  if (bounds) {
+    mBounds = *bounds;
+  } else {
+    for (size_t i = 0; i < vertexCount; i++) {
+      mBounds.expand(vertices[i].Position);
+    }
+  }
+  uploadVertices(vertices, vertexCount, indices, indexCount, pool);
+}
+
+Mesh::Mesh(const void *vertexData, VertexFormat format, size_t vertexCount,
+           const void *indexData, GLenum indexType, size_t indexCount,
+           const AABB &bounds, GeometryPool *pool)
+    : mFormat(format), mBounds(bounds),
+      mInstanceVBO(0, nullptr, GL_STREAM_DRAW) {
+  upload(vertexData, vertexCount, indexData, indexType, indexCount, pool);
+}
+
+void Mesh::uploadVertices(const Vertex *vertices, size_t vertexCount,
+                          const GLuint *indices, size_t indexCount,
+                          GeometryPool *pool) {
+  std::vector<PackedVertex> packed;
+  const void *vertexData = vertices;
+  if (mFormat == VertexFormat::Packed) {
+    packed = PackVertices(vertices, vertexCount);
+    vertexData = packed.data();
+  }
+
+  if (IndexTypeFor(vertexCount) == GL_UNSIGNED_SHORT) {
+    std::vector<uint16_t> shortIndices = NarrowIndices(indices, indexCount);
+    upload(vertexData, vertexCount, shortIndices.data(), GL_UNSIGNED_SHORT,
+           indexCount, pool);
+  } else {
+    upload(vertexData, vertexCount, indices, GL_UNSIGNED_INT, indexCount,
+           pool);
+  }
+}
+
+void Mesh::upload(const void *vertexData, size_t vertexCount,
+                  const void *indexData, GLenum indexType, size_t indexCount,
+                  GeometryPool *pool) {
+  mIndexCount = static_cast<GLsizei>(indexCount);
+  mIndexType = indexType;
+
+  // The pool only takes 16 bit indices
+  if (pool && pool->getFormat() == mFormat &&
+      indexType == GL_UNSIGNED_SHORT && vertexCount > 0 && indexCount > 0) {
+    mPooled = PooledGeometry(
+        pool, pool->add(vertexData, vertexCount,
+                        static_cast<const uint16_t *>(indexData), indexCount));
+    return;
+  }
 
   mVAO.Bind();
-  VBO vbo(vertices);
-  EBO ebo(indices);
-  mVAO.LinkAttrib(vbo, 0, 3, GL_FLOAT, sizeof(Vertex), (void *)0);
-  mVAO.LinkAttrib(vbo, 1, 3, GL_FLOAT, sizeof(Vertex),
-                  (void *)(3 * sizeof(float)));
-  mVAO.LinkAttrib(vbo, 2, 3, GL_FLOAT, sizeof(Vertex),
-                  (void *)(6 * sizeof(float)));
+  VBO vbo(vertexCount * VertexStride(mFormat), vertexData, GL_STATIC_DRAW);
+  EBO ebo(indexCount * IndexSize(indexType), indexData);
+  mVAO.LinkLayout(vbo, GetVertexLayout(mFormat));
+  // Per-instance model matrix, see shaders/vert.glsl
+  mVAO.LinkInstanceMat4(mInstanceVBO, 3);
 
   mVAO.Unbind();
   vbo.Unbind();
   ebo.Unbind();
 }
 
-void Mesh::Draw(Shader &shader, Camera &camera, GLuint mode) {
+namespace {
+
+// Half floats step by 2^(e - 10) between 2^e and 2^(e + 1). Positions are
+// only packed while that step at the largest coordinate stays below a
+// thousandth of the mesh's size, far from models placed away from the
+// origin or overflowing to infinity past 65504.
+bool HalfPrecisionHolds(const AABB &bounds) {
+  if (bounds.isEmpty()) {
+    return true;
+  }
+  glm::vec3 magnitudes = glm::max(glm::abs(bounds.min), glm::abs(bounds.max));
+  float magnitude =
+      std::max(magnitudes.x, std::max(magnitudes.y, magnitudes.z));
+  if (!(magnitude <= 65504.0f)) {
+    return false;
+  }
+  if (magnitude == 0.0f) {
+    return true;
+  }
+  int exponent = 0;
+  std::frexp(magnitude, &exponent);
+  float step = std::ldexp(1.0f, exponent - 11);
+  return step <= glm::length(bounds.max - bounds.min) / 1024.0f;
+}
+
+} // namespace
+
+Mesh Mesh::Load(const std::string &path, const MeshLoadOptions &options) {
+  VertexFormat format =
+      options.pool ? options.pool->getFormat() : options.format;
+  std::string cachePath = MeshCachePath(path);
+  if (options.useCache) {
+    MappedMesh mapped;
+    // A cache in another format is rebuilt like a stale one, except for
+    // the float cache of a mesh half floats can't hold
+    if (mapped.open(cachePath, path) &&
+        (mapped.vertexFormat() == format ||
+         (format == VertexFormat::Packed &&
+          mapped.vertexFormat() == VertexFormat::Float &&
+          !HalfPrecisionHolds(mapped.bounds())))) {
+      format = mapped.vertexFormat();
+      Mesh mesh(mapped.vertexData(), format, mapped.vertexCount(),
+                mapped.indexData(), mapped.indexType(), mapped.indexCount(),
+                mapped.bounds(), options.pool);
+      if (options.keepCpuData) {
+        if (format == VertexFormat::Packed) {
+          const PackedVertex *packed =
+              static_cast<const PackedVertex *>(mapped.vertexData());
+          mesh.mVertices.resize(mapped.vertexCount());
+          for (size_t i = 0; i < mapped.vertexCount(); i++) {
+            mesh.mVertices[i] = UnpackVertex(packed[i]);
+          }
+        } else {
+          const Vertex *vertices =
+              static_cast<const Vertex *>(mapped.vertexData());
+          mesh.mVertices.assign(vertices, vertices + mapped.vertexCount());
+        }
+        if (mapped.indexType() == GL_UNSIGNED_SHORT) {
+          const uint16_t *indices =
+              static_cast<const uint16_t *>(mapped.indexData());
+          mesh.mIndices.assign(indices, indices + mapped.indexCount());
+        } else {
+          const GLuint *indices =
+              static_cast<const GLuint *>(mapped.indexData());
+          mesh.mIndices.assign(indices, indices + mapped.indexCount());
+        }
+      }
+      return mesh;
+    }
+  }
+
+  MeshData data = LoadMeshFile(path);
+  if (options.optimize) {
+    MeshOptimizeStats stats = OptimizeMesh(data);
+    std::cout << "Optimized " << path << ": " << stats.verticesBefore
+              << " -> " << stats.verticesAfter << " vertices, ACMR "
+              << stats.acmrBefore << " -> " << stats.acmrAfter << std::endl;
+  }
+
+  AABB bounds;
+  for (const Vertex &vertex : data.vertices) {
+    bounds.expand(vertex.Position);
+  }
+  if (format == VertexFormat::Packed && !HalfPrecisionHolds(bounds)) {
+    // Also keeps the mesh out of a packed pool
+    std::cout << path << " is too large or too far from the origin for "
+              << "half float positions, storing floats" << std::endl;
+    format = VertexFormat::Float;
+  }
+  std::vector<PackedVertex> packed;
+  const void *vertexData = data.vertices.data();
+  if (format == VertexFormat::Packed) {
+    packed = PackVertices(data.vertices.data(), data.vertices.size());
+    vertexData = packed.data();
+  }
+  GLenum indexType = IndexTypeFor(data.vertices.size());
+  std::vector<uint16_t> shortIndices;
+  const void *indexData = data.indices.data();
+  if (indexType == GL_UNSIGNED_SHORT) {
+    shortIndices = NarrowIndices(data.indices.data(), data.indices.size());
+    indexData = shortIndices.data();
+  }
+
+  Mesh mesh(vertexData, format, data.vertices.size(), indexData, indexType,
+            data.indices.size(), bounds, options.pool);
+  if (options.useCache) {
+    // A missing cache only costs load time, never fail the load over it
+    try {
+      WriteMeshCache(cachePath, path, vertexData, format,
+                     data.vertices.size(), indexData, indexType,
+                     data.indices.size(), bounds);
+    } catch (const std::exception &e) {
+      std::cout << e.what() << std::endl;
+    }
+  }
+  if (options.keepCpuData) {
+    mesh.mVertices = std::move(data.vertices);
+    mesh.mIndices = std::move(data.indices);
+  }
+  return mesh;
+}
+
+void Mesh::ReleaseCpuData() {
+  std::vector<Vertex>().swap(mVertices);
+  std::vector<GLuint>().swap(mIndices);
+}
+
+void Mesh::Draw(Shader &shader, GLuint mode) {
   shader.Activate();
-  mVAO.Bind();
+  DrawInstanced(mode, &mModel, 1);
+}
 
-  shader.setMat4("model", mModel);
+void Mesh::DrawInstanced(GLuint mode, const glm::mat4 *models, GLsizei count) {
+  if (count <= 0) {
+    return;
+  }
+  if (GeometryPool *pool = mPooled.pool()) {
+    DrawElementsIndirectCommand command = pool->command(mPooled.id(), count, 0);
+    pool->draw(mode, &command, 1, models, count);
+    return;
+  }
 
-  shader.setVec3("camPos", camera.GetPosition());
-  camera.Matrix(shader, "camMatrix");
+  // Grow geometrically and orphan the old store so the driver never has to
+  // wait on draws still reading last frame's matrices
+  GLsizeiptr size = count * sizeof(glm::mat4);
+  if (size > mInstanceCapacity) {
+    mInstanceCapacity = std::max(size, mInstanceCapacity * 2);
+  }
+  mInstanceVBO.Upload(mInstanceCapacity, nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, size, models);
+  mInstanceVBO.Unbind();
 
-  glDrawElements(mode, mIndices.size(), GL_UNSIGNED_INT, 0);
+  mVAO.Bind();
+  glDrawElementsInstanced(mode, mIndexCount, mIndexType, 0, count);
 }
 
 void Mesh::SetTransform(const glm::mat4 &mat) {
-  mModel = mat;
   // Rotate to go from my coords to opengl coords
-  glm::mat4 transformation = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f),
-                                         glm::vec3(1.0f, 0.0f, 0.0f));
-  glm::mat4 transformation1 = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f),
-                                          glm::vec3(0.0f, 1.0f, 0.0f));
-  mModel = transformation1 * transformation * mModel;
+  mModel = BasisConversion() * mat;
 }
 
 void Mesh::SetTransform(const glm::vec3 &pos, const glm::quat &rot) {
-  glm::mat4 rotationMatrix = glm::toMat4(rot);
-  glm::mat4 translationMatrix = glm::translate(glm::mat4(1.0f), pos);
-  glm::mat4 transform = translationMatrix * rotationMatrix;
-  mModel = transform;
-
-  // Rotate to go from my coords to opengl coords
-  glm::mat4 transformation = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f),
-                                         glm::vec3(1.0f, 0.0f, 0.0f));
-  glm::mat4 transformation1 = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f),
-                                          glm::vec3(0.0f, 1.0f, 0.0f));
-  mModel = transformation1 * transformation * mModel;
+  mModel = ModelMatrix(pos, rot);
 }
 
-Mesh Mesh::CreateCube(float size) {
+Mesh Mesh::CreateCube(float size, VertexFormat format, GeometryPool *pool) {
   glm::vec3 color = glm::vec3(0.3f);
   float d = size / 2.0f;
 
@@ -89,40 +292,40 @@ Mesh Mesh::CreateCube(float size) {
   // Define vertices for the cube, using normals and texCoords
   std::vector<Vertex> cubeVertices = {
       // Front face
-      {ppp, color, normals[0]}, // Top Right
-      {pnp, color, normals[0]}, // Bottom Right
-      {nnp, color, normals[0]}, // Bottom Left
-      {npp, color, normals[0]}, // Top Left
+      {ppp, normals[0], color}, // Top Right
+      {pnp, normals[0], color}, // Bottom Right
+      {nnp, normals[0], color}, // Bottom Left
+      {npp, normals[0], color}, // Top Left
 
       // Back face
-      {ppn, color, normals[1]}, // Top Right
-      {pnn, color, normals[1]}, // Bottom Right
-      {nnn, color, normals[1]}, // Bottom Left
-      {npn, color, normals[1]}, // Top Left
+      {ppn, normals[1], color}, // Top Right
+      {pnn, normals[1], color}, // Bottom Right
+      {nnn, normals[1], color}, // Bottom Left
+      {npn, normals[1], color}, // Top Left
 
       // Left face
-      {npp, color, normals[2]}, // Top Right
-      {nnp, color, normals[2]}, // Bottom Right
-      {nnn, color, normals[2]}, // Bottom Left
-      {npn, color, normals[2]}, // Top Left
+      {npp, normals[2], color}, // Top Right
+      {nnp, normals[2], color}, // Bottom Right
+      {nnn, normals[2], color}, // Bottom Left
+      {npn, normals[2], color}, // Top Left
 
       // Right face
-      {ppp, color, normals[3]}, // Top Right
-      {pnp, color, normals[3]}, // Bottom Right
-      {pnn, color, normals[3]}, // Bottom Left
-      {ppn, color, normals[3]}, // Top Left
+      {ppp, normals[3], color}, // Top Right
+      {pnp, normals[3], color}, // Bottom Right
+      {pnn, normals[3], color}, // Bottom Left
+      {ppn, normals[3], color}, // Top Left
 
       // Top face
-      {ppp, color, normals[4]}, // Top Right
-      {npp, color, normals[4]}, // Top Left
-      {npn, color, normals[4]}, // Bottom Left
-      {ppn, color, normals[4]}, // Bottom Right
+      {ppp, normals[4], color}, // Top Right
+      {npp, normals[4], color}, // Top Left
+      {npn, normals[4], color}, // Bottom Left
+      {ppn, normals[4], color}, // Bottom Right
 
       // Bottom face
-      {pnp, color, normals[5]}, // Top Right
-      {nnp, color, normals[5]}, // Top Left
-      {nnn, color, normals[5]}, // Bottom Left
-      {pnn, color, normals[5]}  // Bottom Right
+      {pnp, normals[5], color}, // Top Right
+      {nnp, normals[5], color}, // Top Left
+      {nnn, normals[5], color}, // Bottom Left
+      {pnn, normals[5], color}  // Bottom Right
   };
 
   // Define indices for the cube (same as before)
@@ -140,5 +343,5 @@ Mesh Mesh::CreateCube(float size) {
                                            20, 21, 23, 21, 22, 23};
 
   // Initialize the Mesh with cube data
-  return Mesh(cubeVertices, cubeIndices);
+  return Mesh(cubeVertices, cubeIndices, format, pool);
 }
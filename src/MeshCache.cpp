@@ -0,0 +1,197 @@
+#include "MeshCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint64_t Alignment = 16;
+
+uint64_t AlignUp(uint64_t value) {
+  return (value + Alignment - 1) & ~(Alignment - 1);
+}
+
+bool StatFile(const std::string &path, uint64_t &size, int64_t &mtime) {
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0) {
+    return false;
+  }
+  size = static_cast<uint64_t>(info.st_size);
+  mtime = static_cast<int64_t>(info.st_mtime);
+  return true;
+}
+
+void WriteAll(FILE *file, const void *data, size_t size,
+              const std::string &path) {
+  if (size > 0 && std::fwrite(data, 1, size, file) != size) {
+    throw std::runtime_error("Failed to write " + path);
+  }
+}
+
+void WritePadding(FILE *file, uint64_t from, uint64_t to,
+                  const std::string &path) {
+  static const char zeros[Alignment] = {};
+  WriteAll(file, zeros, static_cast<size_t>(to - from), path);
+}
+
+// An out of range index would make the GPU read past the vertex buffer
+template <typename Index>
+bool IndicesInRange(const Index *indices, uint64_t count,
+                    uint64_t vertexCount) {
+  for (uint64_t i = 0; i < count; i++) {
+    if (indices[i] >= vertexCount) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+std::string MeshCachePath(const std::string &sourcePath) {
+  return sourcePath + ".emsh";
+}
+
+void WriteMeshCache(const std::string &cachePath, const std::string &sourcePath,
+                    const void *vertexData, VertexFormat format,
+                    size_t vertexCount, const void *indexData,
+                    GLenum indexType, size_t indexCount, const AABB &bounds) {
+  MeshCacheHeader header = {};
+  header.magic = MeshCacheHeader::Magic;
+  header.version = MeshCacheHeader::CurrentVersion;
+  header.vertexStride = static_cast<uint32_t>(VertexStride(format));
+  header.indexSize = static_cast<uint32_t>(IndexSize(indexType));
+  header.vertexFormat = static_cast<uint32_t>(format);
+  header.vertexCount = vertexCount;
+  header.indexCount = indexCount;
+  header.vertexOffset = AlignUp(sizeof(MeshCacheHeader));
+  header.indexOffset =
+      AlignUp(header.vertexOffset + vertexCount * header.vertexStride);
+  for (int i = 0; i < 3; i++) {
+    header.boundsMin[i] = bounds.min[i];
+    header.boundsMax[i] = bounds.max[i];
+  }
+  if (!StatFile(sourcePath, header.sourceSize, header.sourceMTime)) {
+    throw std::runtime_error("Failed to stat " + sourcePath);
+  }
+
+  std::string tempPath = cachePath + ".tmp";
+  FILE *file = std::fopen(tempPath.c_str(), "wb");
+  if (!file) {
+    throw std::runtime_error("Failed to create " + tempPath);
+  }
+  try {
+    uint64_t vertexSize = vertexCount * header.vertexStride;
+    uint64_t vertexEnd = header.vertexOffset + vertexSize;
+    WriteAll(file, &header, sizeof(header), tempPath);
+    WritePadding(file, sizeof(header), header.vertexOffset, tempPath);
+    WriteAll(file, vertexData, static_cast<size_t>(vertexSize), tempPath);
+    WritePadding(file, vertexEnd, header.indexOffset, tempPath);
+    WriteAll(file, indexData, indexCount * header.indexSize, tempPath);
+  } catch (...) {
+    std::fclose(file);
+    std::remove(tempPath.c_str());
+    throw;
+  }
+  if (std::fclose(file) != 0 ||
+      std::rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+    std::remove(tempPath.c_str());
+    throw std::runtime_error("Failed to write " + cachePath);
+  }
+}
+
+MappedMesh::~MappedMesh() { close(); }
+
+bool MappedMesh::open(const std::string &cachePath,
+                      const std::string &sourcePath) {
+  close();
+
+  int fd = ::open(cachePath.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 ||
+      static_cast<size_t>(info.st_size) < sizeof(MeshCacheHeader)) {
+    ::close(fd);
+    return false;
+  }
+  mSize = static_cast<size_t>(info.st_size);
+  void *data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file alive
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    mSize = 0;
+    return false;
+  }
+  // Everything is read once, front to back, by the upload
+  madvise(data, mSize, MADV_SEQUENTIAL);
+  madvise(data, mSize, MADV_WILLNEED);
+  mData = data;
+  mHeader = static_cast<const MeshCacheHeader *>(mData);
+
+  const MeshCacheHeader &h = *mHeader;
+  bool valid = h.magic == MeshCacheHeader::Magic &&
+               h.version == MeshCacheHeader::CurrentVersion &&
+               IsValidVertexFormat(h.vertexFormat) &&
+               h.vertexStride ==
+                   VertexStride(static_cast<VertexFormat>(h.vertexFormat)) &&
+               (h.indexSize == sizeof(uint16_t) ||
+                h.indexSize == sizeof(GLuint)) &&
+               h.vertexOffset % Alignment == 0 &&
+               h.indexOffset % Alignment == 0 && h.vertexOffset <= mSize &&
+               h.indexOffset <= mSize &&
+               h.vertexCount <= (mSize - h.vertexOffset) / h.vertexStride &&
+               h.indexCount <= (mSize - h.indexOffset) / h.indexSize;
+
+  // A cache older than its source is stale
+  uint64_t sourceSize;
+  int64_t sourceMTime;
+  if (valid && StatFile(sourcePath, sourceSize, sourceMTime)) {
+    valid = sourceSize == h.sourceSize && sourceMTime == h.sourceMTime;
+  }
+
+  if (valid && h.indexSize == sizeof(uint16_t)) {
+    valid = IndicesInRange(static_cast<const uint16_t *>(indexData()),
+                           h.indexCount, h.vertexCount);
+  } else if (valid) {
+    valid = IndicesInRange(static_cast<const GLuint *>(indexData()),
+                           h.indexCount, h.vertexCount);
+  }
+  if (!valid) {
+    close();
+  }
+  return valid;
+}
+
+void MappedMesh::close() {
+  if (mData) {
+    munmap(mData, mSize);
+  }
+  mData = nullptr;
+  mSize = 0;
+  mHeader = nullptr;
+}
+
+const void *MappedMesh::vertexData() const {
+  return static_cast<const char *>(mData) + mHeader->vertexOffset;
+}
+
+const void *MappedMesh::indexData() const {
+  return static_cast<const char *>(mData) + mHeader->indexOffset;
+}
+
+AABB MappedMesh::bounds() const {
+  AABB box;
+  for (int i = 0; i < 3; i++) {
+    box.min[i] = mHeader->boundsMin[i];
+    box.max[i] = mHeader->boundsMax[i];
+  }
+  return box;
+}
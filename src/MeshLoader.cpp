@@ -0,0 +1,464 @@
+#include "MeshLoader.h"
+
+#include "Json.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+const glm::vec3 DefaultColor(0.8f);
+
+std::string ReadFile(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Failed to open " + path);
+  }
+  std::ostringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+std::string Extension(const std::string &path) {
+  size_t dot = path.find_last_of('.');
+  if (dot == std::string::npos) {
+    return "";
+  }
+  std::string extension = path.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return extension;
+}
+
+std::string Directory(const std::string &path) {
+  size_t slash = path.find_last_of("/\\");
+  return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+// Area weighted smooth normals for every vertex whose normal is zero
+void FillMissingNormals(MeshData &mesh) {
+  std::vector<char> missing(mesh.vertices.size());
+  bool any = false;
+  for (size_t i = 0; i < mesh.vertices.size(); i++) {
+    const glm::vec3 &n = mesh.vertices[i].Normal;
+    missing[i] = n.x == 0.0f && n.y == 0.0f && n.z == 0.0f;
+    any |= missing[i] != 0;
+  }
+  if (!any) {
+    return;
+  }
+
+  for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+    GLuint a = mesh.indices[i], b = mesh.indices[i + 1],
+           c = mesh.indices[i + 2];
+    glm::vec3 faceNormal =
+        glm::cross(mesh.vertices[b].Position - mesh.vertices[a].Position,
+                   mesh.vertices[c].Position - mesh.vertices[a].Position);
+    for (GLuint v : {a, b, c}) {
+      if (missing[v]) {
+        mesh.vertices[v].Normal += faceNormal;
+      }
+    }
+  }
+  for (size_t i = 0; i < mesh.vertices.size(); i++) {
+    glm::vec3 &n = mesh.vertices[i].Normal;
+    if (missing[i] && glm::length(n) > 0.0f) {
+      n = glm::normalize(n);
+    }
+  }
+}
+
+// OBJ indices are 1 based, negative ones count back from the end
+int ResolveObjIndex(long index, size_t count) {
+  long resolved = index < 0 ? static_cast<long>(count) + index : index - 1;
+  if (resolved < 0 || resolved >= static_cast<long>(count)) {
+    return -1;
+  }
+  return static_cast<int>(resolved);
+}
+
+std::vector<uint8_t> DecodeBase64(const std::string &text, size_t begin) {
+  auto value = [](char c) -> int {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+' || c == '-') return 62;
+    if (c == '/' || c == '_') return 63;
+    return -1;
+  };
+
+  std::vector<uint8_t> out;
+  out.reserve((text.size() - begin) * 3 / 4);
+  uint32_t bits = 0;
+  int bitCount = 0;
+  for (size_t i = begin; i < text.size(); i++) {
+    int v = value(text[i]);
+    if (v < 0) {
+      continue;
+    }
+    bits = (bits << 6) | static_cast<uint32_t>(v);
+    bitCount += 6;
+    if (bitCount >= 8) {
+      bitCount -= 8;
+      out.push_back(static_cast<uint8_t>(bits >> bitCount));
+    }
+  }
+  return out;
+}
+
+// Typed view of a glTF accessor
+struct Accessor {
+  const uint8_t *data = nullptr;
+  size_t count = 0;
+  size_t stride = 0;
+  int componentType = 0;
+  int components = 0;
+  bool normalized = false;
+
+  // Component c of element i, normalized integers are mapped to [0, 1]
+  float get(size_t i, int c) const {
+    const uint8_t *p = data + i * stride;
+    switch (componentType) {
+    case 5126: {
+      float value;
+      std::memcpy(&value, p + c * 4, 4);
+      return value;
+    }
+    case 5121:
+      return normalized ? p[c] / 255.0f : p[c];
+    case 5123: {
+      uint16_t value;
+      std::memcpy(&value, p + c * 2, 2);
+      return normalized ? value / 65535.0f : value;
+    }
+    case 5125: {
+      uint32_t value;
+      std::memcpy(&value, p + c * 4, 4);
+      return static_cast<float>(value);
+    }
+    default:
+      throw std::runtime_error("glTF: unsupported component type");
+    }
+  }
+
+  uint32_t getIndex(size_t i) const {
+    const uint8_t *p = data + i * stride;
+    switch (componentType) {
+    case 5121:
+      return *p;
+    case 5123: {
+      uint16_t value;
+      std::memcpy(&value, p, 2);
+      return value;
+    }
+    case 5125: {
+      uint32_t value;
+      std::memcpy(&value, p, 4);
+      return value;
+    }
+    default:
+      throw std::runtime_error("glTF: unsupported index type");
+    }
+  }
+};
+
+int ComponentCount(const std::string &type) {
+  if (type == "SCALAR") return 1;
+  if (type == "VEC2") return 2;
+  if (type == "VEC3") return 3;
+  if (type == "VEC4") return 4;
+  throw std::runtime_error("glTF: unsupported accessor type " + type);
+}
+
+int ComponentSize(int componentType) {
+  switch (componentType) {
+  case 5120:
+  case 5121:
+    return 1;
+  case 5122:
+  case 5123:
+    return 2;
+  case 5125:
+  case 5126:
+    return 4;
+  default:
+    throw std::runtime_error("glTF: unsupported component type");
+  }
+}
+
+Accessor GetAccessor(const JsonValue &document,
+                     const std::vector<std::vector<uint8_t>> &buffers,
+                     int index) {
+  const JsonValue &accessor = document["accessors"][index];
+  Accessor result;
+  result.count = static_cast<size_t>(accessor["count"].asNumber());
+  result.componentType = accessor["componentType"].asInt();
+  result.components = ComponentCount(accessor["type"].asString());
+  if (const JsonValue *normalized = accessor.find("normalized")) {
+    result.normalized = normalized->asBool();
+  }
+  if (!accessor.find("bufferView")) {
+    throw std::runtime_error("glTF: sparse accessors are not supported");
+  }
+
+  const JsonValue &view = document["bufferViews"][accessor["bufferView"].asInt()];
+  const std::vector<uint8_t> &buffer = buffers.at(view["buffer"].asInt());
+  size_t elementSize = ComponentSize(result.componentType) * result.components;
+  size_t offset = static_cast<size_t>(view.numberOr("byteOffset", 0)) +
+                  static_cast<size_t>(accessor.numberOr("byteOffset", 0));
+  result.stride = static_cast<size_t>(view.numberOr("byteStride", 0));
+  if (result.stride == 0) {
+    result.stride = elementSize;
+  }
+  if (result.count > 0 &&
+      offset + (result.count - 1) * result.stride + elementSize >
+          buffer.size()) {
+    throw std::runtime_error("glTF: accessor out of buffer bounds");
+  }
+  result.data = buffer.data() + offset;
+  return result;
+}
+
+} // namespace
+
+MeshData LoadOBJ(const std::string &path) {
+  std::ifstream in(path);
+  if (!in) {
+    throw std::runtime_error("Failed to open " + path);
+  }
+
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> colors;
+  std::vector<glm::vec3> normals;
+  MeshData mesh;
+  // (position, normal) pair -> vertex
+  std::unordered_map<uint64_t, GLuint> vertexLookup;
+  std::vector<GLuint> polygon;
+
+  std::string line;
+  while (std::getline(in, line)) {
+    const char *p = line.c_str();
+    while (*p == ' ' || *p == '\t') {
+      p++;
+    }
+    char *end = nullptr;
+
+    if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+      float values[6] = {0.0f, 0.0f, 0.0f, DefaultColor.x, DefaultColor.y,
+                         DefaultColor.z};
+      p += 2;
+      for (int i = 0; i < 6; i++) {
+        float value = std::strtof(p, &end);
+        if (end == p) {
+          break;
+        }
+        values[i] = value;
+        p = end;
+      }
+      positions.emplace_back(values[0], values[1], values[2]);
+      colors.emplace_back(values[3], values[4], values[5]);
+    } else if (p[0] == 'v' && p[1] == 'n') {
+      p += 2;
+      glm::vec3 normal;
+      for (int i = 0; i < 3; i++) {
+        normal[i] = std::strtof(p, &end);
+        p = end;
+      }
+      normals.push_back(normal);
+    } else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+      p += 2;
+      polygon.clear();
+      while (true) {
+        long positionIndex = std::strtol(p, &end, 10);
+        if (end == p) {
+          break;
+        }
+        p = end;
+        long normalIndex = 0;
+        if (*p == '/') {
+          p++;
+          std::strtol(p, &end, 10); // texture coordinate, unused
+          p = end;
+          if (*p == '/') {
+            p++;
+            normalIndex = std::strtol(p, &end, 10);
+            p = end;
+          }
+        }
+
+        int position = ResolveObjIndex(positionIndex, positions.size());
+        if (position < 0) {
+          throw std::runtime_error("OBJ: bad vertex index in " + path);
+        }
+        int normal =
+            normalIndex != 0 ? ResolveObjIndex(normalIndex, normals.size()) : -1;
+
+        uint64_t key = (static_cast<uint64_t>(position) << 32) |
+                       static_cast<uint32_t>(normal + 1);
+        auto found = vertexLookup.find(key);
+        if (found == vertexLookup.end()) {
+          Vertex vertex;
+          vertex.Position = positions[position];
+          vertex.Normal = normal >= 0 ? normals[normal] : glm::vec3(0.0f);
+          vertex.Color = colors[position];
+          found = vertexLookup
+                      .emplace(key, static_cast<GLuint>(mesh.vertices.size()))
+                      .first;
+          mesh.vertices.push_back(vertex);
+        }
+        polygon.push_back(found->second);
+      }
+
+      for (size_t i = 2; i < polygon.size(); i++) {
+        mesh.indices.push_back(polygon[0]);
+        mesh.indices.push_back(polygon[i - 1]);
+        mesh.indices.push_back(polygon[i]);
+      }
+    }
+  }
+
+  if (mesh.indices.empty()) {
+    throw std::runtime_error("OBJ: no faces in " + path);
+  }
+  FillMissingNormals(mesh);
+  return mesh;
+}
+
+MeshData LoadGLTF(const std::string &path) {
+  std::string file = ReadFile(path);
+  std::string jsonText;
+  std::vector<uint8_t> glbBinary;
+  bool hasGlbBinary = false;
+
+  // .glb: 12 byte header, then a JSON chunk and an optional BIN chunk
+  if (file.size() >= 12 && file.compare(0, 4, "glTF") == 0) {
+    size_t offset = 12;
+    while (offset + 8 <= file.size()) {
+      uint32_t chunkLength, chunkType;
+      std::memcpy(&chunkLength, file.data() + offset, 4);
+      std::memcpy(&chunkType, file.data() + offset + 4, 4);
+      offset += 8;
+      if (offset + chunkLength > file.size()) {
+        throw std::runtime_error("glTF: truncated chunk in " + path);
+      }
+      if (chunkType == 0x4e4f534a) { // "JSON"
+        jsonText.assign(file.data() + offset, chunkLength);
+      } else if (chunkType == 0x004e4942) { // "BIN\0"
+        glbBinary.assign(file.begin() + offset,
+                         file.begin() + offset + chunkLength);
+        hasGlbBinary = true;
+      }
+      offset += (chunkLength + 3) & ~3u;
+    }
+  } else {
+    jsonText = std::move(file);
+  }
+
+  JsonValue document = JsonValue::Parse(jsonText);
+
+  std::vector<std::vector<uint8_t>> buffers;
+  if (const JsonValue *bufferList = document.find("buffers")) {
+    for (const JsonValue &buffer : bufferList->items()) {
+      const JsonValue *uri = buffer.find("uri");
+      if (!uri) {
+        if (!hasGlbBinary) {
+          throw std::runtime_error("glTF: buffer without data in " + path);
+        }
+        buffers.push_back(std::move(glbBinary));
+        hasGlbBinary = false;
+      } else if (uri->asString().compare(0, 5, "data:") == 0) {
+        size_t comma = uri->asString().find(',');
+        if (comma == std::string::npos) {
+          throw std::runtime_error("glTF: bad data uri in " + path);
+        }
+        buffers.push_back(DecodeBase64(uri->asString(), comma + 1));
+      } else {
+        std::string data = ReadFile(Directory(path) + uri->asString());
+        buffers.emplace_back(data.begin(), data.end());
+      }
+    }
+  }
+
+  MeshData mesh;
+  const JsonValue *meshes = document.find("meshes");
+  if (!meshes) {
+    throw std::runtime_error("glTF: no meshes in " + path);
+  }
+  for (const JsonValue &gltfMesh : meshes->items()) {
+    for (const JsonValue &primitive : gltfMesh["primitives"].items()) {
+      // 4 is TRIANGLES, the default
+      if (primitive.numberOr("mode", 4) != 4) {
+        continue;
+      }
+      const JsonValue &attributes = primitive["attributes"];
+      Accessor positions =
+          GetAccessor(document, buffers, attributes["POSITION"].asInt());
+
+      Accessor normals, colors;
+      if (const JsonValue *normal = attributes.find("NORMAL")) {
+        normals = GetAccessor(document, buffers, normal->asInt());
+      }
+      if (const JsonValue *color = attributes.find("COLOR_0")) {
+        colors = GetAccessor(document, buffers, color->asInt());
+        colors.normalized |= colors.componentType != 5126;
+      }
+
+      GLuint base = static_cast<GLuint>(mesh.vertices.size());
+      for (size_t i = 0; i < positions.count; i++) {
+        Vertex vertex;
+        vertex.Position = glm::vec3(positions.get(i, 0), positions.get(i, 1),
+                                    positions.get(i, 2));
+        vertex.Normal = glm::vec3(0.0f);
+        if (normals.data && i < normals.count) {
+          vertex.Normal = glm::vec3(normals.get(i, 0), normals.get(i, 1),
+                                    normals.get(i, 2));
+        }
+        vertex.Color = DefaultColor;
+        if (colors.data && i < colors.count) {
+          vertex.Color = glm::vec3(colors.get(i, 0), colors.get(i, 1),
+                                   colors.get(i, 2));
+        }
+        mesh.vertices.push_back(vertex);
+      }
+
+      if (const JsonValue *indices = primitive.find("indices")) {
+        Accessor indexAccessor =
+            GetAccessor(document, buffers, indices->asInt());
+        for (size_t i = 0; i < indexAccessor.count; i++) {
+          uint32_t index = indexAccessor.getIndex(i);
+          if (index >= positions.count) {
+            throw std::runtime_error("glTF: index out of range in " + path);
+          }
+          mesh.indices.push_back(base + index);
+        }
+      } else {
+        for (size_t i = 0; i < positions.count; i++) {
+          mesh.indices.push_back(base + static_cast<GLuint>(i));
+        }
+      }
+    }
+  }
+
+  if (mesh.indices.empty()) {
+    throw std::runtime_error("glTF: no triangles in " + path);
+  }
+  FillMissingNormals(mesh);
+  return mesh;
+}
+
+MeshData LoadMeshFile(const std::string &path) {
+  std::string extension = Extension(path);
+  if (extension == "obj") {
+    return LoadOBJ(path);
+  }
+  if (extension == "gltf" || extension == "glb") {
+    return LoadGLTF(path);
+  }
+  throw std::runtime_error("Unsupported mesh format: " + path);
+}
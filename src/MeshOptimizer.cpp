@@ -0,0 +1,253 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+struct VertexKey {
+  const Vertex *vertex;
+
+  bool operator==(const VertexKey &other) const {
+    return std::memcmp(vertex, other.vertex, sizeof(Vertex)) == 0;
+  }
+};
+
+struct VertexKeyHash {
+  size_t operator()(const VertexKey &key) const {
+    // FNV-1a over the raw bytes, matches the bitwise equality above
+    const unsigned char *bytes =
+        reinterpret_cast<const unsigned char *>(key.vertex);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < sizeof(Vertex); i++) {
+      hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return static_cast<size_t>(hash);
+  }
+};
+
+static_assert(sizeof(Vertex) == 9 * sizeof(float),
+              "Vertex must not contain padding for bitwise welding");
+
+// Forsyth's scoring, tuned for a 32 entry LRU cache
+constexpr int ForsythCacheSize = 32;
+constexpr float CacheDecayPower = 1.5f;
+constexpr float LastTriangleScore = 0.75f;
+constexpr float ValenceBoostScale = 2.0f;
+constexpr float ValenceBoostPower = 0.5f;
+
+float ForsythVertexScore(int cachePosition, uint32_t remainingTriangles) {
+  if (remainingTriangles == 0) {
+    return -1.0f;
+  }
+
+  float score = 0.0f;
+  if (cachePosition >= 0) {
+    if (cachePosition < 3) {
+      // The vertices of the last triangle get a fixed score so the next
+      // triangle does not simply reuse the same edge
+      score = LastTriangleScore;
+    } else {
+      float scaler = 1.0f / (ForsythCacheSize - 3);
+      score = std::pow(1.0f - (cachePosition - 3) * scaler, CacheDecayPower);
+    }
+  }
+  // Prefer vertices with few triangles left, to finish them off
+  score += ValenceBoostScale *
+           std::pow(static_cast<float>(remainingTriangles), -ValenceBoostPower);
+  return score;
+}
+
+} // namespace
+
+float ComputeACMR(const GLuint *indices, size_t indexCount, size_t vertexCount,
+                  size_t cacheSize) {
+  if (indexCount < 3) {
+    return 0.0f;
+  }
+
+  // Timestamp FIFO: a vertex is cached while it was inserted less than
+  // cacheSize misses ago
+  std::vector<size_t> insertedAt(vertexCount, 0);
+  size_t misses = 0;
+  for (size_t i = 0; i < indexCount; i++) {
+    GLuint index = indices[i];
+    if (insertedAt[index] == 0 || misses - insertedAt[index] >= cacheSize) {
+      misses++;
+      insertedAt[index] = misses;
+    }
+  }
+  return static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+}
+
+size_t WeldVertices(MeshData &mesh) {
+  std::unordered_map<VertexKey, GLuint, VertexKeyHash> unique;
+  unique.reserve(mesh.vertices.size());
+  std::vector<GLuint> remap(mesh.vertices.size());
+  std::vector<Vertex> welded;
+  welded.reserve(mesh.vertices.size());
+
+  for (size_t i = 0; i < mesh.vertices.size(); i++) {
+    auto inserted = unique.emplace(VertexKey{&mesh.vertices[i]},
+                                   static_cast<GLuint>(welded.size()));
+    if (inserted.second) {
+      welded.push_back(mesh.vertices[i]);
+    }
+    remap[i] = inserted.first->second;
+  }
+
+  for (GLuint &index : mesh.indices) {
+    index = remap[index];
+  }
+  size_t removed = mesh.vertices.size() - welded.size();
+  mesh.vertices = std::move(welded);
+  return removed;
+}
+
+void OptimizeVertexCache(std::vector<GLuint> &indices, size_t vertexCount) {
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0) {
+    return;
+  }
+
+  // Triangles using each vertex, packed into one array. The first
+  // remaining[v] entries of a vertex's range are the unemitted triangles.
+  std::vector<uint32_t> remaining(vertexCount, 0);
+  for (size_t i = 0; i < triangleCount * 3; i++) {
+    remaining[indices[i]]++;
+  }
+  std::vector<uint32_t> offsets(vertexCount + 1, 0);
+  for (size_t v = 0; v < vertexCount; v++) {
+    offsets[v + 1] = offsets[v] + remaining[v];
+  }
+  std::vector<uint32_t> adjacency(offsets[vertexCount]);
+  {
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++) {
+      for (int k = 0; k < 3; k++) {
+        adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+      }
+    }
+  }
+
+  std::vector<int> cachePosition(vertexCount, -1);
+  std::vector<float> vertexScore(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++) {
+    vertexScore[v] = ForsythVertexScore(-1, remaining[v]);
+  }
+
+  auto triangleScore = [&](size_t t) {
+    return vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] +
+           vertexScore[indices[t * 3 + 2]];
+  };
+
+  std::vector<char> emitted(triangleCount, 0);
+  size_t best = 0;
+  float bestScore = triangleScore(0);
+  for (size_t t = 1; t < triangleCount; t++) {
+    float score = triangleScore(t);
+    if (score > bestScore) {
+      bestScore = score;
+      best = t;
+    }
+  }
+
+  std::vector<GLuint> output;
+  output.reserve(triangleCount * 3);
+  // LRU cache, three slots of slack for the incoming triangle
+  std::vector<GLuint> cache, nextCache;
+  cache.reserve(ForsythCacheSize + 3);
+  nextCache.reserve(ForsythCacheSize + 3);
+  size_t scanCursor = 0;
+
+  for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+    const GLuint *triangle = &indices[best * 3];
+    emitted[best] = 1;
+    output.insert(output.end(), triangle, triangle + 3);
+
+    // Take the triangle out of its vertices' lists
+    for (int k = 0; k < 3; k++) {
+      GLuint v = triangle[k];
+      uint32_t *list = &adjacency[offsets[v]];
+      uint32_t *end = list + remaining[v];
+      uint32_t *found = std::find(list, end, static_cast<uint32_t>(best));
+      std::swap(*found, *(end - 1));
+      remaining[v]--;
+    }
+
+    // Move the triangle's vertices to the front of the cache
+    nextCache.assign(triangle, triangle + 3);
+    for (GLuint v : cache) {
+      if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+        nextCache.push_back(v);
+      }
+    }
+    for (size_t i = 0; i < nextCache.size(); i++) {
+      GLuint v = nextCache[i];
+      cachePosition[v] = i < ForsythCacheSize ? static_cast<int>(i) : -1;
+      vertexScore[v] = ForsythVertexScore(cachePosition[v], remaining[v]);
+    }
+    if (nextCache.size() > ForsythCacheSize) {
+      nextCache.resize(ForsythCacheSize);
+    }
+    std::swap(cache, nextCache);
+
+    // Only triangles around cached vertices changed score, pick the best
+    bestScore = -1.0f;
+    for (GLuint v : cache) {
+      for (uint32_t i = 0; i < remaining[v]; i++) {
+        uint32_t t = adjacency[offsets[v] + i];
+        float score = triangleScore(t);
+        if (score > bestScore) {
+          bestScore = score;
+          best = t;
+        }
+      }
+    }
+
+    // Nothing left around the cache, continue with any unemitted triangle
+    if (bestScore < 0.0f) {
+      while (scanCursor < triangleCount && emitted[scanCursor]) {
+        scanCursor++;
+      }
+      best = scanCursor;
+    }
+  }
+
+  indices = std::move(output);
+}
+
+void OptimizeVertexFetch(MeshData &mesh) {
+  const GLuint Unused = ~0u;
+  std::vector<GLuint> remap(mesh.vertices.size(), Unused);
+  std::vector<Vertex> ordered;
+  ordered.reserve(mesh.vertices.size());
+
+  for (GLuint &index : mesh.indices) {
+    if (remap[index] == Unused) {
+      remap[index] = static_cast<GLuint>(ordered.size());
+      ordered.push_back(mesh.vertices[index]);
+    }
+    index = remap[index];
+  }
+  mesh.vertices = std::move(ordered);
+}
+
+MeshOptimizeStats OptimizeMesh(MeshData &mesh) {
+  MeshOptimizeStats stats;
+  stats.verticesBefore = mesh.vertices.size();
+  stats.acmrBefore = ComputeACMR(mesh.indices.data(), mesh.indices.size(),
+                                 mesh.vertices.size());
+
+  WeldVertices(mesh);
+  OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+  OptimizeVertexFetch(mesh);
+
+  stats.verticesAfter = mesh.vertices.size();
+  stats.acmrAfter = ComputeACMR(mesh.indices.data(), mesh.indices.size(),
+                                mesh.vertices.size());
+  return stats;
+}
@@ -0,0 +1,100 @@
+#include "PhysicsAssetCache.h"
+
+#include <stdexcept>
+
+PhysicsAssetCache::PhysicsAssetCache(PxPhysics &physics) : mPhysics(physics) {}
+
+PhysicsAssetCache::~PhysicsAssetCache() {
+  // Shapes first, they hold references to their materials
+  for (auto &entry : mShapes) {
+    entry.second->release();
+  }
+  for (auto &entry : mMaterials) {
+    entry.second->release();
+  }
+}
+
+PxMaterial *PhysicsAssetCache::getMaterial(float staticFriction,
+                                           float dynamicFriction,
+                                           float restitution) {
+  MaterialKey key{staticFriction, dynamicFriction, restitution};
+  auto it = mMaterials.find(key);
+  if (it != mMaterials.end()) {
+    return it->second;
+  }
+
+  PxMaterial *material =
+      mPhysics.createMaterial(staticFriction, dynamicFriction, restitution);
+  if (!material) {
+    throw std::runtime_error("Failed to create material.");
+  }
+  mMaterials.emplace(key, material);
+  return material;
+}
+
+PxShape *PhysicsAssetCache::getBoxShape(const PxVec3 &halfExtents,
+                                        PxMaterial &material) {
+  ShapeKey key{PxGeometryType::eBOX,
+               {halfExtents.x, halfExtents.y, halfExtents.z},
+               &material};
+  return getShape(key, PxBoxGeometry(halfExtents), material);
+}
+
+PxShape *PhysicsAssetCache::getSphereShape(float radius,
+                                           PxMaterial &material) {
+  ShapeKey key{PxGeometryType::eSPHERE, {radius, 0.0f, 0.0f}, &material};
+  return getShape(key, PxSphereGeometry(radius), material);
+}
+
+PxShape *PhysicsAssetCache::getCapsuleShape(float radius, float halfHeight,
+                                            PxMaterial &material) {
+  ShapeKey key{PxGeometryType::eCAPSULE, {radius, halfHeight, 0.0f},
+               &material};
+  return getShape(key, PxCapsuleGeometry(radius, halfHeight), material);
+}
+
+PxShape *PhysicsAssetCache::getShape(const ShapeKey &key,
+                                     const PxGeometry &geometry,
+                                     PxMaterial &material) {
+  auto it = mShapes.find(key);
+  if (it != mShapes.end()) {
+    return it->second;
+  }
+
+  // Non-exclusive so the same shape can be attached to many actors
+  PxShape *shape = mPhysics.createShape(geometry, material, false);
+  if (!shape) {
+    throw std::runtime_error("Failed to create shape.");
+  }
+  mShapes.emplace(key, shape);
+  return shape;
+}
+
+void PhysicsAssetCache::collectGarbage() {
+  for (auto it = mShapes.begin(); it != mShapes.end();) {
+    if (it->second->getReferenceCount() == 1) {
+      it->second->release();
+      it = mShapes.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (auto it = mMaterials.begin(); it != mMaterials.end();) {
+    if (it->second->getReferenceCount() == 1) {
+      it->second->release();
+      it = mMaterials.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+PhysicsAssetStats PhysicsAssetCache::getStats() const {
+  PhysicsAssetStats stats;
+  stats.materials = mMaterials.size();
+  stats.shapes = mShapes.size();
+  for (auto &entry : mShapes) {
+    stats.shapeReferences += entry.second->getReferenceCount() - 1;
+  }
+  return stats;
+}
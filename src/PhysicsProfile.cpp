@@ -0,0 +1,181 @@
+#include "PhysicsProfile.h"
+
+#include "Json.h"
+#include "PxPhysicsAPI.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+template <typename Enum> struct EnumName {
+  const char *name;
+  Enum value;
+};
+
+const EnumName<PhysicsProfile::BroadPhase> BroadPhaseNames[] = {
+    {"sap", PhysicsProfile::BroadPhase::SAP},
+    {"mbp", PhysicsProfile::BroadPhase::MBP},
+    {"abp", PhysicsProfile::BroadPhase::ABP},
+    {"pabp", PhysicsProfile::BroadPhase::PABP},
+};
+
+const EnumName<PhysicsProfile::Solver> SolverNames[] = {
+    {"pgs", PhysicsProfile::Solver::PGS},
+    {"tgs", PhysicsProfile::Solver::TGS},
+};
+
+const EnumName<PhysicsProfile::Friction> FrictionNames[] = {
+    {"patch", PhysicsProfile::Friction::Patch},
+    {"one_directional", PhysicsProfile::Friction::OneDirectional},
+    {"two_directional", PhysicsProfile::Friction::TwoDirectional},
+};
+
+template <typename Enum, size_t N>
+Enum ParseEnum(const JsonValue &value, const EnumName<Enum> (&names)[N],
+               const std::string &key) {
+  for (const EnumName<Enum> &entry : names) {
+    if (value.asString() == entry.name) {
+      return entry.value;
+    }
+  }
+  throw std::runtime_error("Unknown " + key + " \"" + value.asString() + "\"");
+}
+
+template <typename Enum, size_t N>
+const char *EnumToName(Enum value, const EnumName<Enum> (&names)[N]) {
+  for (const EnumName<Enum> &entry : names) {
+    if (entry.value == value) {
+      return entry.name;
+    }
+  }
+  return "?";
+}
+
+PhysicsProfile ParseProfile(const JsonValue &object) {
+  if (!object.isObject()) {
+    throw std::runtime_error("A physics profile must be an object");
+  }
+  PhysicsProfile profile;
+  for (const auto &member : object.members()) {
+    const std::string &key = member.first;
+    const JsonValue &value = member.second;
+    if (key == "name") {
+      profile.name = value.asString();
+    } else if (key == "broadPhase") {
+      profile.broadPhase = ParseEnum(value, BroadPhaseNames, key);
+    } else if (key == "mbpHalfExtent") {
+      profile.mbpHalfExtent = static_cast<float>(value.asNumber());
+    } else if (key == "mbpSubdivisions") {
+      profile.mbpSubdivisions = value.asInt();
+    } else if (key == "solver") {
+      profile.solver = ParseEnum(value, SolverNames, key);
+    } else if (key == "friction") {
+      profile.friction = ParseEnum(value, FrictionNames, key);
+    } else if (key == "positionIterations") {
+      profile.positionIterations = value.asInt();
+    } else if (key == "velocityIterations") {
+      profile.velocityIterations = value.asInt();
+    } else if (key == "sleepThreshold") {
+      profile.sleepThreshold = static_cast<float>(value.asNumber());
+    } else if (key == "stabilizationThreshold") {
+      profile.stabilizationThreshold = static_cast<float>(value.asNumber());
+    } else if (key == "stabilization") {
+      profile.stabilization = value.asBool();
+    } else if (key == "pcm") {
+      profile.pcm = value.asBool();
+    } else if (key == "bounceThreshold") {
+      profile.bounceThreshold = static_cast<float>(value.asNumber());
+    } else {
+      throw std::runtime_error("Unknown physics profile key " + key);
+    }
+  }
+
+  // PhysX clamps iteration counts to 1..255
+  if (profile.positionIterations < 1 || profile.positionIterations > 255 ||
+      profile.velocityIterations < 0 || profile.velocityIterations > 255 ||
+      profile.mbpSubdivisions < 1 || profile.mbpSubdivisions > 16 ||
+      profile.mbpHalfExtent <= 0.0f || profile.sleepThreshold < 0.0f ||
+      profile.stabilizationThreshold < 0.0f ||
+      profile.bounceThreshold < 0.0f) {
+    throw std::runtime_error("Physics profile " + profile.name +
+                             " is out of range");
+  }
+#if PX_PHYSICS_VERSION_MAJOR < 5
+  if (profile.broadPhase == PhysicsProfile::BroadPhase::PABP) {
+    throw std::runtime_error("Physics profile " + profile.name +
+                             " needs PhysX 5 for the pabp broad phase");
+  }
+#endif
+  return profile;
+}
+
+} // namespace
+
+std::vector<PhysicsProfile> LoadPhysicsProfiles(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Failed to open " + path);
+  }
+  std::ostringstream contents;
+  contents << in.rdbuf();
+
+  std::vector<PhysicsProfile> profiles;
+  try {
+    JsonValue document = JsonValue::Parse(contents.str());
+    if (const JsonValue *list = document.find("profiles")) {
+      for (const JsonValue &item : list->items()) {
+        profiles.push_back(ParseProfile(item));
+      }
+    } else {
+      profiles.push_back(ParseProfile(document));
+    }
+  } catch (const std::runtime_error &error) {
+    throw std::runtime_error(path + ": " + error.what());
+  }
+  if (profiles.empty()) {
+    throw std::runtime_error(path + ": no physics profiles");
+  }
+  return profiles;
+}
+
+std::vector<PhysicsProfile> BuiltinPhysicsProfiles() {
+  std::vector<PhysicsProfile> profiles;
+  profiles.emplace_back();
+
+  profiles.emplace_back();
+  profiles.back().name = "no_pcm";
+  profiles.back().pcm = false;
+
+  profiles.emplace_back();
+  profiles.back().name = "abp";
+  profiles.back().broadPhase = PhysicsProfile::BroadPhase::ABP;
+
+#if PX_PHYSICS_VERSION_MAJOR >= 5
+  profiles.emplace_back();
+  profiles.back().name = "pabp";
+  profiles.back().broadPhase = PhysicsProfile::BroadPhase::PABP;
+#endif
+
+  profiles.emplace_back();
+  profiles.back().name = "mbp";
+  profiles.back().broadPhase = PhysicsProfile::BroadPhase::MBP;
+
+  // TGS converges in fewer iterations, stabilization settles stacks
+  profiles.emplace_back();
+  profiles.back().name = "abp_tgs";
+  profiles.back().broadPhase = PhysicsProfile::BroadPhase::ABP;
+  profiles.back().solver = PhysicsProfile::Solver::TGS;
+  profiles.back().positionIterations = 2;
+  profiles.back().stabilization = true;
+  return profiles;
+}
+
+const char *BroadPhaseName(PhysicsProfile::BroadPhase broadPhase) {
+  return EnumToName(broadPhase, BroadPhaseNames);
+}
+
+const char *SolverName(PhysicsProfile::Solver solver) {
+  return EnumToName(solver, SolverNames);
+}
@@ -0,0 +1,195 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+namespace {
+// Ring of the calling thread, registered on its first event
+thread_local void *tRing = nullptr;
+thread_local uint32_t tDepth = 0;
+
+void WriteJsonString(std::ostream &out, const char *text) {
+  out << '"';
+  for (const char *c = text ? text : ""; *c; c++) {
+    if (*c == '"' || *c == '\\') {
+      out << '\\' << *c;
+    } else if (static_cast<unsigned char>(*c) < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+      out << escaped;
+    } else {
+      out << *c;
+    }
+  }
+  out << '"';
+}
+} // namespace
+
+Profiler &Profiler::get() {
+  static Profiler profiler;
+  return profiler;
+}
+
+int64_t Profiler::nowNs() {
+  return std::chrono::steady_clock::now().time_since_epoch() /
+         std::chrono::nanoseconds(1);
+}
+
+uint32_t Profiler::enterScope() { return tDepth++; }
+
+void Profiler::leaveScope() { tDepth--; }
+
+void Profiler::Ring::push(const ProfileEvent &event) {
+  // Only the owning thread writes. The odd sequence number marks the slot
+  // as being written before any field changes, like a seqlock.
+  uint64_t index = head.load(std::memory_order_relaxed);
+  Slot &slot = slots[index % RingCapacity];
+  slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.name.store(event.name, std::memory_order_relaxed);
+  slot.startNs.store(event.startNs, std::memory_order_relaxed);
+  slot.endNs.store(event.endNs, std::memory_order_relaxed);
+  slot.depth.store(event.depth, std::memory_order_relaxed);
+  slot.sequence.store(2 * index + 2, std::memory_order_release);
+  head.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::Ring::copy(int64_t fromNs, int64_t toNs,
+                          std::vector<ProfileEvent> &out) const {
+  uint64_t end = head.load(std::memory_order_acquire);
+  uint64_t begin = end > RingCapacity ? end - RingCapacity : 0;
+  for (uint64_t i = begin; i < end; i++) {
+    const Slot &slot = slots[i % RingCapacity];
+    uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    // Already overwritten, or being overwritten
+    if (sequence != 2 * i + 2) {
+      continue;
+    }
+    ProfileEvent event;
+    event.name = slot.name.load(std::memory_order_relaxed);
+    event.startNs = slot.startNs.load(std::memory_order_relaxed);
+    event.endNs = slot.endNs.load(std::memory_order_relaxed);
+    event.depth = slot.depth.load(std::memory_order_relaxed);
+    // The writer reached the slot while it was read, the event may be torn
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+      continue;
+    }
+    if (event.endNs > fromNs && event.startNs < toNs) {
+      out.push_back(event);
+    }
+  }
+}
+
+Profiler::Ring &Profiler::threadRing() {
+  if (!tRing) {
+    std::lock_guard<std::mutex> lock(mRingsMutex);
+    mRings.push_back(std::make_unique<Ring>());
+    mRings.back()->name = "thread " + std::to_string(mRings.size() - 1);
+    tRing = mRings.back().get();
+  }
+  return *static_cast<Ring *>(tRing);
+}
+
+void Profiler::setThreadName(const std::string &name) {
+  Ring &ring = threadRing();
+  std::lock_guard<std::mutex> lock(mRingsMutex);
+  ring.name = name;
+}
+
+void Profiler::record(const char *name, int64_t startNs, int64_t endNs,
+                      uint32_t depth) {
+  threadRing().push({name, startNs, endNs, depth});
+}
+
+int Profiler::createTrack(const std::string &name) {
+  std::lock_guard<std::mutex> lock(mRingsMutex);
+  mRings.push_back(std::make_unique<Ring>());
+  mRings.back()->name = name;
+  return static_cast<int>(mRings.size() - 1);
+}
+
+void Profiler::recordOn(int track, const char *name, int64_t startNs,
+                        int64_t endNs, uint32_t depth) {
+  if (!isEnabled()) {
+    return;
+  }
+  Ring *ring;
+  {
+    std::lock_guard<std::mutex> lock(mRingsMutex);
+    ring = mRings[track].get();
+  }
+  ring->push({name, startNs, endNs, depth});
+}
+
+void Profiler::beginFrame() {
+  mFrameStarts[mFrameCount % FrameHistory] = nowNs();
+  mFrameCount++;
+}
+
+bool Profiler::lastFrame(int64_t &startNs, int64_t &endNs) const {
+  if (mFrameCount < 2) {
+    return false;
+  }
+  startNs = mFrameStarts[(mFrameCount - 2) % FrameHistory];
+  endNs = mFrameStarts[(mFrameCount - 1) % FrameHistory];
+  return true;
+}
+
+std::vector<ProfileTrack> Profiler::collect(int64_t fromNs,
+                                            int64_t toNs) const {
+  std::vector<ProfileTrack> tracks;
+  std::lock_guard<std::mutex> lock(mRingsMutex);
+  for (const auto &ring : mRings) {
+    ProfileTrack track;
+    ring->copy(fromNs, toNs, track.events);
+    if (!track.events.empty()) {
+      track.name = ring->name;
+      tracks.push_back(std::move(track));
+    }
+  }
+  return tracks;
+}
+
+bool Profiler::exportChromeTrace(const std::string &path) const {
+  std::vector<ProfileTrack> tracks = collect(INT64_MIN, INT64_MAX);
+
+  // Trace timestamps are microseconds, start them at the oldest event
+  int64_t originNs = INT64_MAX;
+  for (const ProfileTrack &track : tracks) {
+    for (const ProfileEvent &event : track.events) {
+      originNs = std::min(originNs, event.startNs);
+    }
+  }
+
+  std::ofstream out(path, std::ios::trunc);
+  if (!out) {
+    return false;
+  }
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  char buffer[96];
+  for (size_t tid = 0; tid < tracks.size(); tid++) {
+    const ProfileTrack &track = tracks[tid];
+    out << (first ? "\n" : ",\n")
+        << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+        << ",\"name\":\"thread_name\",\"args\":{\"name\":";
+    WriteJsonString(out, track.name.c_str());
+    out << "}}";
+    first = false;
+
+    for (const ProfileEvent &event : track.events) {
+      out << ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << tid << ",\"name\":";
+      WriteJsonString(out, event.name);
+      std::snprintf(buffer, sizeof(buffer), ",\"ts\":%.3f,\"dur\":%.3f}",
+                    (event.startNs - originNs) * 1e-3,
+                    (event.endNs - event.startNs) * 1e-3);
+      out << buffer;
+    }
+  }
+  out << "\n]}\n";
+  out.close();
+  return static_cast<bool>(out);
+}
@@ -0,0 +1,161 @@
+#include "ProgramCache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <sys/stat.h>
+
+namespace {
+
+struct ProgramCacheHeader {
+  static constexpr uint32_t Magic = 0x47525045; // "EPRG"
+  static constexpr uint32_t CurrentVersion = 1;
+
+  uint32_t magic;
+  uint32_t version;
+  uint64_t key;
+  uint32_t binaryFormat;
+  uint32_t binaryLength;
+};
+
+constexpr uint64_t FnvOffset = 14695981039346656037ull;
+
+uint64_t Fnv1a(uint64_t hash, const void *data, size_t size) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+// Hashes the terminating zero too, so ("ab", "c") and ("a", "bc") differ
+uint64_t HashString(uint64_t hash, const char *text) {
+  if (!text) {
+    text = "";
+  }
+  return Fnv1a(hash, text, std::char_traits<char>::length(text) + 1);
+}
+
+uint64_t HashString(uint64_t hash, const std::string &text) {
+  return Fnv1a(hash, text.c_str(), text.size() + 1);
+}
+
+const char *GetString(GLenum name) {
+  return reinterpret_cast<const char *>(glGetString(name));
+}
+
+} // namespace
+
+ProgramCache::ProgramCache(std::string directory)
+    : mDirectory(std::move(directory)) {
+  GLint formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  mSupported = formats > 0;
+
+  mDriverHash = HashString(FnvOffset, GetString(GL_VENDOR));
+  mDriverHash = HashString(mDriverHash, GetString(GL_RENDERER));
+  mDriverHash = HashString(mDriverHash, GetString(GL_VERSION));
+}
+
+uint64_t ProgramCache::key(const std::string &vertexSource,
+                           const std::string &fragmentSource) const {
+  uint64_t hash = HashString(mDriverHash, vertexSource);
+  return HashString(hash, fragmentSource);
+}
+
+std::string ProgramCache::path(uint64_t key) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.bin",
+                static_cast<unsigned long long>(key));
+  return mDirectory + "/" + name;
+}
+
+GLuint ProgramCache::load(uint64_t key) const {
+  if (!mSupported) {
+    return 0;
+  }
+  std::ifstream in(path(key), std::ios::binary);
+  if (!in) {
+    return 0;
+  }
+
+  ProgramCacheHeader header;
+  if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      header.magic != ProgramCacheHeader::Magic ||
+      header.version != ProgramCacheHeader::CurrentVersion ||
+      header.key != key) {
+    return 0;
+  }
+  // A truncated or corrupt file must not decide how much is allocated
+  std::streampos dataStart = in.tellg();
+  in.seekg(0, std::ios::end);
+  std::streampos fileEnd = in.tellg();
+  if (dataStart < 0 || fileEnd < 0 ||
+      static_cast<uint64_t>(fileEnd - dataStart) != header.binaryLength ||
+      header.binaryLength == 0) {
+    return 0;
+  }
+  in.seekg(dataStart);
+  std::vector<char> binary(header.binaryLength);
+  if (!in.read(binary.data(), binary.size())) {
+    return 0;
+  }
+
+  GLuint program = glCreateProgram();
+  glProgramBinary(program, header.binaryFormat, binary.data(),
+                  static_cast<GLsizei>(binary.size()));
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (linked == GL_FALSE) {
+    std::cout << "Cached program " << path(key)
+              << " was rejected by the driver" << std::endl;
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+void ProgramCache::store(uint64_t key, GLuint program) const {
+  if (!mSupported) {
+    return;
+  }
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+
+  ProgramCacheHeader header;
+  header.magic = ProgramCacheHeader::Magic;
+  header.version = ProgramCacheHeader::CurrentVersion;
+  header.key = key;
+  std::vector<char> binary(length);
+  GLenum format = 0;
+  glGetProgramBinary(program, length, &length, &format, binary.data());
+  header.binaryFormat = format;
+  header.binaryLength = static_cast<uint32_t>(length);
+
+  // Already existing is fine, any other failure shows up when opening
+  mkdir(mDirectory.c_str(), 0755);
+
+  // Write then rename, a crash never leaves a truncated binary behind
+  std::string finalPath = path(key);
+  std::string tempPath = finalPath + ".tmp";
+  {
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(binary.data(), header.binaryLength);
+    out.close();
+    if (!out) {
+      std::cout << "Failed to write " << tempPath << std::endl;
+      std::remove(tempPath.c_str());
+      return;
+    }
+  }
+  if (std::rename(tempPath.c_str(), finalPath.c_str()) != 0) {
+    std::cout << "Failed to write " << finalPath << std::endl;
+    std::remove(tempPath.c_str());
+  }
+}
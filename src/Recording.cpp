@@ -0,0 +1,742 @@
+#include "Recording.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef EMBER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using recording::QuantizedPose;
+
+namespace {
+
+enum BodyFlags : uint8_t { Rendered = 1, Moved = 2 };
+
+// Keeps deltas of clamped values inside 32 bits
+constexpr float MaxPosition = (1 << 30) / recording::PositionScale;
+const float Sqrt2 = std::sqrt(2.0f);
+
+QuantizedPose Quantize(const glm::vec3 &position, const glm::quat &rotation) {
+  QuantizedPose pose;
+  for (int i = 0; i < 3; i++) {
+    float clamped = std::min(std::max(position[i], -MaxPosition), MaxPosition);
+    pose.position[i] =
+        static_cast<int32_t>(std::lround(clamped * recording::PositionScale));
+  }
+
+  // q and -q are the same rotation, flip it so the dropped one is positive
+  float components[4] = {rotation.x, rotation.y, rotation.z, rotation.w};
+  int largest = 0;
+  for (int i = 1; i < 4; i++) {
+    if (std::abs(components[i]) > std::abs(components[largest])) {
+      largest = i;
+    }
+  }
+  float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+  pose.largest = static_cast<uint8_t>(largest);
+  // The other three lie within +-1/sqrt(2)
+  for (int i = 0, k = 0; i < 4; i++) {
+    if (i == largest) {
+      continue;
+    }
+    float value = std::min(std::max(components[i] * sign * Sqrt2, -1.0f), 1.0f);
+    pose.rotation[k++] =
+        static_cast<int32_t>(std::lround(value * recording::RotationScale));
+  }
+  return pose;
+}
+
+glm::vec3 DequantizePosition(const QuantizedPose &pose) {
+  return glm::vec3(pose.position[0] / recording::PositionScale,
+                   pose.position[1] / recording::PositionScale,
+                   pose.position[2] / recording::PositionScale);
+}
+
+glm::quat DequantizeRotation(const QuantizedPose &pose) {
+  float components[4];
+  float sum = 0.0f;
+  for (int i = 0, k = 0; i < 4; i++) {
+    if (i == pose.largest) {
+      continue;
+    }
+    components[i] = pose.rotation[k++] / (recording::RotationScale * Sqrt2);
+    sum += components[i] * components[i];
+  }
+  components[pose.largest] = std::sqrt(std::max(1.0f - sum, 0.0f));
+  return glm::quat(components[3], components[0], components[1],
+                   components[2]);
+}
+
+void WriteVarint(std::vector<uint8_t> &out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+void WriteSigned(std::vector<uint8_t> &out, int64_t value) {
+  WriteVarint(out, (static_cast<uint64_t>(value) << 1) ^
+                       static_cast<uint64_t>(value >> 63));
+}
+
+void WriteWholePose(std::vector<uint8_t> &out, const QuantizedPose &pose) {
+  for (int i = 0; i < 3; i++) {
+    WriteSigned(out, pose.position[i]);
+  }
+  out.push_back(pose.largest);
+  for (int i = 0; i < 3; i++) {
+    WriteSigned(out, pose.rotation[i]);
+  }
+}
+
+// Bounds checked reader over the frames of one chunk
+class FrameReader {
+public:
+  FrameReader(const uint8_t *data, size_t size, const std::string &path)
+      : mData(data), mSize(size), mPath(path) {}
+
+  uint8_t byte() {
+    if (mPos >= mSize) {
+      fail();
+    }
+    return mData[mPos++];
+  }
+
+  uint64_t varint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      uint8_t next = byte();
+      value |= static_cast<uint64_t>(next & 0x7f) << shift;
+      if (!(next & 0x80)) {
+        return value;
+      }
+    }
+    fail();
+    return 0;
+  }
+
+  int64_t signedVarint() {
+    uint64_t value = varint();
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+
+  // Body ids are gap coded and must fit the body tables
+  uint32_t nextId(uint32_t previous, uint64_t gap) {
+    uint64_t id = previous + gap;
+    if (id >= Entity::Invalid) {
+      fail();
+    }
+    return static_cast<uint32_t>(id);
+  }
+
+  QuantizedPose wholePose() {
+    QuantizedPose pose;
+    for (int i = 0; i < 3; i++) {
+      pose.position[i] = static_cast<int32_t>(signedVarint());
+    }
+    pose.largest = byte();
+    if (pose.largest > 3) {
+      fail();
+    }
+    for (int i = 0; i < 3; i++) {
+      pose.rotation[i] = static_cast<int32_t>(signedVarint());
+    }
+    return pose;
+  }
+
+  size_t position() const { return mPos; }
+
+  [[noreturn]] void fail() const {
+    throw std::runtime_error("Corrupt recording " + mPath);
+  }
+
+private:
+  const uint8_t *mData;
+  size_t mSize;
+  size_t mPos = 0;
+  const std::string &mPath;
+};
+
+void WriteAll(FILE *file, const void *data, size_t size,
+              const std::string &path) {
+  if (size > 0 && std::fwrite(data, 1, size, file) != size) {
+    throw std::runtime_error("Failed to write " + path);
+  }
+}
+
+} // namespace
+
+SimulationRecorder::SimulationRecorder(const std::string &path,
+                                       float stepSeconds)
+    : mPath(path), mTempPath(path + ".tmp"), mStepSeconds(stepSeconds) {
+  mFile = std::fopen(mTempPath.c_str(), "wb");
+  if (!mFile) {
+    throw std::runtime_error("Failed to create " + mTempPath);
+  }
+  // Rewritten with the totals by finish
+  RecordingHeader header = {};
+  try {
+    WriteAll(mFile, &header, sizeof(header), mTempPath);
+  } catch (...) {
+    std::fclose(mFile);
+    std::remove(mTempPath.c_str());
+    throw;
+  }
+  mOffset = sizeof(header);
+}
+
+SimulationRecorder::~SimulationRecorder() {
+  if (!mFile) {
+    return;
+  }
+  try {
+    finish();
+  } catch (const std::exception &) {
+    // finish already removed what it wrote
+  }
+}
+
+void SimulationRecorder::addBodies(const Entity *entities, size_t count) {
+  mPendingSpawns.insert(mPendingSpawns.end(), entities, entities + count);
+}
+
+void SimulationRecorder::removeBody(Entity entity) {
+  if (entity.id >= mBodies.size()) {
+    return;
+  }
+  Body &body = mBodies[entity.id];
+  // Bodies that never made it into a frame have nothing to remove
+  if (body.live && body.generation == entity.generation) {
+    body.live = false;
+    mLiveCount--;
+    mPendingRemovals.push_back(entity.id);
+  }
+}
+
+void SimulationRecorder::writeBody(Registry &registry, uint32_t id,
+                                   bool moved) {
+  Body &body = mBodies[id];
+  Entity entity;
+  entity.id = id;
+  entity.generation = body.generation;
+  const TransformComponent *transform =
+      registry.get<TransformComponent>(entity);
+  body.pose = Quantize(transform->position, transform->rotation);
+
+  uint8_t flags = (body.rendered ? Rendered : 0) | (moved ? Moved : 0);
+  mChunk.push_back(flags);
+  WriteWholePose(mChunk, body.pose);
+}
+
+void SimulationRecorder::recordStep(Registry &registry,
+                                    const std::vector<Entity> &moved) {
+  PROFILE_SCOPE("SimulationRecorder::recordStep");
+  if (!mFile) {
+    return;
+  }
+  // Stamps are frame + 1, zero never matches
+  uint64_t stamp = mStats.frames + 1;
+  bool keyFrame = mChunkFrameCount == 0;
+  auto &transforms = registry.pool<TransformComponent>();
+  auto &renders = registry.pool<RenderComponent>();
+
+  std::sort(mPendingRemovals.begin(), mPendingRemovals.end());
+  WriteVarint(mChunk, mPendingRemovals.size());
+  uint32_t previous = 0;
+  for (uint32_t id : mPendingRemovals) {
+    WriteVarint(mChunk, id - previous);
+    previous = id;
+  }
+  mPendingRemovals.clear();
+
+  // Spawns destroyed again before the step never show up
+  mWhole.clear();
+  for (Entity entity : mPendingSpawns) {
+    if (!transforms.contains(entity)) {
+      continue;
+    }
+    if (entity.id >= mBodies.size()) {
+      mBodies.resize(entity.id + 1);
+      mMovedFrame.resize(entity.id + 1, 0);
+      mWholeFrame.resize(entity.id + 1, 0);
+    }
+    Body &body = mBodies[entity.id];
+    if (body.live) {
+      continue;
+    }
+    body.live = true;
+    body.generation = entity.generation;
+    body.rendered = renders.contains(entity);
+    mLiveCount++;
+    mWhole.push_back(entity.id);
+  }
+  mPendingSpawns.clear();
+  if (keyFrame) {
+    mWhole.clear();
+    for (uint32_t id = 0; id < mBodies.size(); id++) {
+      if (mBodies[id].live) {
+        mWhole.push_back(id);
+      }
+    }
+  } else {
+    std::sort(mWhole.begin(), mWhole.end());
+  }
+
+  mUpdates.clear();
+  for (Entity entity : moved) {
+    if (entity.id < mBodies.size() && mBodies[entity.id].live &&
+        mBodies[entity.id].generation == entity.generation &&
+        mMovedFrame[entity.id] != stamp) {
+      mMovedFrame[entity.id] = stamp;
+      mUpdates.push_back(entity.id);
+    }
+  }
+
+  WriteVarint(mChunk, mWhole.size());
+  previous = 0;
+  for (uint32_t id : mWhole) {
+    WriteVarint(mChunk, id - previous);
+    previous = id;
+    writeBody(registry, id, mMovedFrame[id] == stamp);
+    mWholeFrame[id] = stamp;
+  }
+
+  // Moved bodies not already written whole, as deltas. The low bit of the
+  // gap says the dropped rotation component changed, the rotation is then
+  // written whole.
+  mUpdates.erase(std::remove_if(mUpdates.begin(), mUpdates.end(),
+                                [&](uint32_t id) {
+                                  return mWholeFrame[id] == stamp;
+                                }),
+                 mUpdates.end());
+  std::sort(mUpdates.begin(), mUpdates.end());
+  WriteVarint(mChunk, mUpdates.size());
+  previous = 0;
+  for (uint32_t id : mUpdates) {
+    Body &body = mBodies[id];
+    Entity entity;
+    entity.id = id;
+    entity.generation = body.generation;
+    const TransformComponent *transform = transforms.tryGet(entity);
+    QuantizedPose pose = Quantize(transform->position, transform->rotation);
+    bool newLargest = pose.largest != body.pose.largest;
+
+    WriteVarint(mChunk, (uint64_t(id - previous) << 1) | newLargest);
+    previous = id;
+    for (int i = 0; i < 3; i++) {
+      WriteSigned(mChunk, int64_t(pose.position[i]) - body.pose.position[i]);
+    }
+    if (newLargest) {
+      mChunk.push_back(pose.largest);
+    }
+    for (int i = 0; i < 3; i++) {
+      WriteSigned(mChunk, newLargest ? int64_t(pose.rotation[i])
+                                     : int64_t(pose.rotation[i]) -
+                                           body.pose.rotation[i]);
+    }
+    body.pose = pose;
+  }
+
+  mStats.frames++;
+  mStats.bodyFrames += mLiveCount;
+  if (++mChunkFrameCount == recording::ChunkFrames) {
+    flushChunk();
+  }
+}
+
+void SimulationRecorder::flushChunk() {
+  if (mChunkFrameCount == 0) {
+    return;
+  }
+  RecordingChunk chunk = {};
+  chunk.firstFrame = mStats.frames - mChunkFrameCount;
+  chunk.offset = mOffset;
+  chunk.frameCount = mChunkFrameCount;
+  chunk.codec = RecordingChunk::Raw;
+  chunk.rawSize = static_cast<uint32_t>(mChunk.size());
+  chunk.storedSize = chunk.rawSize;
+
+  const uint8_t *data = mChunk.data();
+#ifdef EMBER_HAVE_ZLIB
+  uLongf compressedSize = compressBound(mChunk.size());
+  mCompressed.resize(compressedSize);
+  if (compress2(mCompressed.data(), &compressedSize, mChunk.data(),
+                mChunk.size(), Z_DEFAULT_COMPRESSION) == Z_OK &&
+      compressedSize < mChunk.size()) {
+    chunk.codec = RecordingChunk::Zlib;
+    chunk.storedSize = static_cast<uint32_t>(compressedSize);
+    data = mCompressed.data();
+  }
+#endif
+  WriteAll(mFile, data, chunk.storedSize, mTempPath);
+
+  mOffset += chunk.storedSize;
+  mStats.chunks++;
+  mStats.rawBytes += chunk.rawSize;
+  mStats.storedBytes += chunk.storedSize;
+  mChunks.push_back(chunk);
+  mChunk.clear();
+  mChunkFrameCount = 0;
+}
+
+void SimulationRecorder::finish() {
+  if (!mFile) {
+    return;
+  }
+  RecordingHeader header = {};
+  header.magic = RecordingHeader::Magic;
+  header.version = RecordingHeader::CurrentVersion;
+  header.stepSeconds = mStepSeconds;
+  header.positionScale = recording::PositionScale;
+  try {
+    flushChunk();
+    // Chunk sizes are arbitrary, the index is read in place
+    static const char zeros[alignof(RecordingChunk)] = {};
+    size_t padding = (alignof(RecordingChunk) -
+                      mOffset % alignof(RecordingChunk)) %
+                     alignof(RecordingChunk);
+    WriteAll(mFile, zeros, padding, mTempPath);
+    header.frameCount = mStats.frames;
+    header.chunkCount = mChunks.size();
+    header.indexOffset = mOffset + padding;
+    header.bodyFrames = mStats.bodyFrames;
+    header.rawBytes = mStats.rawBytes;
+    header.storedBytes = mStats.storedBytes;
+    WriteAll(mFile, mChunks.data(), mChunks.size() * sizeof(RecordingChunk),
+             mTempPath);
+    if (std::fseek(mFile, 0, SEEK_SET) != 0) {
+      throw std::runtime_error("Failed to write " + mTempPath);
+    }
+    WriteAll(mFile, &header, sizeof(header), mTempPath);
+  } catch (...) {
+    std::fclose(mFile);
+    mFile = nullptr;
+    std::remove(mTempPath.c_str());
+    throw;
+  }
+
+  bool closed = std::fclose(mFile) == 0;
+  mFile = nullptr;
+  if (!closed || std::rename(mTempPath.c_str(), mPath.c_str()) != 0) {
+    std::remove(mTempPath.c_str());
+    throw std::runtime_error("Failed to write " + mPath);
+  }
+}
+
+SimulationPlayback::SimulationPlayback(const std::string &path,
+                                       std::shared_ptr<Mesh> mesh)
+    : mPath(path), mMesh(std::move(mesh)) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open " + path);
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 ||
+      static_cast<size_t>(info.st_size) < sizeof(RecordingHeader)) {
+    ::close(fd);
+    throw std::runtime_error("Invalid recording " + path);
+  }
+  mSize = static_cast<size_t>(info.st_size);
+  mData = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mData == MAP_FAILED) {
+    mData = nullptr;
+    throw std::runtime_error("Failed to map " + path);
+  }
+
+  const uint8_t *bytes = static_cast<const uint8_t *>(mData);
+  std::memcpy(&mHeader, bytes, sizeof(mHeader));
+  bool valid = mHeader.magic == RecordingHeader::Magic &&
+               mHeader.version == RecordingHeader::CurrentVersion &&
+               mHeader.positionScale == recording::PositionScale &&
+               mHeader.stepSeconds > 0.0f &&
+               mHeader.indexOffset % alignof(RecordingChunk) == 0 &&
+               mHeader.indexOffset <= mSize &&
+               mHeader.chunkCount <= (mSize - mHeader.indexOffset) /
+                                         sizeof(RecordingChunk);
+  if (valid) {
+    mChunks = reinterpret_cast<const RecordingChunk *>(bytes +
+                                                       mHeader.indexOffset);
+    uint64_t frames = 0;
+    for (uint64_t i = 0; valid && i < mHeader.chunkCount; i++) {
+      const RecordingChunk &chunk = mChunks[i];
+      valid = chunk.firstFrame == frames && chunk.frameCount > 0 &&
+              chunk.offset <= mHeader.indexOffset &&
+              chunk.storedSize <= mHeader.indexOffset - chunk.offset &&
+              (chunk.codec == RecordingChunk::Zlib ||
+               (chunk.codec == RecordingChunk::Raw &&
+                chunk.storedSize == chunk.rawSize));
+      frames += chunk.frameCount;
+    }
+    valid = valid && frames == mHeader.frameCount;
+  }
+  if (!valid) {
+    munmap(mData, mSize);
+    throw std::runtime_error("Invalid recording " + path);
+  }
+  madvise(mData, mSize, MADV_WILLNEED);
+
+  if (mHeader.frameCount > 0) {
+    try {
+      Seek(0);
+    } catch (...) {
+      munmap(mData, mSize);
+      throw;
+    }
+  }
+}
+
+SimulationPlayback::~SimulationPlayback() {
+  if (mData) {
+    munmap(mData, mSize);
+  }
+}
+
+RecordingStats SimulationPlayback::GetStats() const {
+  RecordingStats stats;
+  stats.frames = mHeader.frameCount;
+  stats.chunks = mHeader.chunkCount;
+  stats.bodyFrames = mHeader.bodyFrames;
+  stats.rawBytes = mHeader.rawBytes;
+  stats.storedBytes = mHeader.storedBytes;
+  return stats;
+}
+
+void SimulationPlayback::Update(float frameTime) {
+  if (mHeader.frameCount == 0) {
+    return;
+  }
+  size_t last = mHeader.frameCount - 1;
+  mAccumulator += frameTime;
+  size_t steps = static_cast<size_t>(mAccumulator / mHeader.stepSeconds);
+  mAccumulator -= steps * mHeader.stepSeconds;
+
+  if (mFrame + steps >= last) {
+    if (mFrame != last) {
+      advanceTo(last);
+    }
+    // Nothing follows, show the last frame as it is
+    settle();
+    mAccumulator = 0.0f;
+    mAlpha = 1.0f;
+    return;
+  }
+  if (steps > 0) {
+    advanceTo(mFrame + steps);
+  }
+  mAlpha = mAccumulator / mHeader.stepSeconds;
+}
+
+void SimulationPlayback::Seek(size_t frame) {
+  PROFILE_SCOPE("SimulationPlayback::Seek");
+  if (mHeader.frameCount == 0) {
+    return;
+  }
+  advanceTo(std::min<size_t>(frame, mHeader.frameCount - 1));
+  settle();
+  mAccumulator = 0.0f;
+  mAlpha = 1.0f;
+}
+
+size_t SimulationPlayback::chunkOf(size_t frame) const {
+  const RecordingChunk *end = mChunks + mHeader.chunkCount;
+  const RecordingChunk *chunk = std::upper_bound(
+      mChunks, end, frame,
+      [](size_t frame, const RecordingChunk &chunk) {
+        return frame < chunk.firstFrame;
+      });
+  return static_cast<size_t>(chunk - mChunks) - 1;
+}
+
+void SimulationPlayback::loadChunk(size_t index) {
+  const RecordingChunk &chunk = mChunks[index];
+  const uint8_t *stored = static_cast<const uint8_t *>(mData) + chunk.offset;
+  if (chunk.codec == RecordingChunk::Raw) {
+    mFrameData = stored;
+  } else {
+#ifdef EMBER_HAVE_ZLIB
+    mChunkData.resize(chunk.rawSize);
+    uLongf rawSize = chunk.rawSize;
+    if (uncompress(mChunkData.data(), &rawSize, stored, chunk.storedSize) !=
+            Z_OK ||
+        rawSize != chunk.rawSize) {
+      throw std::runtime_error("Corrupt recording " + mPath);
+    }
+    mFrameData = mChunkData.data();
+#else
+    throw std::runtime_error(mPath + " is compressed, this build lacks zlib");
+#endif
+  }
+  mFrameSize = chunk.rawSize;
+  mCursor = 0;
+  mChunk = index;
+  mChunkLoaded = true;
+}
+
+void SimulationPlayback::advanceTo(size_t frame) {
+  // Decoding up to a chunk of frames is cheaper than rebuilding every
+  // entity from a key frame
+  bool continues = mChunkLoaded && frame >= mFrame &&
+                   frame - mFrame <= recording::ChunkFrames;
+  if (!continues) {
+    destroyAll();
+    size_t chunk = chunkOf(frame);
+    loadChunk(chunk);
+    mNextFrame = mChunks[chunk].firstFrame;
+  }
+  while (mNextFrame <= frame) {
+    decodeNext();
+  }
+  mFrame = frame;
+}
+
+void SimulationPlayback::decodeNext() {
+  if (mCursor >= mFrameSize) {
+    loadChunk(chunkOf(mNextFrame));
+  }
+  auto &transforms = mRegistry.pool<TransformComponent>();
+  auto &previousTransforms = mRegistry.pool<PreviousTransformComponent>();
+
+  // Bodies that moved in the last frame but not in this one came to rest,
+  // like PhysicsSystem::syncTransforms does it
+  for (uint32_t id : mMoved) {
+    TransformComponent *transform = transforms.tryGet(mEntities[id]);
+    PreviousTransformComponent *previous =
+        previousTransforms.tryGet(mEntities[id]);
+    if (transform && previous) {
+      previous->position = transform->position;
+      previous->rotation = transform->rotation;
+    }
+  }
+  mMoved.clear();
+
+  FrameReader reader(mFrameData + mCursor, mFrameSize - mCursor, mPath);
+
+  // Removals of bodies from before a key frame we started at are no-ops
+  uint64_t count = reader.varint();
+  uint32_t id = 0;
+  for (uint64_t i = 0; i < count; i++) {
+    id = reader.nextId(id, reader.varint());
+    if (id < mEntities.size() && mRegistry.valid(mEntities[id])) {
+      mRegistry.destroy(mEntities[id]);
+      mChangedEntities.push_back(mEntities[id]);
+      mEntities[id] = Entity();
+    }
+  }
+
+  count = reader.varint();
+  id = 0;
+  for (uint64_t i = 0; i < count; i++) {
+    id = reader.nextId(id, reader.varint());
+    uint8_t flags = reader.byte();
+    QuantizedPose pose = reader.wholePose();
+    if (id >= mEntities.size()) {
+      mEntities.resize(id + 1);
+      mPoses.resize(id + 1);
+    }
+    mPoses[id] = pose;
+    glm::vec3 position = DequantizePosition(pose);
+    glm::quat rotation = DequantizeRotation(pose);
+
+    Entity entity = mEntities[id];
+    if (!mRegistry.valid(entity)) {
+      entity = mRegistry.create();
+      mEntities[id] = entity;
+      mRegistry.emplace<TransformComponent>(entity, position, rotation);
+      mRegistry.emplace<PreviousTransformComponent>(entity, position,
+                                                    rotation);
+      if (mMesh && (flags & Rendered)) {
+        mRegistry.emplace<RenderComponent>(entity, mMesh);
+      }
+      mChangedEntities.push_back(entity);
+    } else if (flags & Moved) {
+      TransformComponent *transform = transforms.tryGet(entity);
+      PreviousTransformComponent *previous = previousTransforms.tryGet(entity);
+      previous->position = transform->position;
+      previous->rotation = transform->rotation;
+      transform->position = position;
+      transform->rotation = rotation;
+      mChangedEntities.push_back(entity);
+    }
+    if (flags & Moved) {
+      mMoved.push_back(id);
+    }
+  }
+
+  count = reader.varint();
+  id = 0;
+  for (uint64_t i = 0; i < count; i++) {
+    uint64_t gap = reader.varint();
+    id = reader.nextId(id, gap >> 1);
+    if (id >= mEntities.size() || !mRegistry.valid(mEntities[id])) {
+      reader.fail();
+    }
+    QuantizedPose &pose = mPoses[id];
+    for (int k = 0; k < 3; k++) {
+      pose.position[k] += static_cast<int32_t>(reader.signedVarint());
+    }
+    if (gap & 1) {
+      pose.largest = reader.byte();
+      if (pose.largest > 3) {
+        reader.fail();
+      }
+      for (int k = 0; k < 3; k++) {
+        pose.rotation[k] = static_cast<int32_t>(reader.signedVarint());
+      }
+    } else {
+      for (int k = 0; k < 3; k++) {
+        pose.rotation[k] += static_cast<int32_t>(reader.signedVarint());
+      }
+    }
+
+    Entity entity = mEntities[id];
+    TransformComponent *transform = transforms.tryGet(entity);
+    PreviousTransformComponent *previous = previousTransforms.tryGet(entity);
+    previous->position = transform->position;
+    previous->rotation = transform->rotation;
+    transform->position = DequantizePosition(pose);
+    transform->rotation = DequantizeRotation(pose);
+    mMoved.push_back(id);
+    mChangedEntities.push_back(entity);
+  }
+
+  mCursor += reader.position();
+  mNextFrame++;
+}
+
+void SimulationPlayback::settle() {
+  auto &transforms = mRegistry.pool<TransformComponent>();
+  auto &previousTransforms = mRegistry.pool<PreviousTransformComponent>();
+  for (uint32_t id : mMoved) {
+    TransformComponent *transform = transforms.tryGet(mEntities[id]);
+    PreviousTransformComponent *previous =
+        previousTransforms.tryGet(mEntities[id]);
+    if (transform && previous) {
+      previous->position = transform->position;
+      previous->rotation = transform->rotation;
+    }
+  }
+}
+
+void SimulationPlayback::destroyAll() {
+  for (Entity entity : mEntities) {
+    if (mRegistry.valid(entity)) {
+      mRegistry.destroy(entity);
+      mChangedEntities.push_back(entity);
+    }
+  }
+  mEntities.clear();
+  mPoses.clear();
+  mMoved.clear();
+}
@@ -0,0 +1,96 @@
+#include "SceneGenerators.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+std::vector<SpawnDesc> GenerateStacks(int count, int height, float spacing) {
+  std::vector<SpawnDesc> spawns(std::max(count, 0));
+  height = std::max(height, 1);
+  int columns = (count + height - 1) / height;
+  int side = (int)std::ceil(std::sqrt((float)columns));
+  for (int i = 0; i < count; i++) {
+    int column = i / height;
+    spawns[i].position = glm::vec3((column % side) * spacing,
+                                   (column / side) * spacing,
+                                   0.5f + (i % height) * 1.0f);
+  }
+  return spawns;
+}
+
+std::vector<SpawnDesc> GeneratePyramid(int baseSize) {
+  std::vector<SpawnDesc> spawns;
+  for (int layer = 0; layer < baseSize; layer++) {
+    int size = baseSize - layer;
+    // Each layer is centered on the one below it
+    float offset = layer * 0.5f;
+    for (int y = 0; y < size; y++) {
+      for (int x = 0; x < size; x++) {
+        SpawnDesc spawn;
+        spawn.position = glm::vec3(offset + x * 1.0f, offset + y * 1.0f,
+                                   0.5f + layer * 1.0f);
+        spawns.push_back(spawn);
+      }
+    }
+  }
+  return spawns;
+}
+
+std::vector<SpawnDesc> GenerateGrid(int countX, int countY, int countZ,
+                                    float spacing) {
+  std::vector<SpawnDesc> spawns;
+  spawns.reserve((size_t)countX * countY * countZ);
+  for (int z = 0; z < countZ; z++) {
+    for (int y = 0; y < countY; y++) {
+      for (int x = 0; x < countX; x++) {
+        SpawnDesc spawn;
+        spawn.position =
+            glm::vec3(x * spacing, y * spacing, 0.5f + z * spacing);
+        spawns.push_back(spawn);
+      }
+    }
+  }
+  return spawns;
+}
+
+std::vector<SpawnDesc> GenerateRandomDrop(int count, float extent,
+                                          float height, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> horizontal(-extent, extent);
+  std::uniform_real_distribution<float> vertical(2.0f, std::max(height, 2.0f));
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> angle(0.0f, glm::radians(360.0f));
+
+  std::vector<SpawnDesc> spawns(std::max(count, 0));
+  for (SpawnDesc &spawn : spawns) {
+    glm::vec3 axis =
+        glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng) + 1e-3f));
+    spawn.position = glm::vec3(horizontal(rng), horizontal(rng), vertical(rng));
+    spawn.rotation = glm::angleAxis(angle(rng), axis);
+  }
+  return spawns;
+}
+
+bool GenerateLayout(const std::string &layout, int count,
+                    std::vector<SpawnDesc> &outSpawns) {
+  if (layout == "stack") {
+    outSpawns = GenerateStacks(count);
+  } else if (layout == "pyramid") {
+    // Smallest pyramid holding at least count boxes
+    int baseSize = 1;
+    while (baseSize * (baseSize + 1) * (2 * baseSize + 1) / 6 < count) {
+      baseSize++;
+    }
+    outSpawns = GeneratePyramid(baseSize);
+  } else if (layout == "grid") {
+    int side = std::max(1, (int)std::ceil(std::cbrt((float)count)));
+    outSpawns = GenerateGrid(side, side, side);
+    outSpawns.resize(std::min<size_t>(outSpawns.size(), std::max(count, 0)));
+  } else if (layout == "drop") {
+    float extent = std::max(5.0f, std::cbrt((float)count) * 2.0f);
+    outSpawns = GenerateRandomDrop(count, extent, 2.0f + extent * 2.0f);
+  } else {
+    return false;
+  }
+  return true;
+}
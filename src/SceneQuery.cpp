@@ -0,0 +1,245 @@
+#include "SceneQuery.h"
+
+#include "PhysicsSystem.h"
+#include "Profiler.h"
+
+#include <cassert>
+
+namespace {
+
+// Queries per pool job, sized so a job outweighs scheduling it
+constexpr size_t RaycastGrain = 256;
+constexpr size_t SweepGrain = 64;
+constexpr size_t OverlapGrain = 64;
+
+PxVec3 ToPx(const glm::vec3 &v) { return PxVec3(v.x, v.y, v.z); }
+
+glm::vec3 ToGlm(const PxVec3 &v) { return glm::vec3(v.x, v.y, v.z); }
+
+PxTransform ToPxTransform(const glm::vec3 &position,
+                          const glm::quat &rotation) {
+  return PxTransform(ToPx(position),
+                     PxQuat(rotation.x, rotation.y, rotation.z, rotation.w));
+}
+
+// Holds whichever PxGeometry the shape maps to
+struct QueryGeometry {
+  PxSphereGeometry sphere;
+  PxBoxGeometry box;
+  PxCapsuleGeometry capsule;
+  const PxGeometry *geometry;
+
+  explicit QueryGeometry(const QueryShape &shape) {
+    switch (shape.type) {
+    case QueryShape::Type::Box:
+      box = PxBoxGeometry(ToPx(shape.halfExtents));
+      geometry = &box;
+      break;
+    case QueryShape::Type::Capsule:
+      capsule = PxCapsuleGeometry(shape.radius, shape.halfHeight);
+      geometry = &capsule;
+      break;
+    case QueryShape::Type::Sphere:
+    default:
+      sphere = PxSphereGeometry(shape.radius);
+      geometry = &sphere;
+      break;
+    }
+  }
+};
+
+// Drops the ignored entity before PhysX runs the exact test against it
+class IgnoreEntityFilter : public PxQueryFilterCallback {
+public:
+  IgnoreEntityFilter(Entity ignore, PxQueryHitType::Enum hitType)
+      : mIgnore(ignore), mHitType(hitType) {}
+
+  PxQueryHitType::Enum preFilter(const PxFilterData &, const PxShape *,
+                                 const PxRigidActor *actor,
+                                 PxHitFlags &) override {
+    return EntityFromUserData(actor->userData) == mIgnore
+               ? PxQueryHitType::eNONE
+               : mHitType;
+  }
+
+  // Only called with PxQueryFlag::ePOSTFILTER, which is never set
+#if PX_PHYSICS_VERSION_MAJOR >= 5
+  PxQueryHitType::Enum postFilter(const PxFilterData &, const PxQueryHit &,
+                                  const PxShape *,
+                                  const PxRigidActor *) override {
+    return mHitType;
+  }
+#else
+  PxQueryHitType::Enum postFilter(const PxFilterData &,
+                                  const PxQueryHit &) override {
+    return mHitType;
+  }
+#endif
+
+private:
+  Entity mIgnore;
+  PxQueryHitType::Enum mHitType;
+};
+
+// Flags and optional callback implementing a QueryFilter. Overlaps collect
+// touches, raycasts and sweeps a single blocking hit.
+struct FilterSetup {
+  PxQueryFilterData data;
+  IgnoreEntityFilter callback;
+  bool useCallback;
+
+  FilterSetup(const QueryFilter &filter, bool touches)
+      : callback(filter.ignore, touches ? PxQueryHitType::eTOUCH
+                                        : PxQueryHitType::eBLOCK),
+        useCallback(filter.ignore.isValid()) {
+    PxQueryFlags flags;
+    if (filter.statics) {
+      flags |= PxQueryFlag::eSTATIC;
+    }
+    if (filter.dynamics) {
+      flags |= PxQueryFlag::eDYNAMIC;
+    }
+    if (filter.anyHit) {
+      flags |= PxQueryFlag::eANY_HIT;
+    }
+    if (touches) {
+      flags |= PxQueryFlag::eNO_BLOCK;
+    }
+    if (useCallback) {
+      flags |= PxQueryFlag::ePREFILTER;
+    }
+    data = PxQueryFilterData(flags);
+  }
+
+  PxQueryFilterCallback *filterCallback() {
+    return useCallback ? &callback : nullptr;
+  }
+};
+
+template <typename Hit> QueryHit ToQueryHit(const PxHitBuffer<Hit> &buffer) {
+  QueryHit result;
+  if (!buffer.hasBlock) {
+    return result;
+  }
+  const Hit &block = buffer.block;
+  result.hit = true;
+  result.entity = EntityFromUserData(block.actor->userData);
+  result.position = ToGlm(block.position);
+  result.normal = ToGlm(block.normal);
+  result.distance = block.distance;
+  return result;
+}
+
+} // namespace
+
+void RunRaycasts(const PxScene &scene, ThreadPool &threadPool,
+                 const RaycastQuery *queries, size_t count, QueryHit *hits) {
+  PROFILE_SCOPE("RunRaycasts");
+  threadPool.parallelFor(count, RaycastGrain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      const RaycastQuery &query = queries[i];
+      hits[i] = QueryHit();
+      float length = glm::length(query.direction);
+      if (length == 0.0f) {
+        continue;
+      }
+
+      FilterSetup filter(query.filter, false);
+      PxRaycastBuffer buffer;
+      scene.raycast(ToPx(query.origin), ToPx(query.direction / length),
+                    query.maxDistance, buffer, PxHitFlag::eDEFAULT,
+                    filter.data, filter.filterCallback());
+      hits[i] = ToQueryHit(buffer);
+    }
+  });
+}
+
+void RunSweeps(const PxScene &scene, ThreadPool &threadPool,
+               const SweepQuery *queries, size_t count, QueryHit *hits) {
+  PROFILE_SCOPE("RunSweeps");
+  threadPool.parallelFor(count, SweepGrain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      const SweepQuery &query = queries[i];
+      hits[i] = QueryHit();
+      float length = glm::length(query.direction);
+      if (length == 0.0f) {
+        continue;
+      }
+
+      QueryGeometry geometry(query.shape);
+      FilterSetup filter(query.filter, false);
+      PxSweepBuffer buffer;
+      scene.sweep(*geometry.geometry,
+                  ToPxTransform(query.position, query.rotation),
+                  ToPx(query.direction / length), query.maxDistance, buffer,
+                  PxHitFlag::eDEFAULT, filter.data, filter.filterCallback());
+      hits[i] = ToQueryHit(buffer);
+    }
+  });
+}
+
+void RunOverlaps(const PxScene &scene, ThreadPool &threadPool,
+                 const OverlapQuery *queries, size_t count,
+                 OverlapResult *results, std::vector<Entity> &entities) {
+  PROFILE_SCOPE("RunOverlaps");
+  entities.clear();
+  if (count == 0) {
+    return;
+  }
+
+  // Every job fills a list of its own, the lists are joined in order after
+  // and the ranges shifted by what came before them. A pool without
+  // workers runs everything as one job.
+  size_t jobs = (count + OverlapGrain - 1) / OverlapGrain;
+  std::vector<std::vector<Entity>> jobEntities(jobs);
+  std::vector<size_t> jobEnds(jobs, 0);
+  threadPool.parallelFor(count, OverlapGrain, [&](size_t begin, size_t end) {
+    // parallelFor aligns chunks to the grain, see there
+    assert(begin % OverlapGrain == 0);
+    size_t job = begin / OverlapGrain;
+    jobEnds[job] = end;
+    std::vector<Entity> &found = jobEntities[job];
+    std::vector<PxOverlapHit> touches(OverlapResult::MaxOverlapHits);
+    for (size_t i = begin; i < end; i++) {
+      const OverlapQuery &query = queries[i];
+      QueryGeometry geometry(query.shape);
+      FilterSetup filter(query.filter, true);
+      PxOverlapBuffer buffer(touches.data(),
+                             static_cast<PxU32>(touches.size()));
+      scene.overlap(*geometry.geometry,
+                    ToPxTransform(query.position, query.rotation), buffer,
+                    filter.data, filter.filterCallback());
+
+      OverlapResult &result = results[i];
+      result.first = static_cast<uint32_t>(found.size());
+      // eANY_HIT reports its one hit as a block even with eNO_BLOCK set
+      if (buffer.hasBlock) {
+        Entity entity = EntityFromUserData(buffer.block.actor->userData);
+        if (entity.isValid()) {
+          found.push_back(entity);
+        }
+      }
+      for (PxU32 t = 0; t < buffer.getNbTouches(); t++) {
+        Entity entity = EntityFromUserData(buffer.getTouch(t).actor->userData);
+        if (entity.isValid()) {
+          found.push_back(entity);
+        }
+      }
+      result.count = static_cast<uint32_t>(found.size()) - result.first;
+    }
+  });
+
+  size_t total = 0;
+  for (const std::vector<Entity> &found : jobEntities) {
+    total += found.size();
+  }
+  entities.reserve(total);
+  for (size_t job = 0; job < jobs; job++) {
+    uint32_t offset = static_cast<uint32_t>(entities.size());
+    for (size_t i = job * OverlapGrain; i < jobEnds[job]; i++) {
+      results[i].first += offset;
+    }
+    entities.insert(entities.end(), jobEntities[job].begin(),
+                    jobEntities[job].end());
+  }
+}
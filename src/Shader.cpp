@@ -1,6 +1,8 @@
 #include "Shader.h"
 #include "glm/gtc/type_ptr.hpp"
 
+#include <chrono>
+
 // Reads a text file and outputs a string with everything in the text file
 std::string get_file_contents(const char *filename) {
   std::ifstream in(filename, std::ios::binary);
@@ -17,11 +19,42 @@ std::string get_file_contents(const char *filename) {
 }
 
 // Constructor that build the Shader Program from 2 different shaders
-Shader::Shader(const char *vertexFile, const char *fragmentFile) {
+Shader::Shader(const char *vertexFile, const char *fragmentFile,
+               const ProgramCache *cache) {
+  auto start = std::chrono::steady_clock::now();
+
   // Read vertexFile and fragmentFile and store the strings
   std::string vertexCode = get_file_contents(vertexFile);
   std::string fragmentCode = get_file_contents(fragmentFile);
 
+  uint64_t key = 0;
+  mID = 0;
+  if (cache) {
+    key = cache->key(vertexCode, fragmentCode);
+    mID = cache->load(key);
+  }
+  bool fromCache = mID != 0;
+  if (!fromCache) {
+    compileProgram(vertexCode, fragmentCode, cache != nullptr);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(mID, GL_LINK_STATUS, &linked);
+    if (cache && linked == GL_TRUE) {
+      cache->store(key, mID);
+    }
+  }
+  reflectUniforms();
+
+  float ms = std::chrono::duration<float, std::milli>(
+                 std::chrono::steady_clock::now() - start)
+                 .count();
+  std::cout << "Shader " << vertexFile << " + " << fragmentFile
+            << (fromCache ? " loaded from cache" : " compiled") << " in " << ms
+            << " ms" << std::endl;
+}
+
+void Shader::compileProgram(const std::string &vertexCode,
+                            const std::string &fragmentCode,
+                            bool retrievable) {
   // Convert the shader source strings into character arrays
   const char *vertexSource = vertexCode.c_str();
   const char *fragmentSource = fragmentCode.c_str();
@@ -46,6 +79,10 @@ Shader::Shader(const char *vertexFile, const char *fragmentFile) {
 
   // Create Shader Program Object and get its reference
   mID = glCreateProgram();
+  // Must be set before linking for glGetProgramBinary to work
+  if (retrievable) {
+    glProgramParameteri(mID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
   // Attach the Vertex and Fragment Shaders to the Shader Program
   glAttachShader(mID, vertexShader);
   glAttachShader(mID, fragmentShader);
@@ -94,27 +131,76 @@ void Shader::compileErrors(unsigned int shader, const char *type) {
   }
 }
 
+// Caches the location of every active uniform so setters never query GL
+void Shader::reflectUniforms() {
+  GLint count = 0;
+  GLint maxLength = 0;
+  glGetProgramiv(mID, GL_ACTIVE_UNIFORMS, &count);
+  glGetProgramiv(mID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+  std::string name(maxLength, '\0');
+  for (GLint i = 0; i < count; i++) {
+    GLsizei length = 0;
+    GLint size = 0;
+    GLenum type = 0;
+    glGetActiveUniform(mID, i, maxLength, &length, &size, &type, &name[0]);
+    std::string uniformName = name.substr(0, length);
+
+    // Members of uniform blocks have no location
+    GLint location = glGetUniformLocation(mID, uniformName.c_str());
+    if (location < 0) {
+      continue;
+    }
+
+    // Arrays are reported as "name[0]", make them reachable as "name" too
+    if (uniformName.size() > 3 &&
+        uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0) {
+      mUniformLocations[uniformName.substr(0, uniformName.size() - 3)] =
+          location;
+    }
+    mUniformLocations[uniformName] = location;
+  }
+}
+
 void Shader::setBool(const std::string &name, bool value) const {
-  glUniform1i(getLocation(name.c_str()), (int)value);
+  glUniform1i(getLocation(name), (int)value);
 }
 void Shader::setInt(const std::string &name, int value) const {
-  glUniform1i(getLocation(name.c_str()), value);
+  glUniform1i(getLocation(name), value);
 }
 void Shader::setFloat(const std::string &name, float value) const {
-  glUniform1f(getLocation(name.c_str()), value);
+  glUniform1f(getLocation(name), value);
 }
 void Shader::setVec3(const std::string &name, glm::vec3 &value) const {
-  glUniform3f(getLocation(name.c_str()), value.x, value.y, value.z);
+  glUniform3f(getLocation(name), value.x, value.y, value.z);
 }
 void Shader::setVec4(const std::string &name, glm::vec4 &value) const {
-  glUniform4f(getLocation(name.c_str()), value.x, value.y, value.z, value.w);
+  glUniform4f(getLocation(name), value.x, value.y, value.z, value.w);
 }
 void Shader::setMat4(const std::string &name, glm::mat4 &value) const {
-  glUniformMatrix4fv(getLocation(name.c_str()), 1, GL_FALSE,
-                     glm::value_ptr(value));
+  glUniformMatrix4fv(getLocation(name), 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::set(Uniform<bool> uniform, bool value) const {
+  glUniform1i(uniform.location, (int)value);
+}
+void Shader::set(Uniform<int> uniform, int value) const {
+  glUniform1i(uniform.location, value);
+}
+void Shader::set(Uniform<float> uniform, float value) const {
+  glUniform1f(uniform.location, value);
+}
+void Shader::set(Uniform<glm::vec3> uniform, const glm::vec3 &value) const {
+  glUniform3f(uniform.location, value.x, value.y, value.z);
+}
+void Shader::set(Uniform<glm::vec4> uniform, const glm::vec4 &value) const {
+  glUniform4f(uniform.location, value.x, value.y, value.z, value.w);
+}
+void Shader::set(Uniform<glm::mat4> uniform, const glm::mat4 &value) const {
+  glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(value));
 }
 
 int Shader::getLocation(const std::string &name) const {
-  int location = glGetUniformLocation(mID, name.c_str());
-  return location;
+  auto it = mUniformLocations.find(name);
+  return it != mUniformLocations.end() ? it->second : -1;
 }
@@ -0,0 +1,203 @@
+#include "ThreadPool.h"
+
+#include "Profiler.h"
+
+#include <iostream>
+#include <string>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+// Identifies the pool and queue of the calling worker thread
+thread_local ThreadPool *tPool = nullptr;
+thread_local int tWorkerIndex = -1;
+} // namespace
+
+ThreadPool::ThreadPool(const ThreadPoolDesc &desc) : mDesc(desc) {
+  unsigned workerCount = desc.workerCount;
+  if (workerCount == 0) {
+    unsigned hardwareThreads = std::thread::hardware_concurrency();
+    workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+  }
+
+  for (unsigned i = 0; i < workerCount; i++) {
+    mQueues.push_back(std::make_unique<WorkerQueue>());
+  }
+  for (unsigned i = 0; i < workerCount; i++) {
+    mWorkers.emplace_back(&ThreadPool::workerMain, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mSleepMutex);
+    mStopping = true;
+  }
+  mWakeUp.notify_all();
+  for (auto &worker : mWorkers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::submitTask(PxBaseTask &task) {
+  Job job;
+  job.task = &task;
+  push(std::move(job));
+}
+
+void ThreadPool::submit(std::function<void()> function, TaskGroup *group) {
+  if (group) {
+    group->mPending.fetch_add(1, std::memory_order_relaxed);
+  }
+  Job job;
+  job.function = std::move(function);
+  job.group = group;
+  push(std::move(job));
+}
+
+void ThreadPool::wait(TaskGroup &group) {
+  while (!group.done()) {
+    Job job;
+    if (pop(job)) {
+      run(job);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void ThreadPool::push(Job job) {
+  // Without workers everything runs inline on the submitting thread
+  if (mWorkers.empty()) {
+    run(job);
+    return;
+  }
+
+  WorkerQueue &queue = (tPool == this) ? *mQueues[tWorkerIndex] : mInjectQueue;
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.jobs.push_back(std::move(job));
+  }
+  mQueued.fetch_add(1, std::memory_order_release);
+
+  // Taking the sleep mutex orders this notify after a worker's predicate
+  // check, so a worker about to sleep cannot miss the new job
+  { std::lock_guard<std::mutex> lock(mSleepMutex); }
+  mWakeUp.notify_one();
+}
+
+bool ThreadPool::pop(Job &job) {
+  if (mQueued.load(std::memory_order_acquire) == 0) {
+    return false;
+  }
+
+  // Own queue first, newest job is the one most likely still in cache
+  int self = (tPool == this) ? tWorkerIndex : -1;
+  if (self >= 0) {
+    WorkerQueue &queue = *mQueues[self];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.jobs.empty()) {
+      job = std::move(queue.jobs.back());
+      queue.jobs.pop_back();
+      mQueued.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mInjectQueue.mutex);
+    if (!mInjectQueue.jobs.empty()) {
+      job = std::move(mInjectQueue.jobs.front());
+      mInjectQueue.jobs.pop_front();
+      mQueued.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+
+  // Steal the oldest job of another worker
+  size_t count = mQueues.size();
+  size_t start = self >= 0 ? self + 1 : 0;
+  for (size_t i = 0; i < count; i++) {
+    size_t victim = (start + i) % count;
+    if ((int)victim == self) {
+      continue;
+    }
+    WorkerQueue &queue = *mQueues[victim];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.jobs.empty()) {
+      job = std::move(queue.jobs.front());
+      queue.jobs.pop_front();
+      mQueued.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::run(Job &job) {
+  if (job.task) {
+    // PhysX names its tasks with string literals, they outlive the task
+    PROFILE_SCOPE(job.task->getName());
+    // Dispatcher contract: run, then release to notify dependents
+    job.task->run();
+    job.task->release();
+  } else {
+    PROFILE_SCOPE("ThreadPool job");
+    job.function();
+  }
+  if (job.group) {
+    job.group->mPending.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+void ThreadPool::workerMain(unsigned index) {
+  tPool = this;
+  tWorkerIndex = index;
+  configureWorker(index);
+
+  while (true) {
+    Job job;
+    if (pop(job)) {
+      run(job);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mSleepMutex);
+    mWakeUp.wait(lock, [this]() {
+      return mStopping || mQueued.load(std::memory_order_acquire) > 0;
+    });
+    if (mStopping) {
+      return;
+    }
+  }
+}
+
+void ThreadPool::configureWorker(unsigned index) {
+  std::string name = "ember-worker-" + std::to_string(index);
+  pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+  Profiler::get().setThreadName(name);
+
+  if (mDesc.pinWorkers) {
+    long cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpuCount > 0) {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET((mDesc.firstCpu + index) % cpuCount, &cpus);
+      if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+        std::cout << "Failed to pin " << name << std::endl;
+      }
+    }
+  }
+
+  if (mDesc.niceLevel != 0) {
+    // On Linux nice values are per thread when addressed by thread id
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    if (setpriority(PRIO_PROCESS, tid, mDesc.niceLevel) != 0) {
+      std::cout << "Failed to set priority of " << name << std::endl;
+    }
+  }
+}
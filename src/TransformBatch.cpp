@@ -0,0 +1,228 @@
+#include "TransformBatch.h"
+
+#include "Transform.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define EMBER_TRANSFORM_SSE 1
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#define EMBER_TRANSFORM_AVX 1
+#endif
+
+namespace {
+
+// Upper 3x3 of BasisConversion(), row major. Folding it in turns
+// B * T(p) * R(q) into a 3x4 matrix [B * R(q) | B * p].
+struct Basis {
+  float m[3][3];
+
+  Basis() {
+    const glm::mat4 &basis = BasisConversion();
+    for (int row = 0; row < 3; row++) {
+      for (int col = 0; col < 3; col++) {
+        m[row][col] = basis[col][row];
+      }
+    }
+  }
+};
+
+const Basis &GetBasis() {
+  static const Basis basis;
+  return basis;
+}
+
+// The kernel is written once against these minimal vector types. Width
+// transforms are processed per iteration.
+struct ScalarOps {
+  using V = float;
+  static constexpr size_t Width = 1;
+  static V load(const float *p) { return *p; }
+  static V set(float v) { return v; }
+  static V add(V a, V b) { return a + b; }
+  static V sub(V a, V b) { return a - b; }
+  static V mul(V a, V b) { return a * b; }
+
+  // columns[c][row] holds row of column c of the 3x4 matrix
+  static void store(const V columns[4][3], float *out) {
+    for (int c = 0; c < 4; c++) {
+      out[c * 4 + 0] = columns[c][0];
+      out[c * 4 + 1] = columns[c][1];
+      out[c * 4 + 2] = columns[c][2];
+      out[c * 4 + 3] = c == 3 ? 1.0f : 0.0f;
+    }
+  }
+};
+
+#ifdef EMBER_TRANSFORM_SSE
+// Four rows of one column, one lane per transform, become one column of
+// four consecutive matrices
+inline void StoreColumnSSE(__m128 r0, __m128 r1, __m128 r2, __m128 r3,
+                           float *out) {
+  _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+  _mm_storeu_ps(out, r0);
+  _mm_storeu_ps(out + 16, r1);
+  _mm_storeu_ps(out + 32, r2);
+  _mm_storeu_ps(out + 48, r3);
+}
+
+struct SseOps {
+  using V = __m128;
+  static constexpr size_t Width = 4;
+  static V load(const float *p) { return _mm_loadu_ps(p); }
+  static V set(float v) { return _mm_set1_ps(v); }
+  static V add(V a, V b) { return _mm_add_ps(a, b); }
+  static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+  static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+
+  static void store(const V columns[4][3], float *out) {
+    for (int c = 0; c < 4; c++) {
+      __m128 w = _mm_set1_ps(c == 3 ? 1.0f : 0.0f);
+      StoreColumnSSE(columns[c][0], columns[c][1], columns[c][2], w,
+                     out + c * 4);
+    }
+  }
+};
+#endif
+
+#ifdef EMBER_TRANSFORM_AVX
+struct AvxOps {
+  using V = __m256;
+  static constexpr size_t Width = 8;
+  static V load(const float *p) { return _mm256_loadu_ps(p); }
+  static V set(float v) { return _mm256_set1_ps(v); }
+  static V add(V a, V b) { return _mm256_add_ps(a, b); }
+  static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+  static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+
+  // The transpose is done per 128 bit half, four matrices each
+  static void store(const V columns[4][3], float *out) {
+    for (int c = 0; c < 4; c++) {
+      __m128 w = _mm_set1_ps(c == 3 ? 1.0f : 0.0f);
+      StoreColumnSSE(_mm256_castps256_ps128(columns[c][0]),
+                     _mm256_castps256_ps128(columns[c][1]),
+                     _mm256_castps256_ps128(columns[c][2]), w, out + c * 4);
+      StoreColumnSSE(_mm256_extractf128_ps(columns[c][0], 1),
+                     _mm256_extractf128_ps(columns[c][1], 1),
+                     _mm256_extractf128_ps(columns[c][2], 1), w,
+                     out + 64 + c * 4);
+    }
+  }
+};
+#endif
+
+// Builds matrices for as many full groups of Ops::Width transforms as fit
+// in [begin, end) and returns the index of the first one left over
+template <typename Ops>
+size_t BuildRange(const TransformBatch &batch, size_t begin, size_t end,
+                  float *out) {
+  using V = typename Ops::V;
+  const Basis &basis = GetBasis();
+  V b[3][3];
+  for (int row = 0; row < 3; row++) {
+    for (int col = 0; col < 3; col++) {
+      b[row][col] = Ops::set(basis.m[row][col]);
+    }
+  }
+  const V one = Ops::set(1.0f);
+
+  size_t i = begin;
+  for (; i + Ops::Width <= end; i += Ops::Width) {
+    V x = Ops::load(&batch.qx[i]);
+    V y = Ops::load(&batch.qy[i]);
+    V z = Ops::load(&batch.qz[i]);
+    V w = Ops::load(&batch.qw[i]);
+
+    // Same terms as glm::mat3_cast
+    V x2 = Ops::add(x, x), y2 = Ops::add(y, y), z2 = Ops::add(z, z);
+    V xx = Ops::mul(x, x2), yy = Ops::mul(y, y2), zz = Ops::mul(z, z2);
+    V xy = Ops::mul(x, y2), xz = Ops::mul(x, z2), yz = Ops::mul(y, z2);
+    V wx = Ops::mul(w, x2), wy = Ops::mul(w, y2), wz = Ops::mul(w, z2);
+
+    // r[row][col] of the rotation
+    V r[3][3];
+    r[0][0] = Ops::sub(one, Ops::add(yy, zz));
+    r[1][0] = Ops::add(xy, wz);
+    r[2][0] = Ops::sub(xz, wy);
+    r[0][1] = Ops::sub(xy, wz);
+    r[1][1] = Ops::sub(one, Ops::add(xx, zz));
+    r[2][1] = Ops::add(yz, wx);
+    r[0][2] = Ops::add(xz, wy);
+    r[1][2] = Ops::sub(yz, wx);
+    r[2][2] = Ops::sub(one, Ops::add(xx, yy));
+
+    V p[3] = {Ops::load(&batch.px[i]), Ops::load(&batch.py[i]),
+              Ops::load(&batch.pz[i])};
+
+    // columns[c][row] of B * R, then B * p as the fourth column
+    V columns[4][3];
+    for (int row = 0; row < 3; row++) {
+      for (int col = 0; col < 3; col++) {
+        columns[col][row] =
+            Ops::add(Ops::add(Ops::mul(b[row][0], r[0][col]),
+                              Ops::mul(b[row][1], r[1][col])),
+                     Ops::mul(b[row][2], r[2][col]));
+      }
+      columns[3][row] = Ops::add(
+          Ops::add(Ops::mul(b[row][0], p[0]), Ops::mul(b[row][1], p[1])),
+          Ops::mul(b[row][2], p[2]));
+    }
+
+    Ops::store(columns, out + i * 16);
+  }
+  return i;
+}
+
+} // namespace
+
+SimdLevel BestSimdLevel() {
+#if defined(EMBER_TRANSFORM_AVX)
+  return SimdLevel::AVX;
+#elif defined(EMBER_TRANSFORM_SSE)
+  return SimdLevel::SSE2;
+#else
+  return SimdLevel::Scalar;
+#endif
+}
+
+const char *SimdLevelName(SimdLevel level) {
+  switch (level) {
+  case SimdLevel::AVX:
+    return "avx";
+  case SimdLevel::SSE2:
+    return "sse2";
+  default:
+    return "scalar";
+  }
+}
+
+void BuildModelMatrices(const TransformBatch &batch, glm::mat4 *out) {
+  BuildModelMatrices(batch, out, BestSimdLevel());
+}
+
+void BuildModelMatrices(const TransformBatch &batch, glm::mat4 *out,
+                        SimdLevel level) {
+  size_t count = batch.size();
+  if (count == 0) {
+    return;
+  }
+  float *dst = &out[0][0][0];
+  size_t done = 0;
+  level = std::min(level, BestSimdLevel());
+
+  // Wide kernels first, the narrower ones take the remainder
+#ifdef EMBER_TRANSFORM_AVX
+  if (level >= SimdLevel::AVX) {
+    done = BuildRange<AvxOps>(batch, done, count, dst);
+  }
+#endif
+#ifdef EMBER_TRANSFORM_SSE
+  if (level >= SimdLevel::SSE2) {
+    done = BuildRange<SseOps>(batch, done, count, dst);
+  }
+#endif
+  BuildRange<ScalarOps>(batch, done, count, dst);
+}
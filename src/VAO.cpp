@@ -3,13 +3,32 @@
 VAO::VAO() { glGenVertexArrays(1, &ID); }
 
 void VAO::LinkAttrib(VBO &VBO, GLuint layout, GLuint numComponents, GLenum type,
-                     GLsizeiptr stride, void *offset) {
+                     GLsizeiptr stride, void *offset, GLboolean normalized) {
   VBO.Bind();
-  glVertexAttribPointer(layout, numComponents, type, GL_FALSE, stride, offset);
+  glVertexAttribPointer(layout, numComponents, type, normalized, stride,
+                        offset);
   glEnableVertexAttribArray(layout);
   VBO.Unbind();
 }
 
+void VAO::LinkLayout(VBO &VBO, const VertexLayout &layout) {
+  for (const VertexAttribute &attribute : layout.attributes) {
+    LinkAttrib(VBO, attribute.location, attribute.components, attribute.type,
+               layout.stride, (void *)attribute.offset, attribute.normalized);
+  }
+}
+
+void VAO::LinkInstanceMat4(VBO &VBO, GLuint layout) {
+  VBO.Bind();
+  for (GLuint i = 0; i < 4; i++) {
+    glVertexAttribPointer(layout + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                          (void *)(i * sizeof(glm::vec4)));
+    glEnableVertexAttribArray(layout + i);
+    glVertexAttribDivisor(layout + i, 1);
+  }
+  VBO.Unbind();
+}
+
 void VAO::Bind() { glBindVertexArray(ID); }
 void VAO::Unbind() { glBindVertexArray(0); }
 void VAO::Delete() { glDeleteVertexArrays(1, &ID); }
@@ -7,6 +7,17 @@ VBO::VBO(std::vector<Vertex> &vertices) {
                vertices.data(), GL_STATIC_DRAW);
 }
 
+VBO::VBO(GLsizeiptr size, const void *data, GLenum usage) {
+  glGenBuffers(1, &ID);
+  glBindBuffer(GL_ARRAY_BUFFER, ID);
+  glBufferData(GL_ARRAY_BUFFER, size, data, usage);
+}
+
+void VBO::Upload(GLsizeiptr size, const void *data, GLenum usage) {
+  glBindBuffer(GL_ARRAY_BUFFER, ID);
+  glBufferData(GL_ARRAY_BUFFER, size, data, usage);
+}
+
 void VBO::Bind() { glBindBuffer(GL_ARRAY_BUFFER, ID); }
 void VBO::Unbind() { glBindBuffer(GL_ARRAY_BUFFER, 0); }
 void VBO::Delete() { glDeleteBuffers(1, &ID); }
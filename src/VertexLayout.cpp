@@ -0,0 +1,148 @@
+#include "VertexLayout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const VertexLayout &GetVertexLayout(VertexFormat format) {
+  static const VertexLayout floatLayout = {
+      sizeof(Vertex),
+      {
+          {0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Position)},
+          {1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Color)},
+          {2, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Normal)},
+      }};
+  static const VertexLayout packedLayout = {
+      sizeof(PackedVertex),
+      {
+          {0, 3, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, Position)},
+          // Alpha is dropped by the vec3 aColor input
+          {1, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(PackedVertex, Color)},
+          {2, 4, GL_INT_2_10_10_10_REV, GL_TRUE,
+           offsetof(PackedVertex, Normal)},
+      }};
+  return format == VertexFormat::Packed ? packedLayout : floatLayout;
+}
+
+size_t VertexStride(VertexFormat format) {
+  return static_cast<size_t>(GetVertexLayout(format).stride);
+}
+
+bool IsValidVertexFormat(uint32_t format) {
+  return format == static_cast<uint32_t>(VertexFormat::Float) ||
+         format == static_cast<uint32_t>(VertexFormat::Packed);
+}
+
+uint16_t FloatToHalf(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  uint32_t sign = (bits >> 16) & 0x8000;
+  uint32_t exponent = (bits >> 23) & 0xff;
+  uint32_t mantissa = bits & 0x7fffff;
+
+  // Inf and NaN
+  if (exponent == 0xff) {
+    return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+  }
+
+  int halfExponent = static_cast<int>(exponent) - 127 + 15;
+  if (halfExponent >= 0x1f) {
+    return static_cast<uint16_t>(sign | 0x7c00);
+  }
+  if (halfExponent <= 0) {
+    // Subnormal half, or too small for one
+    if (halfExponent < -10) {
+      return static_cast<uint16_t>(sign);
+    }
+    mantissa |= 0x800000;
+    int shift = 14 - halfExponent;
+    uint32_t half = mantissa >> shift;
+    uint32_t rest = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half & 1))) {
+      half++;
+    }
+    return static_cast<uint16_t>(sign | half);
+  }
+
+  // Round to nearest even, a carry out of the mantissa bumps the exponent
+  uint32_t half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+  uint32_t rest = mantissa & 0x1fff;
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+    half++;
+  }
+  return static_cast<uint16_t>(sign | half);
+}
+
+float HalfToFloat(uint16_t value) {
+  uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+  uint32_t exponent = (value >> 10) & 0x1f;
+  uint32_t mantissa = value & 0x3ff;
+
+  uint32_t bits;
+  if (exponent == 0) {
+    float magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+    return sign ? -magnitude : magnitude;
+  } else if (exponent == 0x1f) {
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  }
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+namespace {
+
+uint32_t PackSnorm10(float value) {
+  float clamped = std::min(std::max(value, -1.0f), 1.0f);
+  return static_cast<uint32_t>(static_cast<int32_t>(std::lround(clamped * 511.0f))) &
+         0x3ff;
+}
+
+float UnpackSnorm10(uint32_t bits) {
+  // Sign extend the 10 bit field
+  int32_t value = static_cast<int32_t>(bits << 22) >> 22;
+  return std::max(value / 511.0f, -1.0f);
+}
+
+uint32_t PackUnorm8(float value) {
+  float clamped = std::min(std::max(value, 0.0f), 1.0f);
+  return static_cast<uint32_t>(std::lround(clamped * 255.0f));
+}
+
+} // namespace
+
+PackedVertex PackVertex(const Vertex &vertex) {
+  PackedVertex packed;
+  for (int i = 0; i < 3; i++) {
+    packed.Position[i] = FloatToHalf(vertex.Position[i]);
+  }
+  packed.Padding = 0;
+  packed.Normal = PackSnorm10(vertex.Normal.x) |
+                  (PackSnorm10(vertex.Normal.y) << 10) |
+                  (PackSnorm10(vertex.Normal.z) << 20);
+  // Bytes r, g, b, a in memory
+  packed.Color = PackUnorm8(vertex.Color.x) | (PackUnorm8(vertex.Color.y) << 8) |
+                 (PackUnorm8(vertex.Color.z) << 16) | (255u << 24);
+  return packed;
+}
+
+Vertex UnpackVertex(const PackedVertex &vertex) {
+  Vertex unpacked;
+  for (int i = 0; i < 3; i++) {
+    unpacked.Position[i] = HalfToFloat(vertex.Position[i]);
+    unpacked.Normal[i] = UnpackSnorm10(vertex.Normal >> (10 * i));
+    unpacked.Color[i] = ((vertex.Color >> (8 * i)) & 0xff) / 255.0f;
+  }
+  return unpacked;
+}
+
+std::vector<PackedVertex> PackVertices(const Vertex *vertices, size_t count) {
+  std::vector<PackedVertex> packed(count);
+  for (size_t i = 0; i < count; i++) {
+    packed[i] = PackVertex(vertices[i]);
+  }
+  return packed;
+}
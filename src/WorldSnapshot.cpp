@@ -0,0 +1,340 @@
+#include "WorldSnapshot.h"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint64_t RecordAlignment = 16;
+// createCollectionFromBinary rejects anything less aligned
+constexpr uint64_t CollectionAlignment = PX_SERIAL_FILE_ALIGN;
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+struct PxReleaseDeleter {
+  template <typename T> void operator()(T *object) const {
+    object->release();
+  }
+};
+template <typename T> using PxPtr = std::unique_ptr<T, PxReleaseDeleter>;
+
+// Ids of the external references and actors inside one snapshot. Zero is
+// PX_SERIAL_OBJECT_ID_INVALID.
+PxSerialObjectId MaterialId(uint64_t index) { return 1 + index; }
+PxSerialObjectId ShapeId(const WorldSnapshotHeader &header, uint64_t index) {
+  return 1 + header.materialCount + index;
+}
+PxSerialObjectId ActorId(const WorldSnapshotHeader &header, uint64_t index) {
+  return 1 + header.materialCount + header.shapeCount + index;
+}
+
+// Parameters of a shape PhysicsAssetCache can hand out again, false for
+// anything else
+bool DescribeShape(PxShape &shape, SnapshotShape &out) {
+  if (shape.isExclusive() || shape.getNbMaterials() != 1) {
+    return false;
+  }
+  PxGeometryHolder geometry(shape.getGeometry());
+  out.type = static_cast<uint32_t>(geometry.getType());
+  out.params[0] = out.params[1] = out.params[2] = 0.0f;
+  switch (geometry.getType()) {
+  case PxGeometryType::eBOX:
+    out.params[0] = geometry.box().halfExtents.x;
+    out.params[1] = geometry.box().halfExtents.y;
+    out.params[2] = geometry.box().halfExtents.z;
+    return true;
+  case PxGeometryType::eSPHERE:
+    out.params[0] = geometry.sphere().radius;
+    return true;
+  case PxGeometryType::eCAPSULE:
+    out.params[0] = geometry.capsule().radius;
+    out.params[1] = geometry.capsule().halfHeight;
+    return true;
+  default:
+    return false;
+  }
+}
+
+PxShape *CreateShape(PhysicsAssetCache &cache, const SnapshotShape &shape,
+                     PxMaterial &material) {
+  switch (shape.type) {
+  case PxGeometryType::eBOX:
+    return cache.getBoxShape(
+        PxVec3(shape.params[0], shape.params[1], shape.params[2]), material);
+  case PxGeometryType::eSPHERE:
+    return cache.getSphereShape(shape.params[0], material);
+  case PxGeometryType::eCAPSULE:
+    return cache.getCapsuleShape(shape.params[0], shape.params[1], material);
+  default:
+    return nullptr;
+  }
+}
+
+void WriteAll(FILE *file, const void *data, size_t size,
+              const std::string &path) {
+  if (size > 0 && std::fwrite(data, 1, size, file) != size) {
+    throw std::runtime_error("Failed to write " + path);
+  }
+}
+
+void WritePadding(FILE *file, uint64_t from, uint64_t to,
+                  const std::string &path) {
+  static const char zeros[CollectionAlignment] = {};
+  WriteAll(file, zeros, static_cast<size_t>(to - from), path);
+}
+
+bool RangeInFile(uint64_t offset, uint64_t count, uint64_t size,
+                 uint64_t fileSize) {
+  return offset % RecordAlignment == 0 && offset <= fileSize &&
+         count <= (fileSize - offset) / size;
+}
+
+} // namespace
+
+void WriteWorldSnapshot(const std::string &path, PhysicsSystem &physics,
+                        const SnapshotBody *bodies,
+                        PxRigidDynamic *const *actors, size_t count) {
+  PROFILE_SCOPE("WriteWorldSnapshot");
+  if (physics.isSimulating()) {
+    throw std::runtime_error("Cannot save the scene while it simulates.");
+  }
+
+  // Cached shapes and their materials become external references
+  std::vector<SnapshotMaterial> materials;
+  std::vector<SnapshotShape> shapes;
+  std::vector<PxMaterial *> materialObjects;
+  std::vector<PxShape *> shapeObjects;
+  std::unordered_map<PxMaterial *, uint32_t> materialIndices;
+  std::unordered_map<PxShape *, uint32_t> shapeIndices;
+  for (size_t i = 0; i < count; i++) {
+    // Shapes past these are serialized with their actor instead
+    PxShape *actorShapes[8];
+    PxU32 shapeCount = actors[i]->getShapes(actorShapes, 8);
+    for (PxU32 s = 0; s < shapeCount; s++) {
+      PxShape *shape = actorShapes[s];
+      SnapshotShape record;
+      if (shapeIndices.count(shape) || !DescribeShape(*shape, record)) {
+        continue;
+      }
+      PxMaterial *material = nullptr;
+      shape->getMaterials(&material, 1);
+      auto inserted = materialIndices.emplace(
+          material, static_cast<uint32_t>(materials.size()));
+      if (inserted.second) {
+        materials.push_back({material->getStaticFriction(),
+                             material->getDynamicFriction(),
+                             material->getRestitution()});
+        materialObjects.push_back(material);
+      }
+      record.material = inserted.first->second;
+      shapeIndices.emplace(shape, static_cast<uint32_t>(shapes.size()));
+      shapes.push_back(record);
+      shapeObjects.push_back(shape);
+    }
+  }
+
+  WorldSnapshotHeader header = {};
+  header.magic = WorldSnapshotHeader::Magic;
+  header.version = WorldSnapshotHeader::CurrentVersion;
+  header.physxVersion = PX_PHYSICS_VERSION;
+  header.materialCount = materials.size();
+  header.shapeCount = shapes.size();
+  header.bodyCount = count;
+
+  PxPtr<PxSerializationRegistry> registry(
+      PxSerialization::createSerializationRegistry(physics.getPhysics()));
+  PxPtr<PxCollection> external(PxCreateCollection());
+  PxPtr<PxCollection> collection(PxCreateCollection());
+  for (size_t i = 0; i < materialObjects.size(); i++) {
+    external->add(*materialObjects[i], MaterialId(i));
+  }
+  for (size_t i = 0; i < shapeObjects.size(); i++) {
+    external->add(*shapeObjects[i], ShapeId(header, i));
+  }
+  for (size_t i = 0; i < count; i++) {
+    collection->add(*actors[i], ActorId(header, i));
+  }
+  // Pulls in whatever else the actors need, e.g. shapes not from the cache
+  PxSerialization::complete(*collection, *registry, external.get());
+  if (!PxSerialization::isSerializable(*collection, *registry,
+                                       external.get())) {
+    throw std::runtime_error("Scene can't be serialized to " + path);
+  }
+  PxDefaultMemoryOutputStream stream;
+  if (!PxSerialization::serializeCollectionToBinary(stream, *collection,
+                                                    *registry,
+                                                    external.get())) {
+    throw std::runtime_error("Failed to serialize the scene to " + path);
+  }
+
+  header.materialOffset =
+      AlignUp(sizeof(WorldSnapshotHeader), RecordAlignment);
+  header.shapeOffset = AlignUp(
+      header.materialOffset + materials.size() * sizeof(SnapshotMaterial),
+      RecordAlignment);
+  header.bodyOffset =
+      AlignUp(header.shapeOffset + shapes.size() * sizeof(SnapshotShape),
+              RecordAlignment);
+  uint64_t bodyEnd = header.bodyOffset + count * sizeof(SnapshotBody);
+  header.collectionOffset = AlignUp(bodyEnd, CollectionAlignment);
+  header.collectionSize = stream.getSize();
+
+  std::string tempPath = path + ".tmp";
+  FILE *file = std::fopen(tempPath.c_str(), "wb");
+  if (!file) {
+    throw std::runtime_error("Failed to create " + tempPath);
+  }
+  try {
+    uint64_t materialEnd =
+        header.materialOffset + materials.size() * sizeof(SnapshotMaterial);
+    uint64_t shapeEnd =
+        header.shapeOffset + shapes.size() * sizeof(SnapshotShape);
+    WriteAll(file, &header, sizeof(header), tempPath);
+    WritePadding(file, sizeof(header), header.materialOffset, tempPath);
+    WriteAll(file, materials.data(),
+             materials.size() * sizeof(SnapshotMaterial), tempPath);
+    WritePadding(file, materialEnd, header.shapeOffset, tempPath);
+    WriteAll(file, shapes.data(), shapes.size() * sizeof(SnapshotShape),
+             tempPath);
+    WritePadding(file, shapeEnd, header.bodyOffset, tempPath);
+    WriteAll(file, bodies, count * sizeof(SnapshotBody), tempPath);
+    WritePadding(file, bodyEnd, header.collectionOffset, tempPath);
+    WriteAll(file, stream.getData(), stream.getSize(), tempPath);
+  } catch (...) {
+    std::fclose(file);
+    std::remove(tempPath.c_str());
+    throw;
+  }
+  if (std::fclose(file) != 0 ||
+      std::rename(tempPath.c_str(), path.c_str()) != 0) {
+    std::remove(tempPath.c_str());
+    throw std::runtime_error("Failed to write " + path);
+  }
+}
+
+LoadedSnapshot ReadWorldSnapshot(const std::string &path,
+                                 PhysicsSystem &physics) {
+  PROFILE_SCOPE("ReadWorldSnapshot");
+  if (physics.isSimulating()) {
+    throw std::runtime_error("Cannot load into the scene while it simulates.");
+  }
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open " + path);
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 ||
+      static_cast<size_t>(info.st_size) < sizeof(WorldSnapshotHeader)) {
+    ::close(fd);
+    throw std::runtime_error("Invalid snapshot " + path);
+  }
+  size_t size = static_cast<size_t>(info.st_size);
+  // PhysX patches pointers in place, private pages take those writes
+  void *data =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file alive
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    throw std::runtime_error("Failed to map " + path);
+  }
+  madvise(data, size, MADV_WILLNEED);
+  std::shared_ptr<void> mapping(data,
+                                [size](void *data) { munmap(data, size); });
+  char *bytes = static_cast<char *>(data);
+
+  const WorldSnapshotHeader &header =
+      *reinterpret_cast<const WorldSnapshotHeader *>(bytes);
+  bool valid =
+      header.magic == WorldSnapshotHeader::Magic &&
+      header.version == WorldSnapshotHeader::CurrentVersion &&
+      header.physxVersion == PX_PHYSICS_VERSION &&
+      RangeInFile(header.materialOffset, header.materialCount,
+                  sizeof(SnapshotMaterial), size) &&
+      RangeInFile(header.shapeOffset, header.shapeCount,
+                  sizeof(SnapshotShape), size) &&
+      RangeInFile(header.bodyOffset, header.bodyCount, sizeof(SnapshotBody),
+                  size) &&
+      header.collectionOffset % CollectionAlignment == 0 &&
+      header.collectionOffset <= size &&
+      header.collectionSize <= size - header.collectionOffset;
+  if (!valid) {
+    throw std::runtime_error("Invalid snapshot " + path);
+  }
+
+  const SnapshotMaterial *materials =
+      reinterpret_cast<const SnapshotMaterial *>(bytes +
+                                                 header.materialOffset);
+  const SnapshotShape *shapes =
+      reinterpret_cast<const SnapshotShape *>(bytes + header.shapeOffset);
+  PhysicsAssetCache &cache = physics.GetAssetCache();
+  PxPtr<PxCollection> external(PxCreateCollection());
+  std::vector<PxMaterial *> materialObjects(header.materialCount);
+  for (uint64_t i = 0; i < header.materialCount; i++) {
+    materialObjects[i] = cache.getMaterial(materials[i].staticFriction,
+                                           materials[i].dynamicFriction,
+                                           materials[i].restitution);
+    external->add(*materialObjects[i], MaterialId(i));
+  }
+  for (uint64_t i = 0; i < header.shapeCount; i++) {
+    PxShape *shape =
+        shapes[i].material < header.materialCount
+            ? CreateShape(cache, shapes[i],
+                          *materialObjects[shapes[i].material])
+            : nullptr;
+    if (!shape) {
+      throw std::runtime_error("Invalid snapshot " + path);
+    }
+    external->add(*shape, ShapeId(header, i));
+  }
+
+  PxPtr<PxSerializationRegistry> registry(
+      PxSerialization::createSerializationRegistry(physics.getPhysics()));
+  PxPtr<PxCollection> collection(PxSerialization::createCollectionFromBinary(
+      bytes + header.collectionOffset, *registry, external.get()));
+  if (!collection) {
+    throw std::runtime_error("PhysX rejected the collection in " + path);
+  }
+
+  LoadedSnapshot loaded;
+  loaded.count = header.bodyCount;
+  loaded.bodies =
+      reinterpret_cast<const SnapshotBody *>(bytes + header.bodyOffset);
+  loaded.actors.resize(header.bodyCount);
+  // Actors without a body would enter the scene without an entity
+  uint64_t actorCount = 0;
+  for (PxU32 i = 0; i < collection->getNbObjects(); i++) {
+    if (collection->getObject(i).is<PxActor>()) {
+      actorCount++;
+    }
+  }
+  std::string error;
+  if (actorCount != header.bodyCount) {
+    error = "Snapshot " + path + " has actors without a body";
+  }
+  for (uint64_t i = 0; i < header.bodyCount && error.empty(); i++) {
+    PxBase *object = collection->find(ActorId(header, i));
+    loaded.actors[i] = object ? object->is<PxRigidDynamic>() : nullptr;
+    if (!loaded.actors[i]) {
+      error = "Snapshot " + path + " lacks body " + std::to_string(i);
+    }
+  }
+  if (!error.empty()) {
+    // Nothing is in the scene yet, the objects go before their mapping
+    PxCollectionExt::releaseObjects(*collection, false);
+    throw std::runtime_error(error);
+  }
+
+  physics.addCollection(*collection, std::move(mapping), size);
+  return loaded;
+}
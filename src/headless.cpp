@@ -0,0 +1,287 @@
+// Runs the physics world without a window or GL context and reports how
+// fast it steps.
+//
+//   ember_headless [--entities N] [--layout stack|pyramid|grid|drop]
+//                  [--steps N] [--dt SECONDS] [--threads N]
+//                  [--pin FIRST_CPU] [--churn N] [--trace FILE]
+//                  [--record FILE] [--profile FILE]
+//   ember_headless --replay FILE
+//
+// --churn destroys the N oldest entities every step and spawns the same
+// number of new ones in their places, to measure steady-state
+// spawn/despawn cost.
+// --trace writes the profiler's scopes of the last steps as Chrome trace
+// JSON, without it the profiler stays off.
+// --profile simulates with the first physics profile in FILE, see
+// PhysicsProfile.h.
+// --record streams every step to a recording, --replay decodes one
+// without creating a physics scene and reports how fast it plays and
+// seeks.
+
+#include "PhysicsProfile.h"
+#include "Profiler.h"
+#include "Recording.h"
+#include "SceneGenerators.h"
+#include "World.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct HeadlessOptions {
+  int entities = 1000;
+  std::string layout = "stack";
+  int steps = 1000;
+  float dt = 1.0f / 60.0f;
+  ThreadPoolDesc threads;
+  int churn = 0;
+  std::string tracePath;
+  std::string recordPath;
+  std::string replayPath;
+  std::string profilePath;
+};
+
+static void printUsage() {
+  std::cout << "Usage: ember_headless [--entities N] "
+               "[--layout stack|pyramid|grid|drop] [--steps N] "
+               "[--dt SECONDS] [--threads N] [--pin FIRST_CPU] [--churn N] "
+               "[--trace FILE] [--record FILE] [--profile FILE]"
+            << std::endl;
+  std::cout << "       ember_headless --replay FILE" << std::endl;
+}
+
+static bool parseOptions(int argc, char **argv, HeadlessOptions &options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h") {
+      return false;
+    }
+    if (i + 1 >= argc) {
+      std::cout << "Missing value for " << arg << std::endl;
+      return false;
+    }
+    const char *value = argv[++i];
+    if (arg == "--entities") {
+      options.entities = std::atoi(value);
+    } else if (arg == "--layout") {
+      options.layout = value;
+    } else if (arg == "--steps") {
+      options.steps = std::atoi(value);
+    } else if (arg == "--dt") {
+      options.dt = std::atof(value);
+    } else if (arg == "--threads") {
+      options.threads.workerCount = std::atoi(value);
+    } else if (arg == "--pin") {
+      options.threads.pinWorkers = true;
+      options.threads.firstCpu = std::atoi(value);
+    } else if (arg == "--churn") {
+      options.churn = std::atoi(value);
+    } else if (arg == "--trace") {
+      options.tracePath = value;
+    } else if (arg == "--record") {
+      options.recordPath = value;
+    } else if (arg == "--replay") {
+      options.replayPath = value;
+    } else if (arg == "--profile") {
+      options.profilePath = value;
+    } else {
+      std::cout << "Unknown option " << arg << std::endl;
+      return false;
+    }
+  }
+  return options.entities >= 0 && options.steps > 0 && options.dt > 0.0f &&
+         options.churn >= 0;
+}
+
+static double percentile(const std::vector<double> &sorted, double p) {
+  size_t index = (size_t)std::min<double>(sorted.size() - 1,
+                                          std::floor(p * sorted.size()));
+  return sorted[index];
+}
+
+static void printRecordingStats(const RecordingStats &stats) {
+  std::cout << "recording:  " << stats.frames << " frames, "
+            << stats.storedBytes / (1024.0 * 1024.0) << " MB in "
+            << stats.chunks << " chunks" << std::endl;
+  std::cout << "body/frame: " << stats.bytesPerBodyFrame() << " bytes ("
+            << stats.rawBytesPerBodyFrame() << " before compression)"
+            << std::endl;
+}
+
+// Plays the whole recording at its own rate, then seeks around in it
+static int replay(const std::string &path) {
+  SimulationPlayback playback(path);
+  size_t frames = playback.GetFrameCount();
+  printRecordingStats(playback.GetStats());
+  if (frames == 0) {
+    return 0;
+  }
+
+  auto playStart = std::chrono::steady_clock::now();
+  while (playback.GetFrame() + 1 < frames) {
+    playback.Update(playback.GetStepSeconds());
+  }
+  double playSeconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - playStart)
+                           .count();
+
+  const int seeks = 100;
+  auto seekStart = std::chrono::steady_clock::now();
+  for (int i = 0; i < seeks; i++) {
+    playback.Seek((i * 7919u) % frames);
+  }
+  double seekMs = std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - seekStart)
+                      .count();
+
+  std::cout << "entities:   " << playback.GetEntitiesCount() << std::endl;
+  std::cout << "frames/sec: " << frames / playSeconds << std::endl;
+  std::cout << "seek mean:  " << seekMs / seeks << " ms" << std::endl;
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  HeadlessOptions options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage();
+    return 1;
+  }
+  Profiler::get().setEnabled(!options.tracePath.empty());
+  Profiler::get().setThreadName("main");
+  if (!options.replayPath.empty()) {
+    try {
+      return replay(options.replayPath);
+    } catch (const std::exception &error) {
+      std::cout << error.what() << std::endl;
+      return 1;
+    }
+  }
+
+  PhysicsProfile profile;
+  if (!options.profilePath.empty()) {
+    try {
+      profile = LoadPhysicsProfiles(options.profilePath).front();
+    } catch (const std::exception &error) {
+      std::cout << error.what() << std::endl;
+      return 1;
+    }
+  }
+  World world(options.threads, profile);
+
+  std::vector<SpawnDesc> spawns;
+  if (!GenerateLayout(options.layout, options.entities, spawns)) {
+    std::cout << "Unknown layout " << options.layout << std::endl;
+    printUsage();
+    return 1;
+  }
+
+  std::vector<Entity> live;
+  auto buildStart = std::chrono::steady_clock::now();
+  world.SpawnBatch(spawns, nullptr, &live);
+  double buildMs = std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - buildStart)
+                       .count();
+
+  // Replacements take the poses of the bodies they replace. That space is
+  // exactly what the destroyed bodies free, so churn steps measure
+  // creation and destruction rather than the solver pushing apart new
+  // bodies that landed inside live ones.
+  size_t churn = std::min<size_t>(options.churn, live.size());
+  std::vector<SpawnDesc> replacements(churn);
+  std::vector<Entity> respawned;
+  respawned.reserve(churn);
+  size_t cursor = 0;
+
+  if (!options.recordPath.empty()) {
+    world.SetStepRate(1.0f / options.dt);
+    world.StartRecording(options.recordPath);
+  }
+
+  std::vector<double> stepMs;
+  stepMs.reserve(options.steps);
+
+  auto runStart = std::chrono::steady_clock::now();
+  for (int i = 0; i < options.steps; i++) {
+    auto stepStart = std::chrono::steady_clock::now();
+    PROFILE_SCOPE("Step");
+    if (churn > 0) {
+      Registry &registry = world.GetRegistry();
+      for (size_t k = 0; k < churn; k++) {
+        Entity entity = live[(cursor + k) % live.size()];
+        const TransformComponent *transform =
+            registry.get<TransformComponent>(entity);
+        replacements[k].position = transform->position;
+        replacements[k].rotation = transform->rotation;
+        replacements[k].mass =
+            registry.get<PhysicsComponent>(entity)->actor->getMass();
+        world.DestroyEntity(entity);
+      }
+      respawned.clear();
+      world.SpawnBatch(replacements, nullptr, &respawned);
+      for (size_t k = 0; k < churn; k++) {
+        live[(cursor + k) % live.size()] = respawned[k];
+      }
+      cursor = (cursor + churn) % live.size();
+    }
+    world.Step(options.dt);
+    stepMs.push_back(std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - stepStart)
+                         .count());
+  }
+  double runSeconds = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - runStart)
+                          .count();
+
+  std::sort(stepMs.begin(), stepMs.end());
+  double meanMs = 0.0;
+  for (double ms : stepMs) {
+    meanMs += ms;
+  }
+  meanMs /= stepMs.size();
+
+  std::cout << "entities:   " << world.GetEntitiesCount() << std::endl;
+  std::cout << "layout:     " << options.layout << std::endl;
+  std::cout << "profile:    " << profile.name << " ("
+            << BroadPhaseName(profile.broadPhase) << ", "
+            << SolverName(profile.solver) << ")" << std::endl;
+  std::cout << "workers:    " << world.GetThreadPool().getWorkerCount()
+            << std::endl;
+  std::cout << "steps:      " << options.steps << " (dt " << options.dt
+            << " s)" << std::endl;
+  std::cout << "build:      " << buildMs << " ms" << std::endl;
+  if (churn > 0) {
+    std::cout << "churn:      " << churn << " entities/step, "
+              << world.GetPhysicsSystem()->getPooledActorCount()
+              << " actors pooled" << std::endl;
+  }
+  PhysicsAssetStats assets = world.GetPhysicsSystem()->GetAssetCache().getStats();
+  std::cout << "assets:     " << assets.materials << " materials, "
+            << assets.shapes << " shapes, " << assets.shapeReferences
+            << " attachments" << std::endl;
+  std::cout << "physx heap: "
+            << world.GetPhysicsSystem()->getAllocatedBytes() / (1024.0 * 1024.0)
+            << " MB" << std::endl;
+  std::cout << "steps/sec:  " << options.steps / runSeconds << std::endl;
+  std::cout << "step mean:  " << meanMs << " ms" << std::endl;
+  std::cout << "step p50:   " << percentile(stepMs, 0.50) << " ms" << std::endl;
+  std::cout << "step p90:   " << percentile(stepMs, 0.90) << " ms" << std::endl;
+  std::cout << "step p99:   " << percentile(stepMs, 0.99) << " ms" << std::endl;
+  std::cout << "step max:   " << stepMs.back() << " ms" << std::endl;
+
+  if (world.IsRecording()) {
+    printRecordingStats(world.StopRecording());
+  }
+
+  if (!options.tracePath.empty()) {
+    if (!Profiler::get().exportChromeTrace(options.tracePath)) {
+      std::cout << "Failed to write " << options.tracePath << std::endl;
+      return 1;
+    }
+    std::cout << "trace:      " << options.tracePath << std::endl;
+  }
+  return 0;
+}
@@ -1,7 +1,21 @@
 #include "Application.h"
 
-int main() {
-  Application app(800, 600, false);
+#include <cstring>
+#include <iostream>
+
+// Ember [--replay FILE]
+int main(int argc, char **argv) {
+  std::string replayPath;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replayPath = argv[++i];
+    } else {
+      std::cout << "Usage: Ember [--replay FILE]" << std::endl;
+      return 1;
+    }
+  }
+
+  Application app(800, 600, false, replayPath);
   app.Run();
   app.Close();
   return 0;
@@ -0,0 +1,88 @@
+// Checks every model matrix kernel of TransformBatch against ModelMatrix,
+// the reference the renderer used before batching. Exits non-zero on the
+// first mismatch.
+
+#include "Transform.h"
+#include "TransformBatch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+bool matches(const glm::mat4 &actual, const glm::mat4 &expected,
+             SimdLevel level, size_t count, size_t index) {
+  for (int c = 0; c < 4; c++) {
+    for (int r = 0; r < 4; r++) {
+      // Translations reach 100, compare relative to the magnitude
+      float tolerance = 1e-5f * std::max(1.0f, std::abs(expected[c][r]));
+      if (std::abs(actual[c][r] - expected[c][r]) > tolerance) {
+        std::cerr << SimdLevelName(level) << ": matrix " << index << " of "
+                  << count << " differs at [" << c << "][" << r
+                  << "]: " << actual[c][r] << " vs " << expected[c][r]
+                  << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Random transforms, plus the identity and half turns about each axis
+// where a sign slip in the kernels would show
+bool checkCount(size_t count, std::mt19937 &rng) {
+  std::uniform_real_distribution<float> coord(-100.0f, 100.0f);
+  std::normal_distribution<float> axis(0.0f, 1.0f);
+  const glm::quat special[] = {
+      glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::quat(0.0f, 1.0f, 0.0f, 0.0f),
+      glm::quat(0.0f, 0.0f, 1.0f, 0.0f), glm::quat(0.0f, 0.0f, 0.0f, 1.0f)};
+
+  TransformBatch batch;
+  std::vector<glm::mat4> expected(count);
+  for (size_t i = 0; i < count; i++) {
+    glm::vec3 position(coord(rng), coord(rng), coord(rng));
+    glm::quat rotation =
+        i < 4 ? special[i]
+              : glm::normalize(
+                    glm::quat(axis(rng), axis(rng), axis(rng), axis(rng)));
+    batch.push(position, rotation);
+    expected[i] = ModelMatrix(position, rotation);
+  }
+
+  for (SimdLevel level :
+       {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX}) {
+    if (level > BestSimdLevel()) {
+      continue;
+    }
+    std::vector<glm::mat4> models(count);
+    BuildModelMatrices(batch, models.data(), level);
+    for (size_t i = 0; i < count; i++) {
+      if (!matches(models[i], expected[i], level, count, i)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main() {
+  std::mt19937 rng(7);
+  // Every tail length of the 4 and 8 wide kernels, then a large batch
+  for (size_t count = 0; count <= 17; count++) {
+    if (!checkCount(count, rng)) {
+      return 1;
+    }
+  }
+  if (!checkCount(1003, rng)) {
+    return 1;
+  }
+  std::cout << "TransformBatch kernels match ModelMatrix up to "
+            << SimdLevelName(BestSimdLevel()) << std::endl;
+  return 0;
+}